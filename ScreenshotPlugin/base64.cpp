@@ -0,0 +1,79 @@
+#include "base64.h"
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+// encode the image
+
+static const std::string base64_chars =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "0123456789+/";
+
+std::string base64_encode(unsigned char const *bytes_to_encode, unsigned int in_len)
+{
+    std::string ret;
+    ret.reserve((in_len + 2) / 3 * 4);
+    int i = 0;
+    int j = 0;
+    unsigned char char_array_3[3];
+    unsigned char char_array_4[4];
+
+    while (in_len--)
+    {
+        char_array_3[i++] = *(bytes_to_encode++);
+        if (i == 3)
+        {
+            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+            char_array_4[3] = char_array_3[2] & 0x3f;
+
+            for (i = 0; i < 4; i++)
+                ret += base64_chars[char_array_4[i]];
+            i = 0;
+        }
+    }
+
+    if (i)
+    {
+        for (j = i; j < 3; j++)
+            char_array_3[j] = '\0';
+
+        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
+        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
+        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
+        char_array_4[3] = char_array_3[2] & 0x3f;
+
+        for (j = 0; j < i + 1; j++)
+            ret += base64_chars[char_array_4[j]];
+
+        while (i++ < 3)
+            ret += '=';
+    }
+
+    return ret;
+}
+
+// Function to encode the image file as a Base64 string
+std::string base64encode(const std::string &filePath)
+{
+    // Open the file in binary mode
+    std::cout << "Base64encoding entered....\n";
+    std::ifstream imageFile(filePath, std::ios::binary);
+    std::cout << "image is taken into stream";
+
+    if (!imageFile.is_open())
+    {
+        std::cout << "Could not open file for reading.\n";
+    }
+
+    std::cout << "Going to read img..\n";
+    // Read the contents of the file
+    std::vector<unsigned char> imageData((std::istreambuf_iterator<char>(imageFile)), std::istreambuf_iterator<char>());
+    std::cout << "Image read...\n";
+    std::cout << "Base64rncoding....\n";
+    // Encode the image data to Base64
+    return base64_encode(imageData.data(), imageData.size());
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+std::string base64_encode(unsigned char const *bytes_to_encode, unsigned int in_len);
+
+// Function to encode the image file as a Base64 string
+std::string base64encode(const std::string &filePath);
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Shared helpers for the benchmark executables. Every benchmark takes optional
+// SCREENSHOT_SOURCE-style specs ("synthetic:4k:3") on the command line and
+// falls back to the 1080p/4K/8K presets below.
+
+inline double nowMs()
+{
+    using namespace std::chrono;
+    return duration<double, std::milli>(steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs fn `runs` times and returns the median wall time in milliseconds
+template <typename Fn>
+double medianMs(int runs, Fn fn)
+{
+    std::vector<double> samples;
+    for (int i = 0; i < runs; ++i)
+    {
+        double start = nowMs();
+        fn();
+        samples.push_back(nowMs() - start);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+inline std::vector<std::string> benchSpecs(int argc, char **argv, const char *fallback = nullptr)
+{
+    std::vector<std::string> specs;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (argv[i][0] != '-')
+        {
+            specs.push_back(argv[i]);
+        }
+    }
+    if (specs.empty())
+    {
+        if (fallback)
+        {
+            specs.push_back(fallback);
+        }
+        else
+        {
+            specs.push_back("synthetic:1080p:2");
+            specs.push_back("synthetic:4k:2");
+            specs.push_back("synthetic:8k:1");
+        }
+    }
+    return specs;
+}
+
+inline double gbPerSecond(size_t bytes, double ms)
+{
+    return ms > 0.0 ? bytes / (ms * 1e6) : 0.0;
+}
@@ -0,0 +1,242 @@
+#include "bench_common.h"
+
+#include "byte_budget.h"
+#include "content_analysis.h"
+#include "image_pipeline.h"
+#include "jpeg_writer.h"
+#include "palette.h"
+#include "png_writer.h"
+#include "qoi.h"
+#include "webp_writer.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+// Encode time, peak memory and size of the collage and of the full-size PIP
+// composite in each output format, at the settings worth choosing a default
+// from, what the adaptive format would pick for it and what fitting JPEG
+// and PNG under a few byte budgets costs. Peak memory is what one encode adds to the process's resident set
+// (Linux only, "-" elsewhere):
+//   bench_formats [synthetic:<res>:<monitors>[:<seed>] | x11 | platform ...]
+
+namespace
+{
+
+// VmHWM and VmRSS from /proc/self/status in KB; false where there is none
+bool readMemoryKb(long &peak, long &resident)
+{
+    std::FILE *status = std::fopen("/proc/self/status", "r");
+    if (!status)
+    {
+        return false;
+    }
+    peak = resident = -1;
+    char line[256];
+    while (std::fgets(line, sizeof(line), status))
+    {
+        std::sscanf(line, "VmHWM: %ld", &peak);
+        std::sscanf(line, "VmRSS: %ld", &resident);
+    }
+    std::fclose(status);
+    return peak >= 0 && resident >= 0;
+}
+
+// Resident memory fn adds at its peak, in MB; -1 when it cannot be measured.
+// Memory freed by earlier rows is handed back first, so fn cannot reuse it
+// unseen, then writing 5 to clear_refs resets VmHWM to the resident set.
+template <typename Fn>
+double peakMb(Fn fn)
+{
+#if defined(__GLIBC__)
+    malloc_trim(0);
+#endif
+    long peak, before;
+    std::FILE *clearRefs = std::fopen("/proc/self/clear_refs", "w");
+    if (!clearRefs)
+    {
+        fn();
+        return -1;
+    }
+    std::fputs("5", clearRefs);
+    std::fclose(clearRefs);
+    if (!readMemoryKb(peak, before))
+    {
+        fn();
+        return -1;
+    }
+    fn();
+    long after;
+    if (!readMemoryKb(peak, after))
+    {
+        return -1;
+    }
+    return (peak - before) / 1024.0;
+}
+
+template <typename Encode>
+void printRow(const char *name, const Frame &frame, size_t pngBytes, Encode encode)
+{
+    const int runs = 3;
+    std::vector<unsigned char> bytes;
+    double mb = peakMb([&]() {
+        std::vector<unsigned char> first;
+        encode(frame, first);
+    });
+    double ms = medianMs(runs, [&]() { encode(frame, bytes); });
+    char peak[16] = "-";
+    if (mb >= 0)
+    {
+        std::snprintf(peak, sizeof(peak), "%.1f", mb);
+    }
+    std::printf("  %-28s %8.1fms %8s %10zu %7.0f%%\n", name, ms, peak, bytes.size() / 1024, pngBytes ? 100.0 * bytes.size() / pngBytes : 100.0);
+}
+
+void printWebpRow(const Frame &frame, size_t pngBytes, bool lossless, float quality, int method)
+{
+    WebpOptions options;
+    options.lossless = lossless;
+    options.quality = quality;
+    options.method = method;
+    char name[64];
+    std::snprintf(name, sizeof(name), "webp %s q%.0f m%d", lossless ? "lossless" : "lossy", quality, method);
+    printRow(name, frame, pngBytes, [&](const Frame &f, std::vector<unsigned char> &out) {
+        encodeWebp(f.data(), f.width(), f.height(), f.stride(), f.format(), options, out);
+    });
+}
+
+// Budgeted encode of frame, first with nothing cached for the layout and
+// then again from what the first one learnt. Full encodes are those of the
+// whole (scaled) frame; work is every pixel encoded, trials included, over
+// those of one plain encode.
+void printBudgetRow(const char *name, const Frame &frame, size_t maxBytes, int maxQuality, const BudgetEncoder &encode)
+{
+    char key[64];
+    std::snprintf(key, sizeof(key), "%s %dx%d %zu", name, frame.width(), frame.height(), maxBytes);
+    std::printf("  %-4s %5zuKB:", name, maxBytes / 1024);
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        double pixels = 0;
+        int fullEncodes = 0;
+        BudgetEncoder counted = [&](const ImageView &image, int quality, EncodedImage &out) {
+            pixels += static_cast<double>(image.width) * image.height;
+            if (std::abs(image.height - static_cast<double>(image.width) * frame.height() / frame.width()) <= 1)
+            {
+                ++fullEncodes;
+            }
+            return encode(image, quality, out);
+        };
+        EncodedImage encoded;
+        BudgetParams chosen;
+        double start = nowMs();
+        encodeWithinBudget(frame, maxBytes, maxQuality, key, ResampleFilter::Box, 0, counted, encoded, &chosen);
+        double ms = nowMs() - start;
+        std::printf("%s %7zuKB q%-3d %3.0f%% %7.1fms %2d %4.1fx", pass ? " |" : "", encoded.bytes.size() / 1024, chosen.quality,
+                    chosen.scale * 100, ms, fullEncodes, pixels / (static_cast<double>(frame.width()) * frame.height()));
+    }
+    std::printf("\n");
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (!webpAvailable())
+    {
+        std::printf("(built without libwebp: no WebP rows)\n");
+    }
+
+    for (const std::string &spec : benchSpecs(argc, argv))
+    {
+        std::unique_ptr<FrameSource> source = createFrameSourceFromSpec(spec);
+        if (!source)
+        {
+            std::fprintf(stderr, "Skipping unavailable source %s\n", spec.c_str());
+            continue;
+        }
+        CapturedOutputs captured;
+        captureAllOutputs(*source, captured);
+        if (captured.views.empty())
+        {
+            continue;
+        }
+
+        const LayoutSpec layouts[] = {collageLayoutSpec(), pipLayoutSpec()};
+        for (const LayoutSpec &layout : layouts)
+        {
+            Frame composite = composeLayout(captured.views, computeLayout(layout, captured.views));
+            ContentStats stats;
+            double analyzeMs = medianMs(3, [&]() { stats = analyzeContent(composite); });
+            std::printf("%s %s, %dx%d\n  adaptive picks %s in %.2fms (entropy %.2f bits, flat %.0f%%)\n  %-28s %10s %8s %10s %8s\n", spec.c_str(),
+                        layoutKindName(layout.kind), composite.width(), composite.height(), contentEncodingName(chooseContentEncoding(stats)),
+                        analyzeMs, stats.gradientEntropy, stats.flatShare * 100, "format", "encode", "peak MB", "KB", "vs PNG");
+
+            std::vector<unsigned char> png;
+            encodePng(composite.data(), composite.width(), composite.height(), composite.stride(), composite.format(), png);
+            printRow("png", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                encodePng(f.data(), f.width(), f.height(), f.stride(), f.format(), out);
+            });
+            std::vector<uint32_t> palette;
+            std::vector<unsigned char> indices;
+            if (buildExactPalette(composite, palette, indices))
+            {
+                printRow("indexed png", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                    std::vector<uint32_t> colors;
+                    std::vector<unsigned char> indexed;
+                    buildExactPalette(f, colors, indexed);
+                    encodePngIndexed(indexed.data(), f.width(), f.height(), colors, out);
+                });
+            }
+            printRow("quantized png (256)", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                std::vector<uint32_t> colors;
+                std::vector<unsigned char> indexed;
+                quantizePalette(f, kMaxPaletteColors, colors, indexed);
+                encodePngIndexed(indexed.data(), f.width(), f.height(), colors, out);
+            });
+            printRow("quantized png (16, 4-bit)", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                std::vector<uint32_t> colors;
+                std::vector<unsigned char> indexed;
+                quantizePalette(f, 16, colors, indexed);
+                encodePngIndexed(indexed.data(), f.width(), f.height(), colors, out);
+            });
+            printRow("png level 1", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                encodePng(f.data(), f.width(), f.height(), f.stride(), f.format(), out, 1);
+            });
+            printRow("jpeg q90", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                encodeJpeg(f.data(), f.width(), f.height(), f.stride(), f.format(), JpegOptions(), out);
+            });
+            printRow("qoi", composite, png.size(), [](const Frame &f, std::vector<unsigned char> &out) {
+                encodeQoi(f.data(), f.width(), f.height(), f.stride(), f.format(), out);
+            });
+
+            std::printf("  byte budget: KB, quality, scale, time, full encodes and work, cold | warm\n");
+            const size_t budgets[] = {100 * 1024, 250 * 1024, 1024 * 1024};
+            for (size_t budget : budgets)
+            {
+                int maxQuality = JpegOptions().quality;
+                printBudgetRow("jpeg", composite, budget, maxQuality, [](const ImageView &f, int quality, EncodedImage &out) {
+                    return encodeJpeg(f.pixels, f.width, f.height, f.stride, f.format, quality, out.bytes);
+                });
+                printBudgetRow("png", composite, budget, -1, [](const ImageView &f, int, EncodedImage &out) {
+                    return encodePng(f.pixels, f.width, f.height, f.stride, f.format, out.bytes);
+                });
+            }
+
+            if (!webpAvailable())
+            {
+                continue;
+            }
+            printWebpRow(composite, png.size(), true, 0, 0);
+            printWebpRow(composite, png.size(), true, 50, 0);
+            printWebpRow(composite, png.size(), true, 50, 1);
+            printWebpRow(composite, png.size(), true, 75, 4);
+            printWebpRow(composite, png.size(), false, 80, 0);
+            printWebpRow(composite, png.size(), false, 80, 4);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,81 @@
+#include "bench_common.h"
+
+#include "image_pipeline.h"
+#include "jpeg_writer.h"
+
+#include <cstdio>
+
+// JPEG encode time and size of the collage and of the full-size PIP
+// composite, stb against libjpeg-turbo (when the build has it) at the same
+// quality, each as parallel restart segments and as a single scan:
+//   bench_jpeg [--quality=<1-100>] [synthetic:<res>:<monitors>[:<seed>] | x11 | platform ...]
+
+namespace
+{
+
+void printRow(const char *name, const Frame &frame, const JpegOptions &options)
+{
+    const int runs = 5;
+    std::vector<unsigned char> jpeg;
+    double ms = medianMs(runs, [&]() { encodeJpeg(frame.data(), frame.width(), frame.height(), frame.stride(), frame.format(), options, jpeg); });
+    std::printf("  %-24s %8.1fms %10zu\n", name, ms, jpeg.size() / 1024);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    int quality = 90;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::sscanf(argv[i], "--quality=%d", &quality);
+    }
+
+    for (const std::string &spec : benchSpecs(argc, argv))
+    {
+        std::unique_ptr<FrameSource> source = createFrameSourceFromSpec(spec);
+        if (!source)
+        {
+            std::fprintf(stderr, "Skipping unavailable source %s\n", spec.c_str());
+            continue;
+        }
+        CapturedOutputs captured;
+        captureAllOutputs(*source, captured);
+        if (captured.views.empty())
+        {
+            continue;
+        }
+
+        const LayoutSpec layouts[] = {collageLayoutSpec(), pipLayoutSpec()};
+        for (const LayoutSpec &layout : layouts)
+        {
+            Frame composite = composeLayout(captured.views, computeLayout(layout, captured.views));
+            std::printf("%s %s, %dx%d, quality %d\n  %-24s %10s %10s\n", spec.c_str(), layoutKindName(layout.kind), composite.width(),
+                        composite.height(), quality, "encoder", "encode", "KB");
+
+            JpegOptions options;
+            options.quality = quality;
+            options.backend = JpegBackend::Stb;
+            printRow("stb", composite, options);
+            options.restartSegments = false;
+            printRow("stb single scan", composite, options);
+            options.restartSegments = true;
+            if (!jpegBackendAvailable(JpegBackend::Turbo))
+            {
+                std::printf("  (built without libjpeg-turbo)\n");
+                continue;
+            }
+            options.backend = JpegBackend::Turbo;
+            options.optimizeHuffman = false;
+            printRow("turbo", composite, options);
+            options.restartSegments = false;
+            printRow("turbo single scan", composite, options);
+            options.restartSegments = true;
+            options.optimizeHuffman = true;
+            printRow("turbo optimized", composite, options);
+            options.subsampling = JpegSubsampling::S444;
+            printRow("turbo optimized 4:4:4", composite, options);
+        }
+    }
+    return 0;
+}
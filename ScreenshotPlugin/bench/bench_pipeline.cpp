@@ -0,0 +1,47 @@
+#include "bench_common.h"
+
+#include "base64.h"
+#include "image_pipeline.h"
+
+#include <cstdio>
+#include <iostream>
+
+// End-to-end timing of the capture pipeline:
+//   bench_pipeline [synthetic:<res>:<monitors>[:<seed>] | x11 | platform ...]
+// The output files are written to the working directory.
+
+int main(int argc, char **argv)
+{
+    const int runs = 3;
+    std::printf("%-22s %10s %10s %10s %10s %10s\n", "source", "capture", "collage", "pip", "base64", "png KB");
+
+    for (const std::string &spec : benchSpecs(argc, argv))
+    {
+        std::unique_ptr<FrameSource> source = createFrameSourceFromSpec(spec);
+        if (!source)
+        {
+            std::fprintf(stderr, "Skipping unavailable source %s\n", spec.c_str());
+            continue;
+        }
+
+        // First acquire renders the synthetic desktop or attaches the SHM
+        // segments; keep it out of the timings
+        CapturedOutputs captured;
+        captureAllOutputs(*source, captured);
+
+        double captureMs = medianMs(runs, [&]() { captureAllOutputs(*source, captured); });
+
+        std::streambuf *coutBuffer = std::cout.rdbuf(nullptr); // silence the pipeline's logging
+        double collageMs = medianMs(runs, [&]() { combineImages(captured.views, "bench_collage.jpg"); });
+        double pipMs = medianMs(runs, [&]() { pipImages(captured.views, "bench_pip.png"); });
+        EncodedImage pip;
+        encodeLayout(captured.views, pipLayoutSpec(), pip);
+        std::string encoded;
+        double base64Ms = medianMs(runs, [&]() { encoded = base64_encode(pip.bytes.data(), static_cast<unsigned int>(pip.bytes.size())); });
+        std::cout.rdbuf(coutBuffer);
+
+        std::printf("%-22s %8.1fms %8.1fms %8.1fms %8.1fms %10zu\n", spec.c_str(), captureMs, collageMs, pipMs, base64Ms,
+                    encoded.size() * 3 / 4 / 1024);
+    }
+    return 0;
+}
@@ -0,0 +1,221 @@
+#include "bench_common.h"
+
+#include "checksum.h"
+#include "deflate.h"
+#include "image_pipeline.h"
+#include "png_filter.h"
+#include "png_writer.h"
+
+#include <algorithm>
+#include <cstdio>
+
+// PNG encode time and size of the full-size PIP composite at several deflate
+// levels of the backend this build uses (SCREENSHOT_DEFLATE), then the row
+// filters of every kernel set and the checksums on their own; build once per
+// backend to compare them:
+//   bench_png [synthetic:<res>:<monitors>[:<seed>] | x11 | platform ...]
+// Every filter kernel set and both checksums are first checked byte for byte
+// against scalar code; a mismatch makes the benchmark exit with 1.
+
+namespace
+{
+
+std::vector<unsigned char> randomBytes(size_t count, unsigned int seed)
+{
+    std::vector<unsigned char> bytes(count);
+    for (unsigned char &byte : bytes)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = static_cast<unsigned char>(seed >> 16);
+    }
+    return bytes;
+}
+
+// Compares the filter kernels with the scalar ones on odd widths at 3 and 4
+// bytes per pixel, the rows starting at unaligned addresses. Rows are random
+// or mostly flat, so that every filter type gets chosen. Bytes past the
+// output row must come out untouched. Returns the number of mismatches, each
+// reported.
+int checkFilters(const PngFilterKernels &kernels, const PngFilterKernels &scalar)
+{
+    const int widths[] = {1, 2, 3, 5, 7, 11, 15, 16, 17, 31, 33, 63, 65, 127, 129, 1023, 3839, 3841};
+    const int slack = 64;
+    std::vector<unsigned char> noise = randomBytes(3841 * 4 * 2 + 2 * slack, 1);
+    std::vector<unsigned char> flat(noise.size());
+    for (size_t i = 0; i < flat.size(); ++i)
+    {
+        flat[i] = noise[i] < 16 ? noise[i] : static_cast<unsigned char>(i % 7);
+    }
+    std::vector<unsigned char> expected(noise.size());
+    std::vector<unsigned char> actual(noise.size());
+
+    int mismatches = 0;
+    for (const std::vector<unsigned char> *pixels : {&noise, &flat})
+    {
+        for (int bpp = 3; bpp <= 4; ++bpp)
+        {
+            for (int width : widths)
+            {
+                for (int offset = 0; offset < 4; ++offset)
+                {
+                    const int rowBytes = width * bpp;
+                    const unsigned char *prev = pixels->data() + slack + offset;
+                    const unsigned char *row = prev + rowBytes + 1;
+                    std::fill(expected.begin(), expected.end(), 0xcd);
+                    std::fill(actual.begin(), actual.end(), 0xcd);
+                    int expectedType = scalar.filterRow(row, prev, rowBytes, bpp, expected.data() + slack + 3 - offset);
+                    int actualType = kernels.filterRow(row, prev, rowBytes, bpp, actual.data() + slack + 3 - offset);
+                    if (expectedType != actualType || expected != actual)
+                    {
+                        std::printf("MISMATCH: filter %s, %d bpp, width %d, offset %d\n", kernels.isa, bpp, width, offset);
+                        ++mismatches;
+                    }
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+uint32_t crc32Reference(const unsigned char *data, size_t len)
+{
+    uint32_t crc = 0xffffffff;
+    for (size_t i = 0; i < len; ++i)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+uint32_t adler32Reference(const unsigned char *data, size_t len)
+{
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t i = 0; i < len; ++i)
+    {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+// Compares crc32Update() and adler32Update(), whose SIMD paths take over from
+// 64 bytes, with bytewise reference code on every length up to 300 and on
+// odd lengths past the Adler-32 run of 5552, at unaligned addresses and
+// continued from a split. All-0xff input drives the Adler-32 sums to their
+// largest. Returns the number of mismatches, each reported.
+int checkChecksums()
+{
+    std::vector<size_t> lengths;
+    for (size_t len = 0; len <= 300; ++len)
+    {
+        lengths.push_back(len);
+    }
+    const size_t longLengths[] = {1023, 5551, 5552, 5553, 11105, 65537, 1000003};
+    lengths.insert(lengths.end(), longLengths, longLengths + sizeof(longLengths) / sizeof(longLengths[0]));
+    const std::vector<unsigned char> noise = randomBytes(1000003 + 16, 2);
+    const std::vector<unsigned char> ones(noise.size(), 0xff);
+
+    int mismatches = 0;
+    for (const std::vector<unsigned char> *bytes : {&noise, &ones})
+    {
+        for (size_t len : lengths)
+        {
+            for (size_t offset = 0; offset < 16; offset += len > 300 ? 5 : 1)
+            {
+                const unsigned char *data = bytes->data() + offset;
+                size_t split = len / 3;
+                uint32_t crc = crc32Reference(data, len);
+                uint32_t adler = adler32Reference(data, len);
+                if (crc32Update(0, data, len) != crc || crc32Update(crc32Update(0, data, split), data + split, len - split) != crc)
+                {
+                    std::printf("MISMATCH: crc32, length %zu, offset %zu\n", len, offset);
+                    ++mismatches;
+                }
+                if (adler32Update(1, data, len) != adler || adler32Update(adler32Update(1, data, split), data + split, len - split) != adler)
+                {
+                    std::printf("MISMATCH: adler32, length %zu, offset %zu\n", len, offset);
+                    ++mismatches;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int runs = 3;
+    const int levels[] = {-1, 1, 3, 6, 9};
+    std::printf("deflate backend: %s (default level %d)\n", deflateBackendName(), defaultDeflateLevel());
+
+    std::vector<PngFilterKernels> filterSets = supportedPngFilterKernels();
+    int mismatches = checkChecksums();
+    for (size_t i = 1; i < filterSets.size(); ++i)
+    {
+        mismatches += checkFilters(filterSets[i], filterSets[0]);
+    }
+    if (mismatches)
+    {
+        std::printf("%d mismatches against scalar\n", mismatches);
+        return 1;
+    }
+
+    for (const std::string &spec : benchSpecs(argc, argv))
+    {
+        std::unique_ptr<FrameSource> source = createFrameSourceFromSpec(spec);
+        if (!source)
+        {
+            std::fprintf(stderr, "Skipping unavailable source %s\n", spec.c_str());
+            continue;
+        }
+        CapturedOutputs captured;
+        captureAllOutputs(*source, captured);
+        if (captured.views.empty())
+        {
+            continue;
+        }
+        Frame pip = composeLayout(captured.views, computeLayout(pipLayoutSpec(), captured.views));
+
+        std::printf("%s, %dx%d\n  %-8s %10s %10s\n", spec.c_str(), pip.width(), pip.height(), "level", "encode", "KB");
+        for (int level : levels)
+        {
+            std::vector<unsigned char> png;
+            double ms = medianMs(runs, [&]() { encodePng(pip.data(), pip.width(), pip.height(), pip.stride(), pip.format(), png, level); });
+            char name[16];
+            std::snprintf(name, sizeof(name), level < 0 ? "default" : "%d", level);
+            std::printf("  %-8s %8.1fms %10zu\n", name, ms, png.size() / 1024);
+        }
+
+        // Filtering alone, one thread, rows as the writer sees them (the
+        // composite is RGB8 already)
+        const int bpp = bytesPerPixel(pip.format());
+        const int rowBytes = pip.width() * bpp;
+        std::vector<unsigned char> zeroRow(rowBytes, 0);
+        std::vector<unsigned char> filtered(static_cast<size_t>(rowBytes + 1) * pip.height());
+        for (const PngFilterKernels &kernels : filterSets)
+        {
+            double ms = medianMs(runs, [&]() {
+                for (int y = 0; y < pip.height(); ++y)
+                {
+                    const unsigned char *prev = y ? pip.row(y - 1) : zeroRow.data();
+                    unsigned char *line = &filtered[static_cast<size_t>(y) * (rowBytes + 1)];
+                    line[0] = static_cast<unsigned char>(kernels.filterRow(pip.row(y), prev, rowBytes, bpp, line + 1));
+                }
+            });
+            std::printf("  filter %-10s %8.1fms %6.2f GB/s\n", kernels.isa, ms, gbPerSecond(filtered.size(), ms));
+        }
+        volatile uint32_t checksum = 0;
+        double crcMs = medianMs(runs, [&]() { checksum = crc32Update(0, filtered.data(), filtered.size()); });
+        double adlerMs = medianMs(runs, [&]() { checksum = adler32Update(1, filtered.data(), filtered.size()); });
+        std::printf("  crc32             %8.1fms %6.2f GB/s\n  adler32           %8.1fms %6.2f GB/s\n", crcMs, gbPerSecond(filtered.size(), crcMs),
+                    adlerMs, gbPerSecond(filtered.size(), adlerMs));
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include "bench_common.h"
+
+#include "image_pipeline.h"
+#include "jpeg_writer.h"
+#include "png_writer.h"
+#include "resample.h"
+
+#include <cstdio>
+#include <cstring>
+
+// Collage downscale of the first output of each source: the old
+// nearest-neighbour loop against every filter and kernel set, with the size
+// of the resulting thumbnail as PNG and as JPEG at quality 90. "tables" is
+// the one-off cost of building a Resampler, which later captures skip.
+//   bench_resample [synthetic:<res>:<monitors>[:<seed>] | x11 | platform ...]
+
+namespace
+{
+
+// The sampling loop downscaleImage used before area averaging
+void downscaleNearest(const ImageView &image, const MutableImageView &dst)
+{
+    const int bpp = bytesPerPixel(image.format);
+    float xRatio = static_cast<float>(image.width) / dst.width;
+    float yRatio = static_cast<float>(image.height) / dst.height;
+    for (int y = 0; y < dst.height; ++y)
+    {
+        const unsigned char *srcRow = image.row(static_cast<int>(y * yRatio));
+        unsigned char *dstRow = dst.row(y);
+        for (int x = 0; x < dst.width; ++x)
+        {
+            std::memcpy(dstRow + x * bpp, srcRow + static_cast<int>(x * xRatio) * bpp, bpp);
+        }
+    }
+}
+
+void printRow(const char *name, double ms, const Frame &thumbnail, const char *note)
+{
+    std::vector<unsigned char> png;
+    std::vector<unsigned char> jpeg;
+    encodePng(thumbnail.data(), thumbnail.width(), thumbnail.height(), thumbnail.stride(), thumbnail.format(), png);
+    encodeJpeg(thumbnail.data(), thumbnail.width(), thumbnail.height(), thumbnail.stride(), thumbnail.format(), 90, jpeg);
+    std::printf("  %-16s %8.2fms %10zu %10zu%s\n", name, ms, png.size() / 1024, jpeg.size() / 1024, note);
+}
+
+} // namespace
+
+int main(int argc, char **argv)
+{
+    const int runs = 15;
+    const int target = 800;
+
+    for (const std::string &spec : benchSpecs(argc, argv))
+    {
+        std::unique_ptr<FrameSource> source = createFrameSourceFromSpec(spec);
+        CapturedFrame frame;
+        if (!source || !source->acquireFrame(0, frame))
+        {
+            std::fprintf(stderr, "Skipping unavailable source %s\n", spec.c_str());
+            continue;
+        }
+        ImageView image(frame);
+
+        // Same fit as combineImages
+        float scale = std::min(static_cast<float>(target) / image.width, static_cast<float>(target) / image.height);
+        int width = static_cast<int>(image.width * scale);
+        int height = static_cast<int>(image.height * scale);
+        std::printf("%s: %dx%d -> %dx%d\n", spec.c_str(), image.width, image.height, width, height);
+        std::printf("  %-16s %10s %10s %10s\n", "kernel", "time", "png KB", "jpeg KB");
+
+        Frame nearest(width, height, image.format);
+        double ms = medianMs(runs, [&]() { downscaleNearest(image, nearest.mutableView()); });
+        printRow("nearest", ms, nearest, "");
+
+        const ResampleFilter filters[] = {ResampleFilter::Box, ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3};
+        std::vector<ResampleKernels> kernelSets = supportedResampleKernels();
+        for (ResampleFilter filter : filters)
+        {
+            double tablesMs = medianMs(runs, [&]() { Resampler(image.width, image.height, width, height, filter); });
+            std::printf("  %s tables: %.3fms\n", resampleFilterName(filter), tablesMs);
+
+            Resampler resampler(image.width, image.height, width, height, filter);
+            Frame reference(width, height, image.format);
+            resampler.resample(image, reference.mutableView(), kernelSets[0]);
+            for (const ResampleKernels &kernels : kernelSets)
+            {
+                Frame scaled(width, height, image.format);
+                ms = medianMs(runs, [&]() { resampler.resample(image, scaled.mutableView(), kernels); });
+
+                // Every kernel set must match the scalar result
+                bool matches = true;
+                for (int y = 0; y < height; ++y)
+                {
+                    matches = matches && std::memcmp(scaled.row(y), reference.row(y), static_cast<size_t>(width) * bytesPerPixel(image.format)) == 0;
+                }
+                std::string name = std::string(resampleFilterName(filter)) + "/" + kernels.isa;
+                printRow(name.c_str(), ms, scaled, matches ? "" : " !!");
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,83 @@
+#include "bench_common.h"
+
+#include "image_pipeline.h"
+#include "thread_pool.h"
+
+#include <cstdio>
+#include <iostream>
+
+// Thread scaling of the banded compositing steps, 1..N threads of the shared
+// pool (N = cores, or SCREENSHOT_THREADS):
+//   bench_scaling [synthetic:<res>:<monitors>[:<seed>] | x11 | platform ...]
+// "scale" downscales every monitor into an 800px-high canvas, one monitor
+// at a time; "collage" is combineImages, whose bands of all monitors share
+// one queue, JPEG encoding included. The collage is written to the working
+// directory.
+
+int main(int argc, char **argv)
+{
+    const int runs = 5;
+    const int maxThreads = ThreadPool::shared().threadCount();
+    std::printf("%d threads in the shared pool\n", maxThreads);
+
+    for (const std::string &spec : benchSpecs(argc, argv, "synthetic:4k:3"))
+    {
+        std::unique_ptr<FrameSource> source = createFrameSourceFromSpec(spec);
+        if (!source)
+        {
+            std::fprintf(stderr, "Skipping unavailable source %s\n", spec.c_str());
+            continue;
+        }
+        CapturedOutputs captured;
+        captureAllOutputs(*source, captured);
+        if (captured.views.empty())
+        {
+            continue;
+        }
+
+        // Every monitor into an 800px-high slot, side by side
+        std::vector<int> widths;
+        int totalWidth = 0;
+        for (const ImageView &view : captured.views)
+        {
+            widths.push_back(view.width * 800 / view.height);
+            totalWidth += widths.back();
+        }
+        Frame canvas(totalWidth, 800, PixelFormat::RGB8);
+
+        std::printf("%s\n  %-8s %10s %8s %10s %8s\n", spec.c_str(), "threads", "scale", "speedup", "collage", "speedup");
+        double baseline[2] = {0.0, 0.0};
+        for (int threads = 1; threads <= maxThreads; ++threads)
+        {
+            CaptureOptions options;
+            options.threads = threads;
+
+            double scaleMs = medianMs(runs, [&]() {
+                int offsetX = 0;
+                for (size_t i = 0; i < captured.views.size(); ++i)
+                {
+                    downscaleImage(captured.views[i], canvas.region(offsetX, 0, widths[i], 800), ResampleFilter::Box, threads);
+                    offsetX += widths[i];
+                }
+            });
+
+            std::streambuf *coutBuffer = std::cout.rdbuf(nullptr); // silence the pipeline's logging
+            double collageMs = medianMs(runs, [&]() { combineImages(captured.views, "bench_scaling_collage.jpg", options); });
+            std::cout.rdbuf(coutBuffer);
+
+            double times[2] = {scaleMs, collageMs};
+            if (threads == 1)
+            {
+                baseline[0] = scaleMs;
+                baseline[1] = collageMs;
+            }
+            std::printf("  %-8d", threads);
+            for (int i = 0; i < 2; ++i)
+            {
+                std::printf(" %8.1fms %7.2fx", times[i], baseline[i] / times[i]);
+            }
+            std::printf("\n");
+        }
+    }
+    return 0;
+}
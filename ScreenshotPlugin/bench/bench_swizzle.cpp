@@ -0,0 +1,156 @@
+#include "bench_common.h"
+
+#include "pixel_convert.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+// Throughput of every pixel conversion kernel the CPU supports on a 4K frame.
+// GB/s counts the bytes written. Every kernel is first checked byte for byte
+// against the scalar one; a mismatch makes the benchmark exit with 1.
+
+namespace
+{
+
+// Every conversion of a kernel set, with its source and destination pixel
+// sizes
+struct Conversion
+{
+    const char *name;
+    PixelRowConverter PixelKernels::*convert;
+    int srcBpp;
+    int dstBpp;
+};
+
+const Conversion conversions[] = {{"bgraToRgba", &PixelKernels::bgraToRgba, 4, 4}, {"bgrxToRgba", &PixelKernels::bgrxToRgba, 4, 4},
+                                  {"bgrToRgba", &PixelKernels::bgrToRgba, 3, 4},   {"rgbToRgba", &PixelKernels::rgbToRgba, 3, 4},
+                                  {"bgraToRgb", &PixelKernels::bgraToRgb, 4, 3},   {"rgbaToRgb", &PixelKernels::rgbaToRgb, 4, 3}};
+
+// Compares every conversion of kernels with the scalar one on odd widths,
+// from and to unaligned addresses, and in place for the 4-byte to 4-byte
+// ones. The bytes around the row must come out untouched too. Returns the
+// number of mismatches, each reported.
+int checkAgainstScalar(const PixelKernels &kernels, const PixelKernels &scalar)
+{
+    const int widths[] = {1, 2, 3, 5, 7, 8, 9, 15, 16, 17, 31, 33, 63, 65, 127, 129, 255, 1023, 3839, 3841};
+    const int slack = 64;
+    std::vector<unsigned char> src(3841 * 4 + 2 * slack);
+    unsigned int seed = 12345;
+    for (unsigned char &byte : src)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = static_cast<unsigned char>(seed >> 16);
+    }
+    std::vector<unsigned char> expected(src.size());
+    std::vector<unsigned char> actual(src.size());
+
+    int mismatches = 0;
+    for (const Conversion &conversion : conversions)
+    {
+        for (int width : widths)
+        {
+            for (int offset = 0; offset < 4; ++offset)
+            {
+                const unsigned char *in = src.data() + slack + offset;
+                size_t dstOffset = slack + (offset + 1) % 4;
+                std::fill(expected.begin(), expected.end(), 0xcd);
+                std::fill(actual.begin(), actual.end(), 0xcd);
+                (scalar.*conversion.convert)(in, expected.data() + dstOffset, width);
+                (kernels.*conversion.convert)(in, actual.data() + dstOffset, width);
+                bool matches = expected == actual;
+                if (matches && conversion.srcBpp == conversion.dstBpp)
+                {
+                    std::copy(src.begin(), src.end(), actual.begin());
+                    unsigned char *row = actual.data() + slack + offset;
+                    (kernels.*conversion.convert)(row, row, width);
+                    matches = std::equal(row, row + static_cast<size_t>(width) * 4, expected.data() + dstOffset);
+                }
+                if (!matches)
+                {
+                    std::printf("MISMATCH: %s %s, width %d, offset %d\n", kernels.isa, conversion.name, width, offset);
+                    ++mismatches;
+                }
+            }
+        }
+    }
+    return mismatches;
+}
+
+} // namespace
+
+int main()
+{
+    const int width = 3840;
+    const int height = 2160;
+    const int runs = 15;
+
+    SyntheticDesktopConfig config;
+    config.width = width;
+    config.height = height;
+    config.monitorCount = 1;
+
+    std::vector<unsigned char> bgra(static_cast<size_t>(width) * height * 4);
+    std::vector<unsigned char> bgr(static_cast<size_t>(width) * height * 3);
+    std::vector<unsigned char> dst(static_cast<size_t>(width) * height * 4);
+    std::vector<unsigned char> reference(dst.size());
+
+    CapturedFrame frame;
+    config.format = PixelFormat::BGRA8;
+    std::unique_ptr<FrameSource> bgraSource = createSyntheticFrameSource(config);
+    bgraSource->acquireFrame(0, frame);
+    std::memcpy(bgra.data(), frame.pixels, bgra.size());
+    config.format = PixelFormat::BGR8;
+    std::unique_ptr<FrameSource> bgrSource = createSyntheticFrameSource(config);
+    bgrSource->acquireFrame(0, frame);
+    std::memcpy(bgr.data(), frame.pixels, bgr.size());
+
+    std::vector<PixelKernels> kernelSets = supportedPixelKernels();
+    std::printf("active kernels: %s\n", pixelKernels().isa);
+    int mismatches = 0;
+    for (size_t i = 1; i < kernelSets.size(); ++i)
+    {
+        mismatches += checkAgainstScalar(kernelSets[i], kernelSets[0]);
+    }
+    std::printf("%-8s %12s %12s %12s %12s\n", "isa", "BGRA->RGBA", "BGRX->RGBA", "BGR->RGBA", "BGRA->RGB");
+
+    for (const PixelKernels &kernels : kernelSets)
+    {
+        struct Case
+        {
+            PixelRowConverter convert;
+            const unsigned char *src;
+            int srcBpp;
+            int dstBpp;
+            PixelRowConverter scalar;
+        } cases[] = {{kernels.bgraToRgba, bgra.data(), 4, 4, kernelSets[0].bgraToRgba},
+                     {kernels.bgrxToRgba, bgra.data(), 4, 4, kernelSets[0].bgrxToRgba},
+                     {kernels.bgrToRgba, bgr.data(), 3, 4, kernelSets[0].bgrToRgba},
+                     {kernels.bgraToRgb, bgra.data(), 4, 3, kernelSets[0].bgraToRgb}};
+
+        std::printf("%-8s", kernels.isa);
+        for (int c = 0; c < 4; ++c)
+        {
+            const Case &test = cases[c];
+            double ms = medianMs(runs, [&]() {
+                for (int y = 0; y < height; ++y)
+                {
+                    test.convert(test.src + static_cast<size_t>(y) * width * test.srcBpp, dst.data() + static_cast<size_t>(y) * width * test.dstBpp, width);
+                }
+            });
+
+            // Every kernel must match the scalar result
+            size_t written = static_cast<size_t>(width) * height * test.dstBpp;
+            test.scalar(test.src, reference.data(), width * height);
+            bool matches = std::memcmp(reference.data(), dst.data(), written) == 0;
+            std::printf(" %9.2f%s", gbPerSecond(written, ms), matches ? "   " : " !!");
+        }
+        std::printf("\n");
+    }
+    if (mismatches)
+    {
+        std::printf("%d kernel mismatches against scalar\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Runs bench_pipeline against the X11 backend on a headless multi-screen Xvfb.
+#   run_xvfb.sh <path/to/bench_pipeline> [display]
+# Xvfb exposes every -screen as a separate X screen, which the X11 source
+# enumerates as one output each.
+BENCH=${1:-./bench_pipeline}
+DISPLAY_NUMBER=${2:-:99}
+
+Xvfb "$DISPLAY_NUMBER" -nolisten tcp \
+    -screen 0 3840x2160x24 \
+    -screen 1 3840x2160x24 \
+    -screen 2 1920x1080x24 &
+XVFB_PID=$!
+trap 'kill $XVFB_PID' EXIT
+sleep 1
+
+DISPLAY="$DISPLAY_NUMBER" "$BENCH" x11
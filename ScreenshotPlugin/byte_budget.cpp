@@ -0,0 +1,310 @@
+#include "byte_budget.h"
+#include "image_pipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <utility>
+
+namespace
+{
+// Trial encodes cover kTrialBands bands spread over the image, each a
+// multiple of the 16-row MCU so JPEG blocks line up as in the full image
+const int kTrialBands = 8;
+const int kTrialBandAlign = 16;
+
+// Smallest scale the budget shrinks the image to
+const double kMinScale = 0.1;
+
+// Plans aim this far under the budget, so that the model's usual error
+// does not cost a second encode
+const double kPlanMargin = 0.97;
+
+// A result this close under the budget is not worth a second encode
+const double kCloseEnough = 0.85;
+
+// Scaling down aims this far under the predicted size, as resampling
+// smooths less than the square of the scale suggests
+const double kScaleMargin = 0.95;
+
+// Limits on a learnt correction; beyond them the model is simply wrong
+const double kMinCorrection = 0.25;
+const double kMaxCorrection = 4.0;
+
+// Predicts full encodes of one image from a band sample of it
+class SizeModel
+{
+public:
+    SizeModel(const ImageView &image, const BudgetEncoder &encode) : encode_(encode)
+    {
+        int bandRows = image.height / (kTrialBands * kTrialBands) / kTrialBandAlign * kTrialBandAlign;
+        if (bandRows < kTrialBandAlign)
+        {
+            bandRows = kTrialBandAlign;
+        }
+        if (bandRows * kTrialBands * 2 > image.height)
+        {
+            // Small enough to try whole
+            sample_ = image;
+            fraction_ = 1;
+            return;
+        }
+        sampleFrame_ = Frame(image.width, bandRows * kTrialBands, image.format);
+        size_t rowBytes = static_cast<size_t>(image.width) * bytesPerPixel(image.format);
+        for (int band = 0; band < kTrialBands; ++band)
+        {
+            // Centred in each eighth of the image
+            int top = (image.height * (2 * band + 1) / (2 * kTrialBands) - bandRows / 2) / kTrialBandAlign * kTrialBandAlign;
+            for (int y = 0; y < bandRows; ++y)
+            {
+                memcpy(sampleFrame_.row(band * bandRows + y), image.row(top + y), rowBytes);
+            }
+        }
+        sample_ = sampleFrame_.view();
+        fraction_ = static_cast<double>(sample_.height) / image.height;
+    }
+
+    // Predicted bytes of the full image at quality, 0 when encoding fails
+    size_t predict(int quality)
+    {
+        std::map<int, size_t>::const_iterator found = predictions_.find(quality);
+        if (found != predictions_.end())
+        {
+            return found->second;
+        }
+        EncodedImage encoded;
+        size_t predicted = encode_(sample_, quality, encoded) ? static_cast<size_t>(encoded.bytes.size() / fraction_) : 0;
+        predictions_[quality] = predicted;
+        if (fraction_ == 1 && predicted)
+        {
+            whole_[quality] = std::move(encoded);
+        }
+        return predicted;
+    }
+
+    // Moves the trial encode at quality into out when it was of the whole
+    // image, so it need not be encoded again
+    bool takeWhole(int quality, EncodedImage &out)
+    {
+        std::map<int, EncodedImage>::iterator found = whole_.find(quality);
+        if (found == whole_.end())
+        {
+            return false;
+        }
+        out = std::move(found->second);
+        whole_.erase(found);
+        return true;
+    }
+
+private:
+    const BudgetEncoder &encode_;
+    Frame sampleFrame_;
+    ImageView sample_;
+    double fraction_;
+    std::map<int, size_t> predictions_;
+    std::map<int, EncodedImage> whole_;
+};
+
+// Highest quality in [kMinBudgetQuality, maxQuality] predicted to fit in
+// target bytes; kMinBudgetQuality when none does. The search gallops out
+// from guess, so a guess off by one or two costs two or three trials, and
+// bisects once the answer is bracketed. Sets predicted to the chosen
+// quality's predicted size, 0 when encoding fails.
+int fitQuality(SizeModel &model, double target, int maxQuality, int guess, size_t &predicted)
+{
+    int minQuality = std::min(kMinBudgetQuality, maxQuality);
+    // Qualities up to fits are known to fit, those from fails on not to
+    int fits = minQuality - 1;
+    int fails = maxQuality + 1;
+    int quality = std::max(minQuality, std::min(maxQuality, guess));
+    for (int step = 1; fails - fits > 1; step *= 2)
+    {
+        size_t size = model.predict(quality);
+        if (size == 0)
+        {
+            predicted = 0;
+            return quality;
+        }
+        if (size <= target)
+        {
+            fits = quality;
+        }
+        else
+        {
+            fails = quality;
+        }
+        if (fits >= minQuality && fails <= maxQuality)
+        {
+            quality = fits + (fails - fits) / 2;
+        }
+        else if (size <= target)
+        {
+            quality = std::min(fails - 1, quality + step);
+        }
+        else
+        {
+            quality = std::max(fits + 1, quality - step);
+        }
+    }
+    int chosen = fits >= minQuality ? fits : minQuality;
+    predicted = model.predict(chosen);
+    return chosen;
+}
+
+// image scaled by scale, in storage when it is scaled at all
+ImageView scaledImage(const ImageView &image, double scale, ResampleFilter filter, int threads, Frame &storage)
+{
+    if (scale >= 1)
+    {
+        return image;
+    }
+    int width = std::max(1, static_cast<int>(image.width * scale + 0.5));
+    int height = std::max(1, static_cast<int>(image.height * scale + 0.5));
+    storage = Frame(width, height, image.format);
+    downscaleImage(image, storage.mutableView(), filter, threads);
+    return storage.view();
+}
+
+// Sets params' scale and quality for a full encode of image predicted to
+// take target bytes at most, starting from their current values; quality is
+// lowered first and then the scale. Returns the uncorrected prediction, 0
+// when encoding fails. Small images are tried whole; encoded then receives
+// the planned encode itself, and is left empty otherwise.
+size_t planEncode(const ImageView &image, double target, int maxQuality, ResampleFilter filter, int threads, const BudgetEncoder &encode,
+                  BudgetParams &params, EncodedImage &encoded)
+{
+    encoded = EncodedImage();
+    for (;;)
+    {
+        Frame storage;
+        SizeModel model(scaledImage(image, params.scale, filter, threads, storage), encode);
+        size_t predicted;
+        if (maxQuality >= 0)
+        {
+            params.quality = fitQuality(model, target, maxQuality, params.quality, predicted);
+        }
+        else
+        {
+            predicted = model.predict(-1);
+        }
+        if (predicted == 0 || predicted <= target || params.scale <= kMinScale)
+        {
+            model.takeWhole(params.quality, encoded);
+            return predicted;
+        }
+        // Bytes go roughly with the pixel count
+        params.scale = std::max(kMinScale, params.scale * std::sqrt(target / predicted) * kScaleMargin);
+    }
+}
+
+// Parameters of the last budgeted encode of each layout
+std::mutex cacheMutex;
+std::map<std::string, BudgetParams> paramCache;
+
+bool cachedParams(const std::string &key, BudgetParams &params)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::map<std::string, BudgetParams>::const_iterator found = paramCache.find(key);
+    if (found == paramCache.end())
+    {
+        return false;
+    }
+    params = found->second;
+    return true;
+}
+
+void storeParams(const std::string &key, const BudgetParams &params)
+{
+    // Layouts rarely change, so a handful of entries covers every capture;
+    // the cache starts over if they keep changing
+    const size_t maxEntries = 32;
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (paramCache.size() >= maxEntries && paramCache.find(key) == paramCache.end())
+    {
+        paramCache.clear();
+    }
+    paramCache[key] = params;
+}
+} // namespace
+
+bool encodeWithinBudget(const ImageView &image, size_t maxBytes, int maxQuality, const std::string &cacheKey, ResampleFilter filter, int threads,
+                        const BudgetEncoder &encode, EncodedImage &out, BudgetParams *chosen)
+{
+    BudgetParams params;
+    params.quality = maxQuality;
+    if (cachedParams(cacheKey, params))
+    {
+        params.quality = std::min(params.quality, maxQuality);
+    }
+
+    // Up to two encodes from the model, each correcting it for the next
+    EncodedImage best;
+    BudgetParams bestParams;
+    bool fitted = false;
+    EncodedImage encoded;
+    for (int attempt = 0; attempt < 2; ++attempt)
+    {
+        size_t predicted = planEncode(image, maxBytes * kPlanMargin / params.correction, maxQuality, filter, threads, encode, params, encoded);
+        if (predicted == 0)
+        {
+            return false;
+        }
+        if (fitted && params.scale == bestParams.scale && params.quality == bestParams.quality)
+        {
+            // The corrected model settles where the last encode did
+            break;
+        }
+        Frame storage;
+        if (encoded.bytes.empty() && !encode(scaledImage(image, params.scale, filter, threads, storage), params.quality, encoded))
+        {
+            return false;
+        }
+        size_t size = encoded.bytes.size();
+        params.correction = std::max(kMinCorrection, std::min(kMaxCorrection, static_cast<double>(size) / predicted));
+        if (size > maxBytes)
+        {
+            continue;
+        }
+        if (!fitted || size > best.bytes.size())
+        {
+            best = std::move(encoded);
+            bestParams = params;
+            fitted = true;
+        }
+        bool atBest = params.scale >= 1 && (maxQuality < 0 || params.quality >= maxQuality);
+        if (atBest || best.bytes.size() >= maxBytes * kCloseEnough)
+        {
+            break;
+        }
+        // Room to spare: the corrected model may allow more
+        params.scale = std::min(1.0, params.scale / kScaleMargin);
+    }
+
+    if (!fitted)
+    {
+        // Missed twice: shrink by the measured excess and take what comes
+        params.scale =
+            std::max(kMinScale, params.scale * std::sqrt(static_cast<double>(maxBytes) / encoded.bytes.size()) * kScaleMargin * kScaleMargin);
+        Frame storage;
+        best = EncodedImage();
+        if (!encode(scaledImage(image, params.scale, filter, threads, storage), params.quality, best))
+        {
+            return false;
+        }
+        bestParams = params;
+        if (best.bytes.size() > maxBytes)
+        {
+            std::cerr << "Byte budget of " << maxBytes << " missed: " << best.bytes.size() << " bytes at the smallest size tried.\n";
+        }
+    }
+    storeParams(cacheKey, bestParams);
+    if (chosen)
+    {
+        *chosen = bestParams;
+    }
+    out = std::move(best);
+    return true;
+}
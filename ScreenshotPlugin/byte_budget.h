@@ -0,0 +1,44 @@
+#pragma once
+
+#include "image.h"
+#include "image_pipeline.h"
+#include "resample.h"
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+// Fitting an encoded composite under a byte budget. Sizes are predicted
+// from trial encodes of a few bands of rows (about an eighth of the image),
+// so the search over quality and resolution costs a fraction of a full
+// encode; the full encode then usually lands under the budget the first
+// time. Quality is lowered first, down to kMinBudgetQuality, and only then
+// the resolution.
+
+// Lowest quality the budget search goes to before scaling the image down
+const int kMinBudgetQuality = 40;
+
+// Encodes image at quality (-1 for formats without one) into out
+typedef std::function<bool(const ImageView &image, int quality, EncodedImage &out)> BudgetEncoder;
+
+// What a budgeted encode settled on
+struct BudgetParams
+{
+    double scale;      // of the image's width and height, (0, 1]
+    int quality;       // -1 for formats without one
+    double correction; // full-encode bytes over predicted bytes, learnt from the last encode
+
+    BudgetParams() : scale(1), quality(-1), correction(1) {}
+};
+
+// Encodes image with encode, at most maxQuality and scaled by at most 1, into
+// no more than maxBytes. Takes one full encode when the prediction holds and
+// a second when it misses or leaves more than 15% of the budget unused;
+// only when the second misses too is the image shrunk by the measured
+// excess once more. The parameters are remembered under cacheKey (the
+// monitor layout), so the next capture of the same layout starts from them.
+// False when encoding fails; a result that still exceeds the budget is kept
+// and reported. out is the chosen encode as encode produced it.
+bool encodeWithinBudget(const ImageView &image, size_t maxBytes, int maxQuality, const std::string &cacheKey, ResampleFilter filter, int threads,
+                        const BudgetEncoder &encode, EncodedImage &out, BudgetParams *chosen = nullptr);
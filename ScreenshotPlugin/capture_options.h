@@ -0,0 +1,63 @@
+#pragma once
+
+#include "image_format.h"
+#include "jpeg_writer.h"
+#include "layout.h"
+#include "palette.h"
+#include "resample.h"
+#include "webp_writer.h"
+
+#include <cstddef>
+
+// Per-capture settings. The plugin fills them from the JSON options string
+// passed to CaptureScreenshotWithOptions; the defaults match
+// CaptureScreenshot.
+struct CaptureOptions
+{
+    // Desktop captures are always fully opaque, so by default composites are
+    // built and encoded as 3-byte RGB (3-channel PNG/JPEG). Turn off to keep
+    // the source's 4-byte pixels, alpha included, all the way to the file.
+    bool opaque;
+
+    // Filter used to scale monitors into collages and PIP insets
+    ResampleFilter filter;
+
+    // Threads scaling and compositing may use; 0 means every thread of the
+    // shared pool
+    int threads;
+
+    // Arrangement of the monitors; Auto keeps the collage or PIP layout the
+    // caller asked for
+    LayoutSpec layout;
+
+    // Also write the encoded composite to <base>_output.<extension of the
+    // format>, in the background; the upload always uses the in-memory copy
+    bool saveFile;
+
+    // Deflate level for PNG output, in the range of the build's backend
+    // (deflate.h); -1 uses its default. Lower is faster, higher smaller.
+    int pngLevel;
+
+    // Whether PNG output may be written with a palette: only when the colours
+    // fit (lossless), or always, quantized to 256 colours when they do not
+    PngPalette pngPalette;
+
+    // Format of the composite; Auto picks PNG or JPEG by layout, Adaptive
+    // indexed PNG, PNG or JPEG by content
+    ImageFormat format;
+
+    // Upper bound on the encoded composite in bytes, kept by lowering the
+    // quality of lossy output and then the resolution; 0 for none
+    size_t maxBytes;
+
+    // Quality, chroma subsampling, Huffman tables and backend of JPEG output
+    JpegOptions jpeg;
+
+    // Lossless or lossy, quality and method of WebP output
+    WebpOptions webp;
+
+    CaptureOptions() : opaque(true), filter(ResampleFilter::Box), threads(0), saveFile(true), pngLevel(-1), pngPalette(PngPalette::Off),
+                       format(ImageFormat::Auto), maxBytes(0)
+    {
+    }
+};
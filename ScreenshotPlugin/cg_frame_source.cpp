@@ -0,0 +1,104 @@
+#include "frame_source.h"
+
+#include <ApplicationServices/ApplicationServices.h>
+#include <CoreGraphics/CoreGraphics.h>
+
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+
+// Captures active displays with CGDisplayCreateImage. The CFData holding the
+// pixels is retained until the next acquire so frames are handed out without a
+// copy, with CoreGraphics' own bytes-per-row.
+class CoreGraphicsFrameSource : public FrameSource
+{
+public:
+    ~CoreGraphicsFrameSource() override
+    {
+        for (size_t i = 0; i < data_.size(); ++i)
+        {
+            if (data_[i])
+            {
+                CFRelease(data_[i]);
+            }
+        }
+    }
+
+    const char *name() const override { return "coregraphics"; }
+
+    std::vector<OutputInfo> enumerateOutputs() override
+    {
+        uint32_t displayCount = 0;
+        CGGetActiveDisplayList(0, NULL, &displayCount);
+        displays_.resize(displayCount);
+        CGGetActiveDisplayList(displayCount, displays_.data(), &displayCount);
+        displays_.resize(displayCount);
+        data_.resize(displayCount, NULL);
+
+        std::vector<OutputInfo> outputs;
+        for (uint32_t i = 0; i < displayCount; ++i)
+        {
+            CGRect bounds = CGDisplayBounds(displays_[i]);
+            OutputInfo output;
+            std::ostringstream name;
+            name << "CGDisplay-" << displays_[i];
+            output.name = name.str();
+            output.x = static_cast<int>(bounds.origin.x);
+            output.y = static_cast<int>(bounds.origin.y);
+            output.width = static_cast<int>(CGDisplayPixelsWide(displays_[i]));
+            output.height = static_cast<int>(CGDisplayPixelsHigh(displays_[i]));
+            output.primary = CGDisplayIsMain(displays_[i]) != 0;
+            outputs.push_back(output);
+        }
+        return outputs;
+    }
+
+    bool acquireFrame(size_t outputIndex, CapturedFrame &frame) override
+    {
+        if (outputIndex >= displays_.size())
+        {
+            return false;
+        }
+
+        CGImageRef screenshot = CGDisplayCreateImage(displays_[outputIndex]);
+        if (!screenshot)
+        {
+            std::cerr << "Failed to capture display " << displays_[outputIndex] << std::endl;
+            return false;
+        }
+        if (CGImageGetBitsPerPixel(screenshot) != 32)
+        {
+            std::cerr << "Unsupported display depth " << CGImageGetBitsPerPixel(screenshot) << std::endl;
+            CGImageRelease(screenshot);
+            return false;
+        }
+
+        if (data_[outputIndex])
+        {
+            CFRelease(data_[outputIndex]);
+        }
+        data_[outputIndex] = CGDataProviderCopyData(CGImageGetDataProvider(screenshot));
+
+        frame.width = static_cast<int>(CGImageGetWidth(screenshot));
+        frame.height = static_cast<int>(CGImageGetHeight(screenshot));
+        frame.stride = static_cast<int>(CGImageGetBytesPerRow(screenshot));
+        frame.format = PixelFormat::BGRA8;
+        frame.pixels = CFDataGetBytePtr(data_[outputIndex]);
+
+        CGImageRelease(screenshot);
+        return true;
+    }
+
+private:
+    std::vector<CGDirectDisplayID> displays_;
+    std::vector<CFDataRef> data_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> createCoreGraphicsFrameSource()
+{
+    return std::unique_ptr<FrameSource>(new CoreGraphicsFrameSource());
+}
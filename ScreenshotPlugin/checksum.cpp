@@ -0,0 +1,260 @@
+#include "checksum.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const uint32_t kAdlerBase = 65521;
+
+// Most bytes Adler-32 can add up before s2 may overflow 32 bits
+const size_t kAdlerMaxRun = 5552;
+
+// Slicing-by-8 tables: entries[k][n] is the CRC of byte n followed by k
+// zero bytes, so eight bytes fold into the state with eight lookups
+struct CrcTables
+{
+    uint32_t entries[8][256];
+
+    CrcTables()
+    {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+            {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            entries[0][n] = c;
+        }
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            for (int k = 1; k < 8; ++k)
+            {
+                entries[k][n] = entries[0][entries[k - 1][n] & 0xff] ^ (entries[k - 1][n] >> 8);
+            }
+        }
+    }
+};
+
+const CrcTables crcTables;
+
+// Both scalar kernels work on the running state: the inverted CRC, and the
+// Adler sums split into s1 and s2
+
+uint32_t crc32Scalar(uint32_t state, const unsigned char *data, size_t len)
+{
+    const uint32_t(*t)[256] = crcTables.entries;
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        uint32_t low = state ^ (data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24));
+        state = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24] ^ t[3][data[4]] ^ t[2][data[5]] ^
+                t[1][data[6]] ^ t[0][data[7]];
+    }
+    for (; len; ++data, --len)
+    {
+        state = t[0][(state ^ *data) & 0xff] ^ (state >> 8);
+    }
+    return state;
+}
+
+void adler32Scalar(uint32_t &sum1, uint32_t &sum2, const unsigned char *data, size_t len)
+{
+    // Local copies: data may alias the references, which would keep the sums
+    // in memory
+    uint32_t s1 = sum1;
+    uint32_t s2 = sum2;
+    while (len)
+    {
+        size_t run = std::min(len, kAdlerMaxRun);
+        len -= run;
+        size_t i = 0;
+        for (; i + 4 <= run; i += 4)
+        {
+            s1 += data[i];
+            s2 += s1;
+            s1 += data[i + 1];
+            s2 += s1;
+            s1 += data[i + 2];
+            s2 += s1;
+            s1 += data[i + 3];
+            s2 += s1;
+        }
+        for (; i < run; ++i)
+        {
+            s1 += data[i];
+            s2 += s1;
+        }
+        data += run;
+        s1 %= kAdlerBase;
+        s2 %= kAdlerBase;
+    }
+    sum1 = s1;
+    sum2 = s2;
+}
+
+#if defined(SCREENSHOT_SIMD_X86)
+
+// CRC-32 by carry-less multiplication (Gopal et al., "Fast CRC Computation
+// for Generic Polynomials Using PCLMULQDQ", Intel 2009): four 128-bit lanes
+// are folded 64 bytes at a time, then into one lane, then reduced to 32 bits
+// with Barrett reduction. len is a multiple of 16 and at least 64.
+SIMD_TARGET("sse4.1,pclmul")
+uint32_t crc32Pclmul(uint32_t state, const unsigned char *data, size_t len)
+{
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), _mm_cvtsi32_si128(static_cast<int>(state)));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48));
+    data += 64;
+    len -= 64;
+    for (; len >= 64; data += 64, len -= 64)
+    {
+        __m128i f1 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i f2 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i f3 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i f4 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k1k2, 0x11), f1), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+        x2 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x2, k1k2, 0x11), f2), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x3, k1k2, 0x11), f3), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x4, k1k2, 0x11), f4), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 48)));
+    }
+
+    // Four lanes into one, then the remaining 16-byte blocks
+    const __m128i lanes[3] = {x2, x3, x4};
+    for (const __m128i &next : lanes)
+    {
+        __m128i f = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), f), next);
+    }
+    for (; len >= 16; data += 16, len -= 16)
+    {
+        __m128i f = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+        x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1, k3k4, 0x11), f), _mm_loadu_si128(reinterpret_cast<const __m128i *>(data)));
+    }
+
+    // 128 bits to 64
+    __m128i f = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), f);
+    f = _mm_srli_si128(x1, 4);
+    x1 = _mm_xor_si128(_mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5, 0x00), f);
+
+    // Barrett reduction to 32 bits
+    f = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+    f = _mm_clmulepi64_si128(_mm_and_si128(f, low32), poly, 0x00);
+    return static_cast<uint32_t>(_mm_extract_epi32(_mm_xor_si128(x1, f), 1));
+}
+
+// Adler-32 32 bytes at a time: psadbw sums the bytes for s1, and pmaddubsw
+// weighs them by their distance from the end of the block for s2. Each run
+// stays within kAdlerMaxRun so the lanes cannot overflow.
+SIMD_TARGET("ssse3")
+void adler32Ssse3(uint32_t &s1, uint32_t &s2, const unsigned char *data, size_t len)
+{
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    size_t blocks = len / 32;
+    while (blocks)
+    {
+        size_t n = std::min(blocks, kAdlerMaxRun / 32);
+        blocks -= n;
+        // sumsBefore collects s1 at the start of every block; each one
+        // counts 32 times into s2
+        __m128i sumsBefore = _mm_cvtsi32_si128(static_cast<int>(s1 * n));
+        __m128i sum1 = zero;
+        __m128i sum2 = _mm_cvtsi32_si128(static_cast<int>(s2));
+        for (; n; --n, data += 32)
+        {
+            __m128i bytes1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+            __m128i bytes2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16));
+            sumsBefore = _mm_add_epi32(sumsBefore, sum1);
+            sum1 = _mm_add_epi32(sum1, _mm_add_epi32(_mm_sad_epu8(bytes1, zero), _mm_sad_epu8(bytes2, zero)));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes1, tap1), ones));
+            sum2 = _mm_add_epi32(sum2, _mm_madd_epi16(_mm_maddubs_epi16(bytes2, tap2), ones));
+        }
+        sum2 = _mm_add_epi32(sum2, _mm_slli_epi32(sumsBefore, 5));
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum1 = _mm_add_epi32(sum1, _mm_shuffle_epi32(sum1, _MM_SHUFFLE(1, 0, 3, 2)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(2, 3, 0, 1)));
+        sum2 = _mm_add_epi32(sum2, _mm_shuffle_epi32(sum2, _MM_SHUFFLE(1, 0, 3, 2)));
+        s1 = (s1 + static_cast<uint32_t>(_mm_cvtsi128_si32(sum1))) % kAdlerBase;
+        s2 = static_cast<uint32_t>(_mm_cvtsi128_si32(sum2)) % kAdlerBase;
+    }
+    adler32Scalar(s1, s2, data, len % 32);
+}
+
+#endif
+
+// Picked once, like the pixel kernels
+struct ChecksumKernels
+{
+    bool pclmul;
+    bool ssse3;
+
+    ChecksumKernels() : pclmul(false), ssse3(false)
+    {
+#if defined(SCREENSHOT_SIMD_X86)
+        const CpuFeatures &features = cpuFeatures();
+        pclmul = features.pclmul && features.sse41;
+        ssse3 = features.ssse3;
+#endif
+    }
+};
+
+const ChecksumKernels checksumKernels;
+
+} // namespace
+
+uint32_t crc32Update(uint32_t crc, const unsigned char *data, size_t len)
+{
+    uint32_t state = ~crc;
+#if defined(SCREENSHOT_SIMD_X86)
+    if (checksumKernels.pclmul && len >= 64)
+    {
+        const size_t folded = len & ~static_cast<size_t>(15);
+        state = crc32Pclmul(state, data, folded);
+        data += folded;
+        len -= folded;
+    }
+#endif
+    return ~crc32Scalar(state, data, len);
+}
+
+uint32_t adler32Update(uint32_t adler, const unsigned char *data, size_t len)
+{
+    uint32_t s1 = adler & 0xffff;
+    uint32_t s2 = adler >> 16;
+#if defined(SCREENSHOT_SIMD_X86)
+    if (checksumKernels.ssse3 && len >= 64)
+    {
+        adler32Ssse3(s1, s2, data, len);
+        return (s2 << 16) | s1;
+    }
+#endif
+    adler32Scalar(s1, s2, data, len);
+    return (s2 << 16) | s1;
+}
+
+uint32_t adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t lenB)
+{
+    // s1 = 1 + sum(bytes), s2 = sum of the running s1 values, both mod 65521.
+    // Appending B adds B's byte sum (minus its initial 1) to s1, and to s2
+    // adds B's own s2 plus lenB times A's s1 (minus the 1 B started from).
+    uint32_t rem = static_cast<uint32_t>(lenB % kAdlerBase);
+    uint32_t sumA1 = adlerA & 0xffff;
+    uint32_t sumA2 = adlerA >> 16;
+    uint32_t sumB1 = adlerB & 0xffff;
+    uint32_t sumB2 = adlerB >> 16;
+    uint32_t sum1 = (sumA1 + sumB1 + kAdlerBase - 1) % kAdlerBase;
+    uint32_t sum2 = static_cast<uint32_t>((static_cast<uint64_t>(rem) * sumA1 + sumA2 + sumB2 + kAdlerBase - rem) % kAdlerBase);
+    return (sum2 << 16) | sum1;
+}
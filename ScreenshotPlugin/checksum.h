@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// The PNG writer's checksums: CRC-32 over every chunk and Adler-32 over the
+// zlib stream of striped builds. Large buffers go through PCLMUL (CRC) and
+// SSSE3 (Adler) kernels picked from cpuFeatures(); the rest, and other
+// CPUs, use table-driven and plain scalar code.
+
+// CRC-32 (ISO 3309, as in PNG and gzip) of data, continuing from crc (0 for
+// a new checksum)
+uint32_t crc32Update(uint32_t crc, const unsigned char *data, size_t len);
+
+// Adler-32 of data, continuing from adler (1 for a new stream)
+uint32_t adler32Update(uint32_t adler, const unsigned char *data, size_t len);
+
+// Adler-32 of A followed by B from the checksums of A and B alone, so stripes
+// can be summed in parallel
+uint32_t adler32Combine(uint32_t adlerA, uint32_t adlerB, size_t lenB);
@@ -0,0 +1,280 @@
+#include "content_analysis.h"
+#include "cpu_features.h"
+#include "palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+namespace
+{
+
+// Rows sampled from the image, evenly spaced
+const int kSampleRows = 128;
+
+// Every kColorStep-th pixel of a sampled row goes into the colour count
+const int kColorStep = 4;
+
+// A step of at least 2^k counts towards counts[k]
+const int kStepClasses = 8;
+
+// Adds, for each k, the number of channel steps |row[i + bpp] - row[i]| of
+// at least 2^k along the row to counts[k]. With 4-byte pixels the fourth
+// byte is left out (its steps count as 0).
+typedef void (*StepCounter)(const unsigned char *row, int rowBytes, int bpp, uint64_t counts[kStepClasses]);
+
+void countStepsScalar(const unsigned char *row, int rowBytes, int bpp, uint64_t counts[kStepClasses])
+{
+    for (int i = 0; i + bpp < rowBytes; ++i)
+    {
+        if (bpp == 4 && (i & 3) == 3)
+        {
+            continue;
+        }
+        int step = std::abs(row[i + bpp] - row[i]);
+        for (int k = 0; k < kStepClasses && step >= (1 << k); ++k)
+        {
+            ++counts[k];
+        }
+    }
+}
+
+#if defined(SCREENSHOT_SIMD_X86)
+
+// Per-class byte counters are bumped by subtracting the compare masks (-1)
+// and flushed into 64-bit sums with SAD before they can wrap at 255
+
+SIMD_TARGET("sse2")
+void countStepsSse2(const unsigned char *row, int rowBytes, int bpp, uint64_t counts[kStepClasses])
+{
+    const int steps = rowBytes - bpp;
+    const __m128i keep = bpp == 4 ? _mm_set1_epi32(0x00ffffff) : _mm_set1_epi8(-1);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i thresholds[kStepClasses], counters[kStepClasses], sums[kStepClasses];
+    for (int k = 0; k < kStepClasses; ++k)
+    {
+        thresholds[k] = _mm_set1_epi8(static_cast<char>(1 << k));
+        counters[k] = zero;
+        sums[k] = zero;
+    }
+    int i = 0;
+    int pending = 0;
+    for (; i + 16 <= steps; i += 16)
+    {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i + bpp));
+        __m128i step = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a)), keep);
+        for (int k = 0; k < kStepClasses; ++k)
+        {
+            counters[k] = _mm_sub_epi8(counters[k], _mm_cmpeq_epi8(_mm_max_epu8(step, thresholds[k]), step));
+        }
+        if (++pending == 255)
+        {
+            for (int k = 0; k < kStepClasses; ++k)
+            {
+                sums[k] = _mm_add_epi64(sums[k], _mm_sad_epu8(counters[k], zero));
+                counters[k] = zero;
+            }
+            pending = 0;
+        }
+    }
+    for (int k = 0; k < kStepClasses; ++k)
+    {
+        sums[k] = _mm_add_epi64(sums[k], _mm_sad_epu8(counters[k], zero));
+        uint64_t lanes[2];
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sums[k]);
+        counts[k] += lanes[0] + lanes[1];
+    }
+    countStepsScalar(row + i, rowBytes - i, bpp, counts);
+}
+
+SIMD_TARGET("avx2")
+void countStepsAvx2(const unsigned char *row, int rowBytes, int bpp, uint64_t counts[kStepClasses])
+{
+    const int steps = rowBytes - bpp;
+    const __m256i keep = bpp == 4 ? _mm256_set1_epi32(0x00ffffff) : _mm256_set1_epi8(-1);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i thresholds[kStepClasses], counters[kStepClasses], sums[kStepClasses];
+    for (int k = 0; k < kStepClasses; ++k)
+    {
+        thresholds[k] = _mm256_set1_epi8(static_cast<char>(1 << k));
+        counters[k] = zero;
+        sums[k] = zero;
+    }
+    int i = 0;
+    int pending = 0;
+    for (; i + 32 <= steps; i += 32)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i + bpp));
+        __m256i step = _mm256_and_si256(_mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a)), keep);
+        for (int k = 0; k < kStepClasses; ++k)
+        {
+            counters[k] = _mm256_sub_epi8(counters[k], _mm256_cmpeq_epi8(_mm256_max_epu8(step, thresholds[k]), step));
+        }
+        if (++pending == 255)
+        {
+            for (int k = 0; k < kStepClasses; ++k)
+            {
+                sums[k] = _mm256_add_epi64(sums[k], _mm256_sad_epu8(counters[k], zero));
+                counters[k] = zero;
+            }
+            pending = 0;
+        }
+    }
+    for (int k = 0; k < kStepClasses; ++k)
+    {
+        sums[k] = _mm256_add_epi64(sums[k], _mm256_sad_epu8(counters[k], zero));
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sums[k]);
+        counts[k] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    // i is a multiple of 4, so the scalar tail keeps skipping the right bytes
+    countStepsScalar(row + i, rowBytes - i, bpp, counts);
+}
+
+#endif
+
+StepCounter selectStepCounter()
+{
+    // cpuFeatures() applies the SCREENSHOT_SIMD cap; "scalar" turns SSE2 off too
+#if defined(SCREENSHOT_SIMD_X86)
+    const CpuFeatures &features = cpuFeatures();
+    if (features.avx2)
+    {
+        return countStepsAvx2;
+    }
+    if (features.ssse3)
+    {
+        return countStepsSse2;
+    }
+#endif
+    return countStepsScalar;
+}
+
+const StepCounter countSteps = selectStepCounter();
+
+// Adds the sampled pixels of one row to the colour table; false once it is
+// full
+template <int R, int G, int B, int A, int Bpp>
+bool sampleColors(const unsigned char *row, int width, PaletteTable &table)
+{
+    for (int x = 0; x < width; x += kColorStep)
+    {
+        const unsigned char *px = row + x * Bpp;
+        if (table.insert(packRgba(px[R], px[G], px[B], A < 0 ? 255 : px[A < 0 ? 0 : A])) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sampleRowColors(const unsigned char *row, int width, PixelFormat format, PaletteTable &table)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRA8:
+        return sampleColors<2, 1, 0, 3, 4>(row, width, table);
+    case PixelFormat::BGRX8:
+        return sampleColors<2, 1, 0, -1, 4>(row, width, table);
+    case PixelFormat::BGR8:
+        return sampleColors<2, 1, 0, -1, 3>(row, width, table);
+    case PixelFormat::RGBA8:
+        return sampleColors<0, 1, 2, 3, 4>(row, width, table);
+    case PixelFormat::RGB8:
+        return sampleColors<0, 1, 2, -1, 3>(row, width, table);
+    }
+    return false;
+}
+
+// Thresholds of chooseContentEncoding(), from synthetic desktops and real
+// captures: UI keeps most steps at 0 and its entropy at 0.5-1.4 bits even
+// with anti-aliased text, while camera noise and video spread over the
+// middle classes (2.2 bits and up) with few flat steps
+const double kPhotoEntropy = 1.8;
+const double kPhotoFlatShare = 0.35;
+
+} // namespace
+
+ContentStats analyzeContent(const ImageView &image)
+{
+    ContentStats stats;
+    if (!image.pixels || image.width <= 0 || image.height <= 0)
+    {
+        return stats;
+    }
+
+    const int bpp = bytesPerPixel(image.format);
+    const int rowBytes = image.width * bpp;
+    const int rowStep = std::max(image.height / kSampleRows, 1);
+    uint64_t counts[kStepClasses] = {0};
+    uint64_t steps = 0;
+    PaletteTable table;
+    bool colorsFit = true;
+    for (int y = rowStep / 2; y < image.height; y += rowStep)
+    {
+        const unsigned char *row = image.pixels + static_cast<size_t>(y) * image.stride;
+        countSteps(row, rowBytes, bpp, counts);
+        steps += static_cast<uint64_t>(image.width - 1) * 3;
+        if (colorsFit)
+        {
+            colorsFit = sampleRowColors(row, image.width, image.format, table);
+        }
+        stats.sampledPixels += image.width;
+    }
+    stats.uniqueColors = colorsFit ? table.size() : kMaxPaletteColors + 1;
+    if (!steps)
+    {
+        stats.flatShare = 1;
+        return stats;
+    }
+
+    // Magnitude classes: 0, then [2^(k-1), 2^k) for k = 1..7, then 128+
+    double classes[kStepClasses + 1];
+    classes[0] = static_cast<double>(steps - counts[0]);
+    for (int k = 1; k < kStepClasses; ++k)
+    {
+        classes[k] = static_cast<double>(counts[k - 1] - counts[k]);
+    }
+    classes[kStepClasses] = static_cast<double>(counts[kStepClasses - 1]);
+    for (double count : classes)
+    {
+        if (count > 0)
+        {
+            double p = count / steps;
+            stats.gradientEntropy -= p * std::log2(p);
+        }
+    }
+    stats.edgeDensity = static_cast<double>(counts[5]) / steps;
+    stats.flatShare = classes[0] / steps;
+    return stats;
+}
+
+const char *contentEncodingName(ContentEncoding encoding)
+{
+    switch (encoding)
+    {
+    case ContentEncoding::IndexedPng:
+        return "indexed-png";
+    case ContentEncoding::Png:
+        return "png";
+    case ContentEncoding::Jpeg:
+        return "jpeg";
+    }
+    return "unknown";
+}
+
+ContentEncoding chooseContentEncoding(const ContentStats &stats)
+{
+    if (stats.sampledPixels && stats.uniqueColors <= kMaxPaletteColors)
+    {
+        return ContentEncoding::IndexedPng;
+    }
+    if (stats.gradientEntropy >= kPhotoEntropy && stats.flatShare < kPhotoFlatShare)
+    {
+        return ContentEncoding::Jpeg;
+    }
+    return ContentEncoding::Png;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "image.h"
+
+// Cheap statistics of a composite that tell UI-like content (few colours,
+// flat areas, sharp text edges) from photographic or video content. They are
+// measured on a grid of sampled rows: every pixel step along those rows for
+// the gradients, every fourth pixel for the colours.
+struct ContentStats
+{
+    int sampledPixels;
+    int uniqueColors;       // distinct colours among the samples, capped at kMaxPaletteColors + 1
+    double edgeDensity;     // share of horizontal channel steps of 32 or more
+    double flatShare;       // share of horizontal channel steps of 0
+    double gradientEntropy; // Shannon entropy in bits of the steps' magnitude classes (0, 1, 2-3, 4-7, ..., 128-255): 0 to 3.17
+
+    ContentStats() : sampledPixels(0), uniqueColors(0), edgeDensity(0), flatShare(0), gradientEntropy(0) {}
+};
+
+// Gradient counts run through SIMD kernels picked from cpuFeatures(); the
+// colour count stops at the first colour a palette cannot hold
+ContentStats analyzeContent(const ImageView &image);
+
+// How a composite is best compressed
+enum class ContentEncoding
+{
+    IndexedPng, // at most 256 colours: exact palette, lossless and small
+    Png,        // UI and text with more colours: lossless
+    Jpeg        // photo or video content, where lossless output is large and JPEG's loss is invisible
+};
+
+// "indexed-png", "png" or "jpeg"
+const char *contentEncodingName(ContentEncoding encoding);
+
+ContentEncoding chooseContentEncoding(const ContentStats &stats);
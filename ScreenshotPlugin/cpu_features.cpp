@@ -0,0 +1,118 @@
+#include "cpu_features.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+#if defined(SCREENSHOT_SIMD_X86)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace
+{
+
+#if defined(SCREENSHOT_SIMD_X86)
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4])
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i)
+    {
+        regs[i] = static_cast<uint32_t>(info[i]);
+    }
+#else
+    __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+uint64_t xgetbv0()
+{
+#if defined(_MSC_VER)
+    return _xgetbv(0);
+#else
+    uint32_t eax = 0;
+    uint32_t edx = 0;
+    __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+    return (static_cast<uint64_t>(edx) << 32) | eax;
+#endif
+}
+
+#endif
+
+CpuFeatures cappedCpuFeatures()
+{
+    CpuFeatures features = detectCpuFeatures();
+
+    // Optional cap for A/B measurements
+    const char *cap = std::getenv("SCREENSHOT_SIMD");
+    if (!cap || !*cap)
+    {
+        return features;
+    }
+    std::string level(cap);
+    if (level == "scalar")
+    {
+        return CpuFeatures();
+    }
+    if (level == "ssse3")
+    {
+        features.sse41 = features.pclmul = features.avx2 = features.avx512bw = false;
+    }
+    else if (level == "avx2")
+    {
+        features.avx512bw = false;
+    }
+    return features;
+}
+
+} // namespace
+
+CpuFeatures detectCpuFeatures()
+{
+    CpuFeatures features;
+#if defined(SCREENSHOT_SIMD_X86)
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    uint32_t maxLeaf = regs[0];
+    if (maxLeaf < 1)
+    {
+        return features;
+    }
+
+    cpuid(1, 0, regs);
+    features.ssse3 = (regs[2] & (1u << 9)) != 0;
+    features.sse41 = (regs[2] & (1u << 19)) != 0;
+    features.pclmul = (regs[2] & (1u << 1)) != 0;
+    bool osxsave = (regs[2] & (1u << 27)) != 0;
+    if (!osxsave || maxLeaf < 7)
+    {
+        return features;
+    }
+
+    // The OS must save the YMM (and for AVX-512 the opmask/ZMM) state
+    uint64_t xcr0 = xgetbv0();
+    bool osAvx = (xcr0 & 0x6) == 0x6;
+    bool osAvx512 = (xcr0 & 0xe6) == 0xe6;
+
+    cpuid(7, 0, regs);
+    features.avx2 = osAvx && (regs[1] & (1u << 5)) != 0;
+    features.avx512bw = osAvx512 && (regs[1] & (1u << 16)) != 0 && (regs[1] & (1u << 30)) != 0;
+#elif defined(SCREENSHOT_SIMD_NEON)
+    features.neon = true;
+#endif
+    return features;
+}
+
+const CpuFeatures &cpuFeatures()
+{
+    // A function-local static so other translation units can use it during
+    // their own static initialisation
+    static const CpuFeatures features = cappedCpuFeatures();
+    return features;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+// Instruction-set detection shared by every SIMD kernel in the library.
+// Kernels are compiled per function for their instruction set (SIMD_TARGET)
+// so the rest of the library still runs on any x86-64, and are picked at
+// runtime from cpuFeatures().
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCREENSHOT_SIMD_X86 1
+#include <immintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define SCREENSHOT_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+// GCC and Clang need the instruction set enabled per function; MSVC accepts
+// the intrinsics as is.
+#if defined(SCREENSHOT_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+#define SIMD_TARGET(isa) __attribute__((target(isa)))
+#else
+#define SIMD_TARGET(isa)
+#endif
+
+struct CpuFeatures
+{
+    bool ssse3 = false;
+    bool sse41 = false;
+    bool pclmul = false;
+    bool avx2 = false;
+    bool avx512bw = false;
+    bool neon = false;
+};
+
+// Everything this CPU and OS support
+CpuFeatures detectCpuFeatures();
+
+// detectCpuFeatures() capped by SCREENSHOT_SIMD=scalar|ssse3|avx2|avx512,
+// resolved once on first use
+const CpuFeatures &cpuFeatures();
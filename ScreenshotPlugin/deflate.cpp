@@ -0,0 +1,180 @@
+#include "deflate.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#if defined(SCREENSHOT_DEFLATE_LIBDEFLATE)
+#include <libdeflate.h>
+#elif defined(SCREENSHOT_DEFLATE_ZLIB)
+#include <zlib.h>
+#endif
+
+#if defined(SCREENSHOT_DEFLATE_LIBDEFLATE)
+
+namespace
+{
+
+// Compressors are costly to set up (hash tables of several hundred KB), so
+// each thread keeps the one for the level it used last
+struct CachedCompressor
+{
+    libdeflate_compressor *compressor = nullptr;
+    int level = -1;
+
+    ~CachedCompressor()
+    {
+        if (compressor)
+        {
+            libdeflate_free_compressor(compressor);
+        }
+    }
+
+    libdeflate_compressor *get(int wanted)
+    {
+        if (!compressor || level != wanted)
+        {
+            if (compressor)
+            {
+                libdeflate_free_compressor(compressor);
+            }
+            compressor = libdeflate_alloc_compressor(wanted);
+            level = compressor ? wanted : -1;
+        }
+        return compressor;
+    }
+};
+
+thread_local CachedCompressor cachedCompressor;
+
+} // namespace
+
+const char *deflateBackendName()
+{
+    return "libdeflate";
+}
+
+int defaultDeflateLevel()
+{
+    return 6;
+}
+
+unsigned char *zlibCompress(unsigned char *data, int dataLen, int *outLen, int level)
+{
+    libdeflate_compressor *compressor = cachedCompressor.get(std::min(std::max(level, 0), 12));
+    if (!compressor)
+    {
+        return nullptr;
+    }
+    size_t bound = libdeflate_zlib_compress_bound(compressor, static_cast<size_t>(dataLen));
+    unsigned char *out = static_cast<unsigned char *>(std::malloc(bound));
+    if (!out)
+    {
+        return nullptr;
+    }
+    size_t written = libdeflate_zlib_compress(compressor, data, static_cast<size_t>(dataLen), out, bound);
+    if (!written)
+    {
+        std::free(out);
+        return nullptr;
+    }
+    *outLen = static_cast<int>(written);
+    return out;
+}
+
+#elif defined(SCREENSHOT_DEFLATE_ZLIB)
+
+const char *deflateBackendName()
+{
+    return "zlib";
+}
+
+int defaultDeflateLevel()
+{
+    return 6;
+}
+
+unsigned char *zlibCompress(unsigned char *data, int dataLen, int *outLen, int level)
+{
+    uLongf written = compressBound(static_cast<uLong>(dataLen));
+    unsigned char *out = static_cast<unsigned char *>(std::malloc(written));
+    if (!out)
+    {
+        return nullptr;
+    }
+    if (compress2(out, &written, data, static_cast<uLong>(dataLen), std::min(std::max(level, 0), 9)) != Z_OK)
+    {
+        std::free(out);
+        return nullptr;
+    }
+    *outLen = static_cast<int>(written);
+    return out;
+}
+
+bool deflateStripe(const unsigned char *dictionary, size_t dictionaryLen, const unsigned char *data, size_t dataLen, bool last, int level,
+                   std::vector<unsigned char> &out)
+{
+    z_stream stream = z_stream();
+    if (deflateInit2(&stream, std::min(std::max(level, 0), 9), Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+    const size_t window = 32768;
+    if (dictionaryLen > window)
+    {
+        dictionary += dictionaryLen - window;
+        dictionaryLen = window;
+    }
+    if (dictionaryLen && deflateSetDictionary(&stream, dictionary, static_cast<uInt>(dictionaryLen)) != Z_OK)
+    {
+        deflateEnd(&stream);
+        return false;
+    }
+
+    // deflateBound() plus room for the sync marker covers the whole stripe;
+    // the loop only guards against a bound that comes up short
+    const size_t start = out.size();
+    out.resize(start + deflateBound(&stream, static_cast<uLong>(dataLen)) + 16);
+    stream.next_in = const_cast<unsigned char *>(data);
+    stream.avail_in = static_cast<uInt>(dataLen);
+    stream.next_out = out.data() + start;
+    stream.avail_out = static_cast<uInt>(out.size() - start);
+    int result;
+    while ((result = deflate(&stream, last ? Z_FINISH : Z_SYNC_FLUSH)) == Z_OK && stream.avail_out == 0)
+    {
+        size_t used = out.size() - start;
+        out.resize(out.size() + 4096);
+        stream.next_out = out.data() + start + used;
+        stream.avail_out = 4096;
+    }
+    bool ok = last ? result == Z_STREAM_END : result == Z_OK || result == Z_BUF_ERROR;
+    out.resize(start + stream.total_out);
+    deflateEnd(&stream);
+    return ok;
+}
+
+void zlibHeader(int level, unsigned char header[2])
+{
+    // CMF: deflate with a 32 KB window; FLG: zlib's level hint, then the
+    // check bits that make the pair a multiple of 31
+    level = std::min(std::max(level, 0), 9);
+    unsigned levelFlags = level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3;
+    unsigned cmf = 0x78;
+    unsigned flg = levelFlags << 6;
+    flg += (31 - (cmf * 256 + flg) % 31) % 31;
+    header[0] = static_cast<unsigned char>(cmf);
+    header[1] = static_cast<unsigned char>(flg);
+}
+
+#else
+
+const char *deflateBackendName()
+{
+    return "stb";
+}
+
+int defaultDeflateLevel()
+{
+    return 8;
+}
+
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// zlib-format (RFC 1950) compression behind the PNG writer's IDAT stream.
+// The backend is chosen at build time (SCREENSHOT_DEFLATE in CMake):
+// libdeflate, zlib (zlib-ng in zlib-compat mode links the same way), or
+// stb_image_write's built-in hash-chain deflate when neither is available.
+// The external backends plug into stb_image_write through its
+// STBIW_ZLIB_COMPRESS hook.
+//
+// zlib can also end a deflate stream on a byte-aligned sync flush, which
+// lets the PNG writer compress horizontal stripes on separate threads and
+// concatenate them into one stream (SCREENSHOT_DEFLATE_STRIPES). libdeflate
+// and stb always close their output with a final block, so their builds
+// deflate in one piece.
+
+// "libdeflate", "zlib" or "stb"
+const char *deflateBackendName();
+
+// Level used for -1: 6 for libdeflate and zlib, 8 for stb (its own default,
+// which keeps stb builds byte-identical to stbi_write_png)
+int defaultDeflateLevel();
+
+#if defined(SCREENSHOT_DEFLATE_ZLIB)
+#define SCREENSHOT_DEFLATE_STRIPES 1
+#endif
+
+#if defined(SCREENSHOT_DEFLATE_LIBDEFLATE) || defined(SCREENSHOT_DEFLATE_ZLIB)
+// STBIW_ZLIB_COMPRESS implementation: the zlib stream of data at level,
+// clamped to the backend's range (0-12 for libdeflate, 0-9 for zlib).
+// Allocated with malloc, as stb_image_write frees it; nullptr on failure.
+unsigned char *zlibCompress(unsigned char *data, int dataLen, int *outLen, int level);
+#endif
+
+#if defined(SCREENSHOT_DEFLATE_STRIPES)
+// Raw deflate data of one stripe of a stream, appended to out. dictionary is
+// the input right before the stripe (up to the last 32 KB are used), so
+// matches reach back across the stripe boundary as in a one-piece stream.
+// Stripes other than the last end on a sync flush, which leaves them
+// byte-aligned and open for the next stripe; the last one ends the stream.
+bool deflateStripe(const unsigned char *dictionary, size_t dictionaryLen, const unsigned char *data, size_t dataLen, bool last, int level,
+                   std::vector<unsigned char> &out);
+
+// Two-byte zlib header for a stream compressed at level
+void zlibHeader(int level, unsigned char header[2]);
+
+#endif
@@ -0,0 +1,169 @@
+#include "frame_source.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+#if defined(_WIN32)
+std::unique_ptr<FrameSource> createGdiFrameSource();
+#elif defined(__APPLE__)
+std::unique_ptr<FrameSource> createCoreGraphicsFrameSource();
+#elif defined(SCREENSHOT_HAVE_X11)
+std::unique_ptr<FrameSource> createX11FrameSource();
+#endif
+
+int bytesPerPixel(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGR8:
+    case PixelFormat::RGB8:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+const char *pixelFormatName(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRA8:
+        return "BGRA8";
+    case PixelFormat::BGRX8:
+        return "BGRX8";
+    case PixelFormat::BGR8:
+        return "BGR8";
+    case PixelFormat::RGBA8:
+        return "RGBA8";
+    case PixelFormat::RGB8:
+        return "RGB8";
+    }
+    return "unknown";
+}
+
+std::unique_ptr<FrameSource> createPlatformFrameSource()
+{
+#if defined(_WIN32)
+    return createGdiFrameSource();
+#elif defined(__APPLE__)
+    return createCoreGraphicsFrameSource();
+#elif defined(SCREENSHOT_HAVE_X11)
+    return createX11FrameSource();
+#else
+    return std::unique_ptr<FrameSource>();
+#endif
+}
+
+bool parseSyntheticSpec(const std::string &spec, SyntheticDesktopConfig &config)
+{
+    std::vector<std::string> parts;
+    std::stringstream stream(spec);
+    std::string part;
+    while (std::getline(stream, part, ':'))
+    {
+        parts.push_back(part);
+    }
+
+    if (parts.empty() || parts[0] != "synthetic")
+    {
+        return false;
+    }
+
+    if (parts.size() > 1 && !parts[1].empty())
+    {
+        const std::string &resolution = parts[1];
+        if (resolution == "1080p")
+        {
+            config.width = 1920;
+            config.height = 1080;
+        }
+        else if (resolution == "4k" || resolution == "4K")
+        {
+            config.width = 3840;
+            config.height = 2160;
+        }
+        else if (resolution == "8k" || resolution == "8K")
+        {
+            config.width = 7680;
+            config.height = 4320;
+        }
+        else
+        {
+            int width = 0;
+            int height = 0;
+            char separator = 0;
+            std::stringstream dims(resolution);
+            if (!(dims >> width >> separator >> height) || separator != 'x' || width <= 0 || height <= 0)
+            {
+                std::cerr << "Invalid synthetic resolution: " << resolution << std::endl;
+                return false;
+            }
+            config.width = width;
+            config.height = height;
+        }
+    }
+
+    if (parts.size() > 2 && !parts[2].empty())
+    {
+        config.monitorCount = std::atoi(parts[2].c_str());
+        if (config.monitorCount <= 0)
+        {
+            std::cerr << "Invalid synthetic monitor count: " << parts[2] << std::endl;
+            return false;
+        }
+    }
+
+    if (parts.size() > 3 && !parts[3].empty())
+    {
+        config.seed = static_cast<unsigned int>(std::strtoul(parts[3].c_str(), nullptr, 10));
+    }
+
+    return true;
+}
+
+std::unique_ptr<FrameSource> createFrameSourceFromSpec(const std::string &spec)
+{
+    if (spec == "platform")
+    {
+        return createPlatformFrameSource();
+    }
+#if defined(SCREENSHOT_HAVE_X11)
+    if (spec == "x11")
+    {
+        return createX11FrameSource();
+    }
+#endif
+    SyntheticDesktopConfig config;
+    if (parseSyntheticSpec(spec, config))
+    {
+        return createSyntheticFrameSource(config);
+    }
+    return std::unique_ptr<FrameSource>();
+}
+
+std::unique_ptr<FrameSource> createFrameSource()
+{
+    std::unique_ptr<FrameSource> source;
+    const char *spec = std::getenv("SCREENSHOT_SOURCE");
+    if (spec && *spec)
+    {
+        source = createFrameSourceFromSpec(spec);
+        if (!source)
+        {
+            std::cerr << "Unknown or unavailable SCREENSHOT_SOURCE '" << spec << "', using the platform source" << std::endl;
+        }
+    }
+
+    if (!source)
+    {
+        source = createPlatformFrameSource();
+    }
+    if (!source)
+    {
+        // Never stand in a synthetic desktop for a real screenshot; those
+        // have to be asked for through SCREENSHOT_SOURCE
+        std::cerr << "No native capture backend available" << std::endl;
+    }
+    return source;
+}
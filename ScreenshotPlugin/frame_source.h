@@ -0,0 +1,86 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+// Layout of the pixels a FrameSource hands out. Native capture APIs deliver
+// BGRA/BGRX (GDI, CoreGraphics, X11) or packed 24bpp BGR; the RGB variants are
+// what the encoders consume.
+enum class PixelFormat
+{
+    BGRA8, // 4 bytes, alpha is meaningful
+    BGRX8, // 4 bytes, fourth byte is undefined and treated as opaque
+    BGR8,  // 3 bytes, packed
+    RGBA8,
+    RGB8
+};
+
+int bytesPerPixel(PixelFormat format);
+const char *pixelFormatName(PixelFormat format);
+
+// One physical monitor (or virtual output) that can be captured
+struct OutputInfo
+{
+    std::string name;
+    int x = 0; // Position on the virtual desktop
+    int y = 0;
+    int width = 0;
+    int height = 0;
+    bool primary = false;
+};
+
+// A captured frame. The pixels are owned by the FrameSource and stay valid
+// until the next acquireFrame() call for the same output or until the source
+// is destroyed.
+struct CapturedFrame
+{
+    int width = 0;
+    int height = 0;
+    int stride = 0; // Bytes between the starts of two consecutive rows
+    PixelFormat format = PixelFormat::BGRA8;
+    const unsigned char *pixels = nullptr;
+};
+
+// Abstract capture backend: enumerate the outputs once, then acquire frames
+// from them by index. acquireFrame() may be called concurrently for different
+// outputs; backends whose API is not thread-safe serialize internally.
+class FrameSource
+{
+public:
+    virtual ~FrameSource() {}
+
+    virtual const char *name() const = 0;
+    virtual std::vector<OutputInfo> enumerateOutputs() = 0;
+    virtual bool acquireFrame(size_t outputIndex, CapturedFrame &frame) = 0;
+};
+
+// Content mix and resolution of the headless synthetic desktop
+struct SyntheticDesktopConfig
+{
+    int width = 1920;
+    int height = 1080;
+    int monitorCount = 2;
+    unsigned int seed = 1;
+    PixelFormat format = PixelFormat::BGRX8;
+};
+
+// Deterministic multi-monitor desktop (text-heavy UI, gradients, photo-like
+// noise) for profiling the pipeline without a display server
+std::unique_ptr<FrameSource> createSyntheticFrameSource(const SyntheticDesktopConfig &config);
+
+// GDI on Windows, CoreGraphics on macOS, X11 (MIT-SHM) on Linux; nullptr
+// when the platform has no native backend or no display is reachable
+std::unique_ptr<FrameSource> createPlatformFrameSource();
+
+// Creates a source from a spec: "platform", "x11" or
+// "synthetic[:1080p|4k|8k|<W>x<H>[:<monitors>[:<seed>]]]". Returns nullptr for
+// unknown or unavailable sources.
+std::unique_ptr<FrameSource> createFrameSourceFromSpec(const std::string &spec);
+
+// Picks a source from the SCREENSHOT_SOURCE environment variable (a spec as
+// above), falling back to the platform source; null when there is none
+std::unique_ptr<FrameSource> createFrameSource();
+
+// Parses the "synthetic:..." form used by SCREENSHOT_SOURCE and the benchmarks
+bool parseSyntheticSpec(const std::string &spec, SyntheticDesktopConfig &config);
@@ -0,0 +1,133 @@
+#include "frame_source.h"
+
+#include <windows.h>
+
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+
+// Captures every active display device through GDI. Pixels are read back with
+// GetBitmapBits into a buffer that is kept per output, so the frame keeps
+// GDI's native BGRX layout and bmWidthBytes row pitch.
+class GdiFrameSource : public FrameSource
+{
+public:
+    const char *name() const override { return "gdi"; }
+
+    std::vector<OutputInfo> enumerateOutputs() override
+    {
+        devices_.clear();
+        std::vector<OutputInfo> outputs;
+
+        // EnumDisplayDevices to get all connected monitors
+        DISPLAY_DEVICE dd;
+        memset(&dd, 0, sizeof(dd));
+        dd.cb = sizeof(dd);
+
+        for (DWORD monitorIndex = 0; EnumDisplayDevices(NULL, monitorIndex, &dd, 0); ++monitorIndex)
+        {
+            // Get the monitor's width and height; inactive devices have no current mode
+            DEVMODE devMode;
+            memset(&devMode, 0, sizeof(devMode));
+            devMode.dmSize = sizeof(devMode);
+            if (!EnumDisplaySettings(dd.DeviceName, ENUM_CURRENT_SETTINGS, &devMode))
+            {
+                continue;
+            }
+
+            OutputInfo output;
+            output.name = dd.DeviceName;
+            output.x = devMode.dmPosition.x;
+            output.y = devMode.dmPosition.y;
+            output.width = devMode.dmPelsWidth;
+            output.height = devMode.dmPelsHeight;
+            output.primary = (dd.StateFlags & DISPLAY_DEVICE_PRIMARY_DEVICE) != 0;
+            outputs.push_back(output);
+            devices_.push_back(output);
+        }
+
+        buffers_.resize(devices_.size());
+        return outputs;
+    }
+
+    bool acquireFrame(size_t outputIndex, CapturedFrame &frame) override
+    {
+        if (outputIndex >= devices_.size())
+        {
+            return false;
+        }
+        const OutputInfo &device = devices_[outputIndex];
+        int width = device.width;
+        int height = device.height;
+
+        // Get the device context of the monitor
+        HDC hScreenDC = CreateDC(device.name.c_str(), NULL, NULL, NULL);
+        if (hScreenDC == NULL)
+        {
+            std::cerr << "Failed to get monitor DC for monitor " << outputIndex << std::endl;
+            return false;
+        }
+
+        HBITMAP hBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
+        if (hBitmap == NULL)
+        {
+            std::cerr << "Failed to create bitmap" << std::endl;
+            DeleteDC(hScreenDC);
+            return false;
+        }
+
+        HDC hMemoryDC = CreateCompatibleDC(hScreenDC);
+        HGDIOBJ previous = SelectObject(hMemoryDC, hBitmap);
+
+        // Capture screen into the bitmap
+        bool ok = BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, SRCCOPY) != 0;
+        if (!ok)
+        {
+            std::cerr << "Failed to copy screen to bitmap" << std::endl;
+        }
+
+        BITMAP bmp;
+        if (ok && GetObject(hBitmap, sizeof(BITMAP), &bmp) == 0)
+        {
+            ok = false;
+        }
+        if (ok && bmp.bmBitsPixel != 32 && bmp.bmBitsPixel != 24)
+        {
+            std::cerr << "Unsupported bitmap depth " << bmp.bmBitsPixel << std::endl;
+            ok = false;
+        }
+
+        if (ok)
+        {
+            std::vector<unsigned char> &pixels = buffers_[outputIndex];
+            pixels.resize(static_cast<size_t>(bmp.bmWidthBytes) * bmp.bmHeight);
+            GetBitmapBits(hBitmap, static_cast<LONG>(pixels.size()), pixels.data());
+
+            frame.width = width;
+            frame.height = height;
+            frame.stride = bmp.bmWidthBytes;
+            frame.format = bmp.bmBitsPixel == 32 ? PixelFormat::BGRX8 : PixelFormat::BGR8;
+            frame.pixels = pixels.data();
+        }
+
+        // Cleanup
+        SelectObject(hMemoryDC, previous);
+        DeleteObject(hBitmap);
+        DeleteDC(hMemoryDC);
+        DeleteDC(hScreenDC);
+        return ok;
+    }
+
+private:
+    std::vector<OutputInfo> devices_;
+    std::vector<std::vector<unsigned char>> buffers_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> createGdiFrameSource()
+{
+    return std::unique_ptr<FrameSource>(new GdiFrameSource());
+}
@@ -0,0 +1,159 @@
+#include "image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+// Free blocks waiting for reuse. A capture cycle allocates the same handful
+// of sizes every time (one buffer per output, scaled copies, the canvas), so
+// a small best-fit free list is enough.
+class FramePool
+{
+public:
+    unsigned char *acquire(size_t bytes, size_t &capacity)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            size_t best = blocks_.size();
+            for (size_t i = 0; i < blocks_.size(); ++i)
+            {
+                if (blocks_[i].capacity >= bytes && (best == blocks_.size() || blocks_[i].capacity < blocks_[best].capacity))
+                {
+                    best = i;
+                }
+            }
+            // Don't hand a 4K buffer to a thumbnail
+            if (best != blocks_.size() && blocks_[best].capacity <= bytes * 2)
+            {
+                Block block = blocks_[best];
+                blocks_.erase(blocks_.begin() + best);
+                capacity = block.capacity;
+                return block.data;
+            }
+        }
+        capacity = bytes;
+        return new unsigned char[bytes];
+    }
+
+    void release(unsigned char *data, size_t capacity)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (blocks_.size() < maxBlocks)
+            {
+                blocks_.push_back(Block{data, capacity});
+                return;
+            }
+        }
+        delete[] data;
+    }
+
+    ~FramePool()
+    {
+        for (auto &block : blocks_)
+        {
+            delete[] block.data;
+        }
+    }
+
+private:
+    struct Block
+    {
+        unsigned char *data;
+        size_t capacity;
+    };
+
+    static const size_t maxBlocks = 16;
+    std::mutex mutex_;
+    std::vector<Block> blocks_;
+};
+
+FramePool &framePool()
+{
+    static FramePool pool;
+    return pool;
+}
+
+} // namespace
+
+ImageView ImageView::crop(int x, int y, int cropWidth, int cropHeight) const
+{
+    int x0 = std::max(0, std::min(x, width));
+    int y0 = std::max(0, std::min(y, height));
+    int x1 = std::max(x0, std::min(x + cropWidth, width));
+    int y1 = std::max(y0, std::min(y + cropHeight, height));
+    return ImageView(row(y0) + x0 * bytesPerPixel(format), x1 - x0, y1 - y0, stride, format);
+}
+
+Frame::Frame() : data_(nullptr), capacity_(0), width_(0), height_(0), stride_(0), format_(PixelFormat::RGBA8)
+{
+}
+
+Frame::Frame(int width, int height, PixelFormat format)
+    : data_(nullptr), capacity_(0), width_(width), height_(height), stride_(0), format_(format)
+{
+    stride_ = (width * bytesPerPixel(format) + 31) & ~31;
+    size_t bytes = static_cast<size_t>(stride_) * height;
+    if (bytes)
+    {
+        data_ = framePool().acquire(bytes, capacity_);
+    }
+}
+
+Frame::~Frame()
+{
+    release();
+}
+
+Frame::Frame(Frame &&other)
+    : data_(other.data_), capacity_(other.capacity_), width_(other.width_), height_(other.height_), stride_(other.stride_),
+      format_(other.format_)
+{
+    other.data_ = nullptr;
+    other.capacity_ = 0;
+}
+
+Frame &Frame::operator=(Frame &&other)
+{
+    if (this != &other)
+    {
+        release();
+        data_ = other.data_;
+        capacity_ = other.capacity_;
+        width_ = other.width_;
+        height_ = other.height_;
+        stride_ = other.stride_;
+        format_ = other.format_;
+        other.data_ = nullptr;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+MutableImageView Frame::region(int x, int y, int regionWidth, int regionHeight)
+{
+    ImageView clipped = view().crop(x, y, regionWidth, regionHeight);
+    return MutableImageView(const_cast<unsigned char *>(clipped.pixels), clipped.width, clipped.height, stride_, format_);
+}
+
+void Frame::clear()
+{
+    if (data_)
+    {
+        std::memset(data_, 0, static_cast<size_t>(stride_) * height_);
+    }
+}
+
+void Frame::release()
+{
+    if (data_)
+    {
+        framePool().release(data_, capacity_);
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+}
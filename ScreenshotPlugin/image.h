@@ -0,0 +1,101 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <cstddef>
+
+// Non-owning view of pixels in any PixelFormat with an explicit row stride.
+// Views of capture buffers, frames and sub-rectangles of either are all the
+// same type, so cropping or reading padded rows never copies.
+struct ImageView
+{
+    const unsigned char *pixels;
+    int width;
+    int height;
+    int stride; // bytes between row starts
+    PixelFormat format;
+
+    ImageView() : pixels(nullptr), width(0), height(0), stride(0), format(PixelFormat::RGBA8) {}
+    ImageView(const unsigned char *pixels, int width, int height, int stride, PixelFormat format)
+        : pixels(pixels), width(width), height(height), stride(stride), format(format)
+    {
+    }
+    explicit ImageView(const CapturedFrame &frame)
+        : pixels(frame.pixels), width(frame.width), height(frame.height), stride(frame.stride), format(frame.format)
+    {
+    }
+
+    bool empty() const { return !pixels || width <= 0 || height <= 0; }
+    const unsigned char *row(int y) const { return pixels + static_cast<ptrdiff_t>(y) * stride; }
+
+    // Sub-rectangle, clipped to the view
+    ImageView crop(int x, int y, int cropWidth, int cropHeight) const;
+};
+
+// Writable counterpart of ImageView, typically a rectangle of a canvas that a
+// compositing step fills in place
+struct MutableImageView
+{
+    unsigned char *pixels;
+    int width;
+    int height;
+    int stride;
+    PixelFormat format;
+
+    MutableImageView() : pixels(nullptr), width(0), height(0), stride(0), format(PixelFormat::RGBA8) {}
+    MutableImageView(unsigned char *pixels, int width, int height, int stride, PixelFormat format)
+        : pixels(pixels), width(width), height(height), stride(stride), format(format)
+    {
+    }
+
+    unsigned char *row(int y) const { return pixels + static_cast<ptrdiff_t>(y) * stride; }
+    operator ImageView() const { return ImageView(pixels, width, height, stride, format); }
+};
+
+// Move-only owning image. Storage comes from a process-wide pool of
+// recycled blocks, so per-capture buffers and canvases are not reallocated
+// every time. Rows are padded to a 32-byte multiple.
+class Frame
+{
+public:
+    Frame();
+    // Uninitialised pixels; call clear() when the contents matter
+    Frame(int width, int height, PixelFormat format);
+    ~Frame();
+
+    Frame(Frame &&other);
+    Frame &operator=(Frame &&other);
+    Frame(const Frame &) = delete;
+    Frame &operator=(const Frame &) = delete;
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+    int stride() const { return stride_; }
+    PixelFormat format() const { return format_; }
+    bool empty() const { return !data_; }
+
+    unsigned char *data() { return data_; }
+    const unsigned char *data() const { return data_; }
+    unsigned char *row(int y) { return data_ + static_cast<size_t>(y) * stride_; }
+    const unsigned char *row(int y) const { return data_ + static_cast<size_t>(y) * stride_; }
+
+    ImageView view() const { return ImageView(data_, width_, height_, stride_, format_); }
+    operator ImageView() const { return view(); }
+    MutableImageView mutableView() { return MutableImageView(data_, width_, height_, stride_, format_); }
+
+    // Writable sub-rectangle, clipped to the frame
+    MutableImageView region(int x, int y, int regionWidth, int regionHeight);
+
+    // Set every byte to zero
+    void clear();
+
+private:
+    void release();
+
+    unsigned char *data_;
+    size_t capacity_;
+    int width_;
+    int height_;
+    int stride_;
+    PixelFormat format_;
+};
@@ -0,0 +1,79 @@
+#include "image_format.h"
+#include "webp_writer.h"
+
+const char *imageFormatName(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::Auto:
+        return "auto";
+    case ImageFormat::Adaptive:
+        return "adaptive";
+    case ImageFormat::Png:
+        return "png";
+    case ImageFormat::Jpeg:
+        return "jpeg";
+    case ImageFormat::Webp:
+        return "webp";
+    case ImageFormat::Qoi:
+        return "qoi";
+    }
+    return "unknown";
+}
+
+bool parseImageFormat(const std::string &name, ImageFormat &format)
+{
+    const ImageFormat formats[] = {ImageFormat::Auto, ImageFormat::Adaptive, ImageFormat::Png, ImageFormat::Jpeg, ImageFormat::Webp, ImageFormat::Qoi};
+    for (ImageFormat candidate : formats)
+    {
+        if (name == imageFormatName(candidate))
+        {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *imageFormatMimeType(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::Auto:
+    case ImageFormat::Adaptive:
+        return "";
+    case ImageFormat::Png:
+        return "image/png";
+    case ImageFormat::Jpeg:
+        return "image/jpeg";
+    case ImageFormat::Webp:
+        return "image/webp";
+    case ImageFormat::Qoi:
+        return "image/qoi";
+    }
+    return "";
+}
+
+const char *imageFormatExtension(ImageFormat format)
+{
+    switch (format)
+    {
+    case ImageFormat::Auto:
+    case ImageFormat::Adaptive:
+        return "";
+    case ImageFormat::Png:
+        return "png";
+    case ImageFormat::Jpeg:
+        return "jpg";
+    case ImageFormat::Webp:
+        return "webp";
+    case ImageFormat::Qoi:
+        return "qoi";
+    }
+    return "";
+}
+
+bool imageFormatAvailable(ImageFormat format)
+{
+    return format != ImageFormat::Webp || webpAvailable();
+}
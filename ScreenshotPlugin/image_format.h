@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+
+// File format of an encoded composite
+enum class ImageFormat
+{
+    Auto,     // PNG for the full-size Pip and Custom layouts, JPEG for the others
+    Adaptive, // indexed PNG, PNG or JPEG, whichever suits the content (content_analysis.h)
+    Png,
+    Jpeg,
+    Webp, // lossless or lossy (WebpOptions); needs libwebp (SCREENSHOT_WEBP)
+    Qoi   // lossless at a small fraction of PNG's encode time, somewhat larger files
+};
+
+const char *imageFormatName(ImageFormat format);
+
+// Parses "auto", "adaptive", "png", "jpeg", "webp" or "qoi"; false leaves
+// format as is
+bool parseImageFormat(const std::string &name, ImageFormat &format);
+
+// "image/png", "image/jpeg", "image/webp", "image/qoi"; "" for Auto and
+// Adaptive
+const char *imageFormatMimeType(ImageFormat format);
+
+// File name extension without the dot: "png", "jpg", "webp", "qoi"; "" for
+// Auto and Adaptive
+const char *imageFormatExtension(ImageFormat format);
+
+// Whether this build can encode format (all but WebP always can)
+bool imageFormatAvailable(ImageFormat format);
@@ -0,0 +1,557 @@
+#include "image_pipeline.h"
+#include "byte_budget.h"
+#include "content_analysis.h"
+#include "jpeg_writer.h"
+#include "palette.h"
+#include "pixel_convert.h"
+#include "png_writer.h"
+#include "qoi.h"
+#include "resample.h"
+#include "thread_pool.h"
+#include "webp_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <cstring> // for memcpy
+
+static bool writeFile(const std::string &filename, const std::vector<unsigned char> &bytes)
+{
+    std::ofstream file(filename, std::ios::binary);
+    file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    return static_cast<bool>(file);
+}
+
+// Utility function to save an image as a PNG file
+void saveImage(const std::string &filename, const ImageView &image)
+{
+    std::vector<unsigned char> png;
+    if (!encodePng(image.pixels, image.width, image.height, image.stride, image.format, png) || !writeFile(filename, png))
+    {
+        std::cerr << "Failed to save image to " << filename << std::endl;
+    }
+    else
+    {
+        std::cout << "Image saved to " << filename << std::endl;
+    }
+}
+
+void printImages(const std::vector<ImageView> &images)
+{
+    for (const auto &image : images)
+    {
+        std::cout << "Image: " << image.width << "x" << image.height << " " << pixelFormatName(image.format)
+                  << ", stride " << image.stride << ", Data Pointer: " << static_cast<const void *>(image.pixels) << std::endl;
+
+        // If you want to print the first few bytes of the image data
+        std::cout << "First 10 bytes of image data: ";
+        for (int i = 0; i < 10 && image.pixels[i]; ++i)
+        {
+            std::cout << static_cast<int>(image.pixels[i]) << " ";
+        }
+        std::cout << std::endl;
+    }
+}
+
+// Format of the composites built from views in viewFormat
+static PixelFormat canvasFormat(PixelFormat viewFormat, const CaptureOptions &options)
+{
+    return options.opaque ? PixelFormat::RGB8 : viewFormat;
+}
+
+// Copy pixelCount pixels, converting them when convert is set
+static void putRow(PixelRowConverter convert, const unsigned char *src, unsigned char *dst, int pixelCount, int bpp)
+{
+    if (convert)
+    {
+        convert(src, dst, pixelCount);
+    }
+    else
+    {
+        std::memcpy(dst, src, static_cast<size_t>(pixelCount) * bpp);
+    }
+}
+
+// Output rows per task. Small enough that a 450-row collage slot still
+// splits into dozens of bands, large enough that each band amortises its
+// scratch rows.
+static const int kBandRows = 16;
+
+// One source of a composite: src scaled through resampler into dst, or
+// copied and converted when resampler is null (same size). Only the areas
+// rectangles, relative to dst, are drawn; with an empty src they are
+// cleared to zero instead.
+struct CompositeItem
+{
+    ImageView src;
+    MutableImageView dst;
+    std::shared_ptr<const Resampler> resampler;
+    std::vector<LayoutRect> areas;
+};
+
+// Draw every item's areas. All areas are cut into bands of kBandRows and
+// queued as one parallelFor, so threads that finish a small image steal
+// bands of a larger one. Areas must not overlap.
+static void compositeItems(const std::vector<CompositeItem> &items, int threads)
+{
+    struct Band
+    {
+        size_t item;
+        LayoutRect rect;
+    };
+    std::vector<Band> bands;
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        for (const LayoutRect &area : items[i].areas)
+        {
+            for (int row = 0; row < area.height; row += kBandRows)
+            {
+                Band band = {i, LayoutRect(area.x, area.y + row, area.width, std::min(kBandRows, area.height - row))};
+                bands.push_back(band);
+            }
+        }
+    }
+
+    ThreadPool::shared().parallelFor(bands.size(), [&](size_t b) {
+        const CompositeItem &item = items[bands[b].item];
+        const LayoutRect &rect = bands[b].rect;
+        const int dstBpp = bytesPerPixel(item.dst.format);
+        if (item.src.empty())
+        {
+            for (int y = rect.y; y < rect.y + rect.height; ++y)
+            {
+                std::memset(item.dst.row(y) + rect.x * dstBpp, 0, static_cast<size_t>(rect.width) * dstBpp);
+            }
+            return;
+        }
+        if (item.resampler)
+        {
+            item.resampler->resampleRect(item.src, item.dst, rect.x, rect.y, rect.width, rect.height);
+            return;
+        }
+        PixelRowConverter convert = rowConverter(item.src.format, item.dst.format);
+        const int srcBpp = bytesPerPixel(item.src.format);
+        for (int y = rect.y; y < rect.y + rect.height; ++y)
+        {
+            putRow(convert, item.src.row(y) + rect.x * srcBpp, item.dst.row(y) + rect.x * dstBpp, rect.width, dstBpp);
+        }
+    }, threads);
+}
+
+// src scaled (or copied, at the same size) into dst, no areas yet. An
+// empty src leaves the item clearing dst.
+static CompositeItem compositeItem(const ImageView &src, const MutableImageView &dst, ResampleFilter filter)
+{
+    CompositeItem item;
+    item.dst = dst;
+    if (!src.empty() && dst.width > 0 && dst.height > 0)
+    {
+        item.src = src;
+        if (src.width != dst.width || src.height != dst.height)
+        {
+            item.resampler = cachedResampler(src.width, src.height, dst.width, dst.height, filter);
+        }
+    }
+    return item;
+}
+
+// Downscale image into dst in parallel bands; each output row is converted
+// and stored straight into its final place
+void downscaleImage(const ImageView& image, const MutableImageView& dst, ResampleFilter filter, int threads) {
+    CompositeItem item = compositeItem(image, dst, filter);
+    item.areas.push_back(LayoutRect(0, 0, dst.width, dst.height));
+    compositeItems(std::vector<CompositeItem>(1, item), threads);
+}
+
+// Helper function to downscale an image
+Frame downscaleImage(const ImageView& image, int newWidth, int newHeight, PixelFormat format, ResampleFilter filter) {
+    Frame resized(newWidth, newHeight, format);
+    downscaleImage(image, resized.mutableView(), filter);
+    return resized;
+}
+
+Layout computeLayout(const LayoutSpec &spec, const std::vector<ImageView> &images)
+{
+    std::vector<std::pair<int, int>> sizes;
+    for (const ImageView &image : images)
+    {
+        sizes.push_back(std::make_pair(image.width, image.height));
+    }
+    return computeLayout(spec, sizes);
+}
+
+// Whether inner lies within outer
+static bool containsRect(const LayoutRect &outer, const LayoutRect &inner)
+{
+    return inner.x >= outer.x && inner.y >= outer.y && inner.x + inner.width <= outer.x + outer.width &&
+           inner.y + inner.height <= outer.y + outer.height;
+}
+
+Frame composeLayout(const std::vector<ImageView> &images, const Layout &layout, const CaptureOptions &options)
+{
+    if (images.empty() || layout.width <= 0 || layout.height <= 0)
+    {
+        return Frame();
+    }
+    // Pooled and uninitialised: every pixel is either drawn once or lies in
+    // a gutter, so only the gutters are cleared. The areas never overlap, so
+    // that holds exactly when they add up to the canvas, each inside it; a
+    // layout that does not is cleared whole rather than leak stale memory.
+    Frame canvas(layout.width, layout.height, canvasFormat(images[0].format, options));
+    const LayoutRect bounds(0, 0, layout.width, layout.height);
+    long long covered = 0;
+    bool inside = true;
+    for (const LayoutRect &gutter : layout.gutters)
+    {
+        covered += static_cast<long long>(gutter.width) * gutter.height;
+        inside = inside && containsRect(bounds, gutter);
+    }
+    for (const LayoutPlacement &placement : layout.placements)
+    {
+        for (const LayoutRect &visible : placement.visible)
+        {
+            covered += static_cast<long long>(visible.width) * visible.height;
+            inside = inside && containsRect(placement.rect, visible) && containsRect(bounds, placement.rect);
+        }
+    }
+    if (!inside || covered != static_cast<long long>(layout.width) * layout.height)
+    {
+        canvas.clear();
+    }
+
+    // Every source goes straight to its rectangle, drawing only what later
+    // placements leave visible, all in one pool of bands with the gutters
+    std::vector<CompositeItem> items;
+    CompositeItem gutters;
+    gutters.dst = canvas.mutableView();
+    gutters.areas = layout.gutters;
+    items.push_back(gutters);
+    for (const LayoutPlacement &placement : layout.placements)
+    {
+        const LayoutRect &rect = placement.rect;
+        const LayoutRect &crop = placement.crop;
+        CompositeItem item = compositeItem(images[placement.source].crop(crop.x, crop.y, crop.width, crop.height),
+                                           canvas.region(rect.x, rect.y, rect.width, rect.height), options.filter);
+        for (const LayoutRect &visible : placement.visible)
+        {
+            item.areas.push_back(LayoutRect(visible.x - rect.x, visible.y - rect.y, visible.width, visible.height));
+        }
+        items.push_back(item);
+    }
+    compositeItems(items, options.threads);
+    return canvas;
+}
+
+// Writes image as an indexed PNG if palette allows: with its exact colours
+// when they fit, else quantized under PngPalette::Quantize. False leaves the
+// encoding to the truecolor writer.
+static bool encodeIndexedPng(const ImageView &image, PngPalette palette, const CaptureOptions &options, std::vector<unsigned char> &out)
+{
+    if (palette == PngPalette::Off)
+    {
+        return false;
+    }
+    std::vector<uint32_t> colors;
+    std::vector<unsigned char> indices;
+    if (!buildExactPalette(image, colors, indices))
+    {
+        if (palette != PngPalette::Quantize || !quantizePalette(image, kMaxPaletteColors, colors, indices))
+        {
+            return false;
+        }
+    }
+    return encodePngIndexed(indices.data(), image.width, image.height, colors, out, options.pngLevel, options.threads);
+}
+
+// Highest quality a byte budget may pick for format, from options; -1 when
+// only the resolution can give
+static int budgetQuality(ImageFormat format, const CaptureOptions &options)
+{
+    if (format == ImageFormat::Jpeg)
+    {
+        return options.jpeg.quality;
+    }
+    if (format == ImageFormat::Webp && !options.webp.lossless)
+    {
+        return static_cast<int>(options.webp.quality + 0.5f);
+    }
+    return -1;
+}
+
+// Compress image in format into out, at quality instead of the configured
+// one when it is not -1 (budgetQuality() formats only)
+static bool encodeImage(const ImageView &image, ImageFormat format, PngPalette palette, int quality, const CaptureOptions &options,
+                        EncodedImage &out)
+{
+    out.bytes.clear();
+    out.indexed = false;
+    switch (format)
+    {
+    case ImageFormat::Qoi:
+        return encodeQoi(image.pixels, image.width, image.height, image.stride, image.format, out.bytes);
+    case ImageFormat::Webp:
+    {
+        WebpOptions webp = options.webp;
+        if (quality >= 0)
+        {
+            webp.quality = static_cast<float>(quality);
+        }
+        return encodeWebp(image.pixels, image.width, image.height, image.stride, image.format, webp, out.bytes, options.threads);
+    }
+    case ImageFormat::Jpeg:
+    {
+        JpegOptions jpeg = options.jpeg;
+        if (quality >= 0)
+        {
+            jpeg.quality = quality;
+        }
+        return encodeJpeg(image.pixels, image.width, image.height, image.stride, image.format, jpeg, out.bytes, options.threads);
+    }
+    default:
+        if (encodeIndexedPng(image, palette, options, out.bytes))
+        {
+            out.indexed = true;
+            return true;
+        }
+        return encodePng(image.pixels, image.width, image.height, image.stride, image.format, out.bytes, options.pngLevel, options.threads);
+    }
+}
+
+bool encodeLayout(const std::vector<ImageView> &images, const LayoutSpec &spec, EncodedImage &out, const CaptureOptions &options)
+{
+    if (images.empty())
+    {
+        std::cerr << "No images to combine.\n";
+        return false;
+    }
+    Frame combined = composeLayout(images, computeLayout(spec, images), options);
+    if (combined.empty())
+    {
+        std::cerr << "Layout " << layoutKindName(spec.kind) << " left nothing to draw.\n";
+        return false;
+    }
+
+    // Full-size layouts keep every pixel; the thumbnail layouts are
+    // compressed as JPEG. Adaptive looks at the pixels instead.
+    ImageFormat format = options.format;
+    if (!imageFormatAvailable(format))
+    {
+        std::cerr << "No " << imageFormatName(format) << " encoder in this build, using the layout's default format.\n";
+        format = ImageFormat::Auto;
+    }
+    if (format == ImageFormat::Auto)
+    {
+        format = spec.kind == LayoutKind::Pip || spec.kind == LayoutKind::Custom ? ImageFormat::Png : ImageFormat::Jpeg;
+    }
+    PngPalette palette = options.pngPalette;
+    if (format == ImageFormat::Adaptive)
+    {
+        ContentStats stats = analyzeContent(combined);
+        ContentEncoding encoding = chooseContentEncoding(stats);
+        std::cout << "Adaptive encoding: " << contentEncodingName(encoding) << " (";
+        if (stats.uniqueColors <= kMaxPaletteColors)
+        {
+            std::cout << stats.uniqueColors << " colours, ";
+        }
+        std::cout << "entropy " << std::floor(stats.gradientEntropy * 10 + 0.5) / 10 << " bits, edges "
+                  << static_cast<int>(stats.edgeDensity * 100 + 0.5) << "%, flat " << static_cast<int>(stats.flatShare * 100 + 0.5) << "%)\n";
+        if (encoding == ContentEncoding::IndexedPng && palette == PngPalette::Off)
+        {
+            // The samples may have missed colours; the full pass has the last word
+            palette = PngPalette::Exact;
+        }
+        format = encoding == ContentEncoding::Jpeg ? ImageFormat::Jpeg : ImageFormat::Png;
+    }
+    out.format = format;
+    if (options.maxBytes == 0)
+    {
+        return encodeImage(combined, format, palette, -1, options, out);
+    }
+
+    // Budgeted: the quality and scale that fit are remembered per layout
+    std::ostringstream cacheKey;
+    cacheKey << layoutKindName(spec.kind) << ' ' << combined.width() << 'x' << combined.height() << ' ' << imageFormatName(format) << ' '
+             << pngPaletteName(palette);
+    BudgetEncoder encode = [&](const ImageView &image, int quality, EncodedImage &encoded) {
+        encoded.format = format;
+        return encodeImage(image, format, palette, quality, options, encoded);
+    };
+    BudgetParams chosen;
+    if (!encodeWithinBudget(combined, options.maxBytes, budgetQuality(format, options), cacheKey.str(), options.filter, options.threads, encode,
+                            out, &chosen))
+    {
+        return false;
+    }
+    std::cout << "Byte budget: " << out.bytes.size() << " of " << options.maxBytes << " bytes";
+    if (chosen.quality >= 0)
+    {
+        std::cout << ", quality " << chosen.quality;
+    }
+    std::cout << " at " << static_cast<int>(chosen.scale * 100 + 0.5) << "% scale\n";
+    return true;
+}
+
+void layoutImages(const std::vector<ImageView> &images, const LayoutSpec &spec, const std::string &outputFilePath, const CaptureOptions &options)
+{
+    EncodedImage encoded;
+    if (!encodeLayout(images, spec, encoded, options))
+    {
+        std::cerr << "Failed to encode the image.\n";
+        return;
+    }
+    if (writeFile(outputFilePath, encoded.bytes))
+    {
+        std::cout << "Image saved successfully as: " << outputFilePath << "\n";
+    }
+    else
+    {
+        std::cerr << "Failed to save the image.\n";
+    }
+}
+
+// Combine images and compress the output
+void combineImages(const std::vector<ImageView>& images, const std::string& outputFilePath, const CaptureOptions& options) {
+    layoutImages(images, collageLayoutSpec(), outputFilePath, options);
+}
+
+// Function to arrange images in a Picture-in-Picture (PIP) layout
+void pipImages(const std::vector<ImageView> &images, const std::string &outputFilePath, const CaptureOptions &options)
+{
+    layoutImages(images, pipLayoutSpec(), outputFilePath, options);
+}
+
+// Runs fn(i) for every i in [0, count), one thread per index so the total
+// latency is that of the slowest output; the calling thread takes index 0
+template <typename Fn>
+static void forEachOutput(size_t count, Fn fn)
+{
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < count; ++i)
+    {
+        workers.emplace_back(fn, i);
+    }
+    if (count)
+    {
+        fn(0);
+    }
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+size_t captureAllOutputs(FrameSource &source, CapturedOutputs &captured)
+{
+    std::vector<OutputInfo> outputs = source.enumerateOutputs();
+    std::vector<CapturedFrame> frames(outputs.size());
+    std::vector<char> acquired(outputs.size(), 0);
+
+    // Capture one output; each call touches only its own slot
+    forEachOutput(outputs.size(), [&](size_t i) {
+        if (source.acquireFrame(i, frames[i]))
+        {
+            acquired[i] = 1;
+        }
+        else
+        {
+            std::cerr << "Failed to capture output " << outputs[i].name << std::endl;
+        }
+    });
+
+    // Compositing copies whole pixels, so every output must end up in one
+    // 4-byte layout. Sources report the same format for every output in
+    // practice, which then is used as is (BGRA/BGRX included: the encoders
+    // read either order); anything mixed is normalised to RGBA.
+    captured.views.clear();
+    captured.frames.clear();
+    captured.format = PixelFormat::RGBA8;
+    std::vector<size_t> indices;
+    for (size_t i = 0; i < frames.size(); ++i)
+    {
+        if (acquired[i])
+        {
+            indices.push_back(i);
+        }
+    }
+    if (!indices.empty())
+    {
+        captured.format = packedFormat(frames[indices[0]].format);
+        for (size_t i : indices)
+        {
+            if (packedFormat(frames[i].format) != captured.format)
+            {
+                captured.format = PixelFormat::RGBA8;
+            }
+        }
+    }
+
+    // Outputs already in that format are viewed in place in the source's
+    // buffers, padded rows and all; the rest are converted into owned frames
+    captured.views.resize(indices.size());
+    captured.frames.resize(indices.size());
+    forEachOutput(indices.size(), [&](size_t n) {
+        const CapturedFrame &frame = frames[indices[n]];
+        if (frame.format == captured.format)
+        {
+            captured.views[n] = ImageView(frame);
+            return;
+        }
+        Frame converted(frame.width, frame.height, captured.format);
+        convertImage(ImageView(frame), captured.format, converted.data(), converted.stride());
+        captured.views[n] = converted.view();
+        captured.frames[n] = std::move(converted);
+    });
+    return captured.views.size();
+}
+
+bool captureScreenshot(FrameSource &source, bool isPip, EncodedImage &out, const CaptureOptions &options)
+{
+    // Views of every monitor, in monitor order
+    CapturedOutputs captured;
+    captureAllOutputs(source, captured);
+
+    // After collecting all monitor images, build the requested layout
+    if (captured.views.empty())
+    {
+        std::cerr << "No monitors found or screenshots were not captured." << std::endl;
+        return false;
+    }
+
+    const LayoutSpec spec = options.layout.kind != LayoutKind::Auto ? options.layout : isPip ? pipLayoutSpec() : collageLayoutSpec();
+    if (!encodeLayout(captured.views, spec, out, options))
+    {
+        std::cerr << "Failed to encode the image." << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool captureScreenshot(FrameSource &source, const std::string &outputFilePath, bool isPip, const CaptureOptions &options)
+{
+    EncodedImage encoded;
+    if (!captureScreenshot(source, isPip, encoded, options))
+    {
+        return false;
+    }
+    if (!writeFile(outputFilePath, encoded.bytes))
+    {
+        std::cerr << "Failed to save image to " << outputFilePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::future<bool> writeFileAsync(const std::string &filename, std::shared_ptr<const std::vector<unsigned char>> bytes)
+{
+    return std::async(std::launch::async, [filename, bytes]() {
+        if (!writeFile(filename, *bytes))
+        {
+            std::cerr << "Failed to save image to " << filename << std::endl;
+            return false;
+        }
+        return true;
+    });
+}
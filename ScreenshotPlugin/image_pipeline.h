@@ -0,0 +1,96 @@
+#pragma once
+
+#include "capture_options.h"
+#include "frame_source.h"
+#include "image.h"
+#include "layout.h"
+
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Images flow through the pipeline as ImageViews. Everything passed to one
+// compositing call shares a single 4-byte PixelFormat: RGBA8, or the
+// capture's own BGRA8/BGRX8 so nothing needs swizzling before the encoder.
+// Composites are RGB8 in opaque mode (the default) and keep the views'
+// format otherwise.
+
+// Utility function to save an image as a PNG file
+void saveImage(const std::string &filename, const ImageView &image);
+
+void printImages(const std::vector<ImageView> &images);
+
+// Downscale image to fill dst (typically a canvas region), converting it to
+// dst.format in the same pass. The filter tables for each geometry are built
+// once and reused by later captures. Bands of rows run on up to threads
+// threads of the shared pool (0 = all of them).
+void downscaleImage(const ImageView &image, const MutableImageView &dst, ResampleFilter filter = ResampleFilter::Box, int threads = 0);
+
+// Helper function to downscale an image into a new frame
+Frame downscaleImage(const ImageView &image, int newWidth, int newHeight, PixelFormat format, ResampleFilter filter = ResampleFilter::Box);
+
+// computeLayout() for the sizes of images
+Layout computeLayout(const LayoutSpec &spec, const std::vector<ImageView> &images);
+
+// Draw images into a new canvas as placed by layout, each visible pixel
+// once; only the layout's gutters are cleared. The canvas comes from the
+// frame pool, RGB8 in opaque mode and in the images' format otherwise;
+// empty when the layout is.
+Frame composeLayout(const std::vector<ImageView> &images, const Layout &layout, const CaptureOptions &options = CaptureOptions());
+
+// A composite compressed in memory, ready to upload or write out
+struct EncodedImage
+{
+    std::vector<unsigned char> bytes;
+    ImageFormat format; // Auto until encoded
+    bool indexed;       // PNG written with a palette
+
+    EncodedImage() : format(ImageFormat::Auto), indexed(false) {}
+};
+
+// Compose images as spec describes and compress the result into out, in
+// options.format: for Auto (or a format the build lacks), PNG for the
+// full-size Pip and Custom layouts and JPEG for the others. With
+// options.maxBytes set, quality and then resolution give way until the
+// result fits (byte_budget.h).
+bool encodeLayout(const std::vector<ImageView> &images, const LayoutSpec &spec, EncodedImage &out, const CaptureOptions &options = CaptureOptions());
+
+// encodeLayout() and write the result to outputFilePath
+void layoutImages(const std::vector<ImageView> &images, const LayoutSpec &spec, const std::string &outputFilePath,
+                  const CaptureOptions &options = CaptureOptions());
+
+// Combine images side by side into an 800px collage and compress the output
+void combineImages(const std::vector<ImageView> &images, const std::string &outputFilePath, const CaptureOptions &options = CaptureOptions());
+
+// Function to arrange images in a Picture-in-Picture (PIP) layout
+void pipImages(const std::vector<ImageView> &images, const std::string &outputFilePath, const CaptureOptions &options = CaptureOptions());
+
+// The outputs of one capture, in monitor order. Views point either into the
+// source's own buffers (valid until the next capture from that source) or
+// into the frames below.
+struct CapturedOutputs
+{
+    std::vector<ImageView> views;
+    std::vector<Frame> frames; // storage for outputs that had to be converted; empty slots otherwise
+    PixelFormat format;        // shared by every view
+
+    CapturedOutputs() : format(PixelFormat::RGBA8) {}
+};
+
+// Capture every output of the source, each output on its own thread. Returns
+// the number of outputs captured.
+size_t captureAllOutputs(FrameSource &source, CapturedOutputs &captured);
+
+// Capture all outputs and encode the composite into out: the layout in
+// options, or the collage or PIP layout when that is Auto
+bool captureScreenshot(FrameSource &source, bool isPip, EncodedImage &out, const CaptureOptions &options = CaptureOptions());
+
+// Same, writing the composite to outputFilePath
+bool captureScreenshot(FrameSource &source, const std::string &outputFilePath, bool isPip, const CaptureOptions &options = CaptureOptions());
+
+// Write bytes to filename on another thread, so the caller can go on
+// (uploading the same bytes, say) without waiting for the disk; failures are
+// logged. The future's destructor waits for the write, so it never outlives
+// the call that started it (nor the plugin library).
+std::future<bool> writeFileAsync(const std::string &filename, std::shared_ptr<const std::vector<unsigned char>> bytes);
@@ -0,0 +1,164 @@
+#include "jpeg_turbo.h"
+#include "pixel_convert.h"
+
+#include <algorithm>
+#include <csetjmp>
+#include <cstdio>
+#include <iostream>
+
+#include <jpeglib.h>
+
+namespace
+{
+
+// libjpeg reports fatal errors through error_exit, which must not return;
+// jump back to encodeJpegTurbo instead of the default exit()
+struct ErrorManager
+{
+    jpeg_error_mgr base;
+    std::jmp_buf jump;
+};
+
+void errorExit(j_common_ptr cinfo)
+{
+    char message[JMSG_LENGTH_MAX];
+    cinfo->err->format_message(cinfo, message);
+    std::cerr << "libjpeg: " << message << std::endl;
+    std::longjmp(reinterpret_cast<ErrorManager *>(cinfo->err)->jump, 1);
+}
+
+// Destination that appends to a byte vector, growing it a chunk at a time
+struct VectorDestination
+{
+    jpeg_destination_mgr base;
+    std::vector<unsigned char> *out;
+};
+
+const size_t kDestinationChunk = 64 * 1024;
+
+// Rows handed to jpeg_write_scanlines() per call, one 4:2:0 MCU row
+const int kBatchRows = 16;
+
+void initDestination(j_compress_ptr cinfo)
+{
+    VectorDestination *dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    dest->out->resize(kDestinationChunk);
+    dest->base.next_output_byte = dest->out->data();
+    dest->base.free_in_buffer = dest->out->size();
+}
+
+boolean emptyOutputBuffer(j_compress_ptr cinfo)
+{
+    // Called only when the buffer is full
+    VectorDestination *dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    size_t used = dest->out->size();
+    dest->out->resize(used + std::max(used, kDestinationChunk));
+    dest->base.next_output_byte = dest->out->data() + used;
+    dest->base.free_in_buffer = dest->out->size() - used;
+    return TRUE;
+}
+
+void termDestination(j_compress_ptr cinfo)
+{
+    VectorDestination *dest = reinterpret_cast<VectorDestination *>(cinfo->dest);
+    dest->out->resize(dest->out->size() - dest->base.free_in_buffer);
+}
+
+// Input colour space that reads format as is; JCS_UNKNOWN when rows must be
+// converted to RGB first
+J_COLOR_SPACE colorSpace(PixelFormat format)
+{
+#if defined(JCS_EXTENSIONS)
+    switch (format)
+    {
+    case PixelFormat::RGBA8:
+        return JCS_EXT_RGBX;
+    case PixelFormat::BGRA8:
+    case PixelFormat::BGRX8:
+        return JCS_EXT_BGRX;
+    case PixelFormat::RGB8:
+        return JCS_EXT_RGB;
+    case PixelFormat::BGR8:
+        return JCS_EXT_BGR;
+    default:
+        return JCS_UNKNOWN;
+    }
+#else
+    return format == PixelFormat::RGB8 ? JCS_RGB : JCS_UNKNOWN;
+#endif
+}
+
+} // namespace
+
+bool encodeJpegTurbo(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality, bool subsample,
+                     bool optimizeHuffman, std::vector<unsigned char> &out)
+{
+    J_COLOR_SPACE inputSpace = colorSpace(format);
+    PixelRowConverter toRgb = nullptr;
+    if (inputSpace == JCS_UNKNOWN)
+    {
+        if (!canConvert(format, PixelFormat::RGB8))
+        {
+            std::cerr << "Cannot JPEG-encode " << pixelFormatName(format) << std::endl;
+            return false;
+        }
+        toRgb = rowConverter(format, PixelFormat::RGB8);
+        inputSpace = JCS_RGB;
+    }
+    // Set up before setjmp: nothing with a destructor may be created between
+    // it and a longjmp back
+    const size_t rgbStride = static_cast<size_t>(width) * 3;
+    std::vector<unsigned char> rgbRows(toRgb ? rgbStride * kBatchRows : 0);
+
+    jpeg_compress_struct cinfo;
+    ErrorManager errors;
+    VectorDestination dest;
+    cinfo.err = jpeg_std_error(&errors.base);
+    errors.base.error_exit = errorExit;
+    if (setjmp(errors.jump))
+    {
+        jpeg_destroy_compress(&cinfo);
+        out.clear();
+        return false;
+    }
+    jpeg_create_compress(&cinfo);
+
+    out.clear();
+    dest.out = &out;
+    dest.base.init_destination = initDestination;
+    dest.base.empty_output_buffer = emptyOutputBuffer;
+    dest.base.term_destination = termDestination;
+    cinfo.dest = &dest.base;
+
+    cinfo.image_width = static_cast<JDIMENSION>(width);
+    cinfo.image_height = static_cast<JDIMENSION>(height);
+    cinfo.input_components = inputSpace == JCS_RGB ? 3 : bytesPerPixel(format);
+    cinfo.in_color_space = inputSpace;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_quality(&cinfo, quality < 1 ? 1 : quality > 100 ? 100 : quality, TRUE);
+    cinfo.comp_info[0].h_samp_factor = subsample ? 2 : 1;
+    cinfo.comp_info[0].v_samp_factor = subsample ? 2 : 1;
+    cinfo.optimize_coding = optimizeHuffman ? TRUE : FALSE;
+    jpeg_start_compress(&cinfo, TRUE);
+
+    while (cinfo.next_scanline < cinfo.image_height)
+    {
+        JSAMPROW rows[kBatchRows];
+        const int count = std::min(kBatchRows, static_cast<int>(cinfo.image_height - cinfo.next_scanline));
+        for (int i = 0; i < count; ++i)
+        {
+            const unsigned char *row = pixels + static_cast<size_t>(cinfo.next_scanline + i) * stride;
+            if (toRgb)
+            {
+                toRgb(row, &rgbRows[i * rgbStride], width);
+                row = &rgbRows[i * rgbStride];
+            }
+            rows[i] = const_cast<JSAMPROW>(row);
+        }
+        jpeg_write_scanlines(&cinfo, rows, static_cast<JDIMENSION>(count));
+    }
+
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+    return true;
+}
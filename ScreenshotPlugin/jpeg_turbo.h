@@ -0,0 +1,11 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <vector>
+
+// libjpeg-turbo backend of encodeJpeg(), built when SCREENSHOT_JPEG finds the
+// library. quality is 1-100; subsample picks 4:2:0 over 4:4:4;
+// optimizeHuffman spends a second pass on Huffman tables fitted to the image.
+bool encodeJpegTurbo(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality, bool subsample,
+                     bool optimizeHuffman, std::vector<unsigned char> &out);
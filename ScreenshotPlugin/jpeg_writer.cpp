@@ -0,0 +1,634 @@
+#include "jpeg_writer.h"
+
+#if defined(SCREENSHOT_HAVE_JPEG_TURBO)
+#include "jpeg_turbo.h"
+#endif
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+// Port of the JPEG writer in stb_image_write.h (itself based on Jon Olick's
+// jo_jpeg), writing into a byte vector and reading pixels through a stride
+// and per-format channel offsets. For RGBA input the output is byte-identical
+// to stbi_write_jpg. libjpeg-turbo, when the build has it, lives in
+// jpeg_turbo.cpp.
+
+namespace
+{
+
+const unsigned char zigZag[] = {0, 1, 5, 6, 14, 15, 27, 28, 2, 4, 7, 13, 16, 26, 29, 42, 3, 8, 12, 17, 25, 30, 41, 43, 9, 11, 18,
+                                24, 31, 40, 44, 53, 10, 19, 23, 32, 39, 45, 52, 54, 20, 22, 33, 38, 46, 51, 55, 60, 21, 34, 37, 47, 50, 56, 59, 61, 35, 36, 48, 49, 57, 58, 62, 63};
+
+// Huffman and quantization tables
+const unsigned char std_dc_luminance_nrcodes[] = {0,0,1,5,1,1,1,1,1,1,0,0,0,0,0,0,0};
+const unsigned char std_dc_luminance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
+const unsigned char std_ac_luminance_nrcodes[] = {0,0,2,1,3,3,2,4,3,5,5,4,4,0,0,1,0x7d};
+const unsigned char std_ac_luminance_values[] = {
+   0x01,0x02,0x03,0x00,0x04,0x11,0x05,0x12,0x21,0x31,0x41,0x06,0x13,0x51,0x61,0x07,0x22,0x71,0x14,0x32,0x81,0x91,0xa1,0x08,
+   0x23,0x42,0xb1,0xc1,0x15,0x52,0xd1,0xf0,0x24,0x33,0x62,0x72,0x82,0x09,0x0a,0x16,0x17,0x18,0x19,0x1a,0x25,0x26,0x27,0x28,
+   0x29,0x2a,0x34,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,0x59,
+   0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x83,0x84,0x85,0x86,0x87,0x88,0x89,
+   0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,0xb5,0xb6,
+   0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,0xe1,0xe2,
+   0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf1,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+const unsigned char std_dc_chrominance_nrcodes[] = {0,0,3,1,1,1,1,1,1,1,1,1,0,0,0,0,0};
+const unsigned char std_dc_chrominance_values[] = {0,1,2,3,4,5,6,7,8,9,10,11};
+const unsigned char std_ac_chrominance_nrcodes[] = {0,0,2,1,2,4,4,3,4,7,5,4,4,0,1,2,0x77};
+const unsigned char std_ac_chrominance_values[] = {
+   0x00,0x01,0x02,0x03,0x11,0x04,0x05,0x21,0x31,0x06,0x12,0x41,0x51,0x07,0x61,0x71,0x13,0x22,0x32,0x81,0x08,0x14,0x42,0x91,
+   0xa1,0xb1,0xc1,0x09,0x23,0x33,0x52,0xf0,0x15,0x62,0x72,0xd1,0x0a,0x16,0x24,0x34,0xe1,0x25,0xf1,0x17,0x18,0x19,0x1a,0x26,
+   0x27,0x28,0x29,0x2a,0x35,0x36,0x37,0x38,0x39,0x3a,0x43,0x44,0x45,0x46,0x47,0x48,0x49,0x4a,0x53,0x54,0x55,0x56,0x57,0x58,
+   0x59,0x5a,0x63,0x64,0x65,0x66,0x67,0x68,0x69,0x6a,0x73,0x74,0x75,0x76,0x77,0x78,0x79,0x7a,0x82,0x83,0x84,0x85,0x86,0x87,
+   0x88,0x89,0x8a,0x92,0x93,0x94,0x95,0x96,0x97,0x98,0x99,0x9a,0xa2,0xa3,0xa4,0xa5,0xa6,0xa7,0xa8,0xa9,0xaa,0xb2,0xb3,0xb4,
+   0xb5,0xb6,0xb7,0xb8,0xb9,0xba,0xc2,0xc3,0xc4,0xc5,0xc6,0xc7,0xc8,0xc9,0xca,0xd2,0xd3,0xd4,0xd5,0xd6,0xd7,0xd8,0xd9,0xda,
+   0xe2,0xe3,0xe4,0xe5,0xe6,0xe7,0xe8,0xe9,0xea,0xf2,0xf3,0xf4,0xf5,0xf6,0xf7,0xf8,0xf9,0xfa
+};
+// Huffman tables
+const unsigned short YDC_HT[256][2] = { {0,2},{2,3},{3,3},{4,3},{5,3},{6,3},{14,4},{30,5},{62,6},{126,7},{254,8},{510,9}};
+const unsigned short UVDC_HT[256][2] = { {0,2},{1,2},{2,2},{6,3},{14,4},{30,5},{62,6},{126,7},{254,8},{510,9},{1022,10},{2046,11}};
+const unsigned short YAC_HT[256][2] = {
+   {10,4},{0,2},{1,2},{4,3},{11,4},{26,5},{120,7},{248,8},{1014,10},{65410,16},{65411,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {12,4},{27,5},{121,7},{502,9},{2038,11},{65412,16},{65413,16},{65414,16},{65415,16},{65416,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {28,5},{249,8},{1015,10},{4084,12},{65417,16},{65418,16},{65419,16},{65420,16},{65421,16},{65422,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {58,6},{503,9},{4085,12},{65423,16},{65424,16},{65425,16},{65426,16},{65427,16},{65428,16},{65429,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {59,6},{1016,10},{65430,16},{65431,16},{65432,16},{65433,16},{65434,16},{65435,16},{65436,16},{65437,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {122,7},{2039,11},{65438,16},{65439,16},{65440,16},{65441,16},{65442,16},{65443,16},{65444,16},{65445,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {123,7},{4086,12},{65446,16},{65447,16},{65448,16},{65449,16},{65450,16},{65451,16},{65452,16},{65453,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {250,8},{4087,12},{65454,16},{65455,16},{65456,16},{65457,16},{65458,16},{65459,16},{65460,16},{65461,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {504,9},{32704,15},{65462,16},{65463,16},{65464,16},{65465,16},{65466,16},{65467,16},{65468,16},{65469,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {505,9},{65470,16},{65471,16},{65472,16},{65473,16},{65474,16},{65475,16},{65476,16},{65477,16},{65478,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {506,9},{65479,16},{65480,16},{65481,16},{65482,16},{65483,16},{65484,16},{65485,16},{65486,16},{65487,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {1017,10},{65488,16},{65489,16},{65490,16},{65491,16},{65492,16},{65493,16},{65494,16},{65495,16},{65496,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {1018,10},{65497,16},{65498,16},{65499,16},{65500,16},{65501,16},{65502,16},{65503,16},{65504,16},{65505,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {2040,11},{65506,16},{65507,16},{65508,16},{65509,16},{65510,16},{65511,16},{65512,16},{65513,16},{65514,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {65515,16},{65516,16},{65517,16},{65518,16},{65519,16},{65520,16},{65521,16},{65522,16},{65523,16},{65524,16},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {2041,11},{65525,16},{65526,16},{65527,16},{65528,16},{65529,16},{65530,16},{65531,16},{65532,16},{65533,16},{65534,16},{0,0},{0,0},{0,0},{0,0},{0,0}
+};
+const unsigned short UVAC_HT[256][2] = {
+   {0,2},{1,2},{4,3},{10,4},{24,5},{25,5},{56,6},{120,7},{500,9},{1014,10},{4084,12},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {11,4},{57,6},{246,8},{501,9},{2038,11},{4085,12},{65416,16},{65417,16},{65418,16},{65419,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {26,5},{247,8},{1015,10},{4086,12},{32706,15},{65420,16},{65421,16},{65422,16},{65423,16},{65424,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {27,5},{248,8},{1016,10},{4087,12},{65425,16},{65426,16},{65427,16},{65428,16},{65429,16},{65430,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {58,6},{502,9},{65431,16},{65432,16},{65433,16},{65434,16},{65435,16},{65436,16},{65437,16},{65438,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {59,6},{1017,10},{65439,16},{65440,16},{65441,16},{65442,16},{65443,16},{65444,16},{65445,16},{65446,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {121,7},{2039,11},{65447,16},{65448,16},{65449,16},{65450,16},{65451,16},{65452,16},{65453,16},{65454,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {122,7},{2040,11},{65455,16},{65456,16},{65457,16},{65458,16},{65459,16},{65460,16},{65461,16},{65462,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {249,8},{65463,16},{65464,16},{65465,16},{65466,16},{65467,16},{65468,16},{65469,16},{65470,16},{65471,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {503,9},{65472,16},{65473,16},{65474,16},{65475,16},{65476,16},{65477,16},{65478,16},{65479,16},{65480,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {504,9},{65481,16},{65482,16},{65483,16},{65484,16},{65485,16},{65486,16},{65487,16},{65488,16},{65489,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {505,9},{65490,16},{65491,16},{65492,16},{65493,16},{65494,16},{65495,16},{65496,16},{65497,16},{65498,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {506,9},{65499,16},{65500,16},{65501,16},{65502,16},{65503,16},{65504,16},{65505,16},{65506,16},{65507,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {2041,11},{65508,16},{65509,16},{65510,16},{65511,16},{65512,16},{65513,16},{65514,16},{65515,16},{65516,16},{0,0},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {16352,14},{65517,16},{65518,16},{65519,16},{65520,16},{65521,16},{65522,16},{65523,16},{65524,16},{65525,16},{0,0},{0,0},{0,0},{0,0},{0,0},
+   {1018,10},{32707,15},{65526,16},{65527,16},{65528,16},{65529,16},{65530,16},{65531,16},{65532,16},{65533,16},{65534,16},{0,0},{0,0},{0,0},{0,0},{0,0}
+};
+const int YQT[] = {16,11,10,16,24,40,51,61,12,12,14,19,26,58,60,55,14,13,16,24,40,57,69,56,14,17,22,29,51,87,80,62,18,22,
+                          37,56,68,109,103,77,24,35,55,64,81,104,113,92,49,64,78,87,103,121,120,101,72,92,95,98,112,100,103,99};
+const int UVQT[] = {17,18,24,47,99,99,99,99,18,21,26,66,99,99,99,99,24,26,56,99,99,99,99,99,47,66,99,99,99,99,99,99,
+                           99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99,99};
+const float aasf[] = { 1.0f * 2.828427125f, 1.387039845f * 2.828427125f, 1.306562965f * 2.828427125f, 1.175875602f * 2.828427125f,
+                              1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
+
+// Entropy-coded output with 0xFF byte stuffing
+struct BitWriter
+{
+    std::vector<unsigned char> &out;
+    uint32_t bitBuf; // unsigned, as flushed bytes are shifted out past the top
+    int bitCnt;
+
+    explicit BitWriter(std::vector<unsigned char> &buffer) : out(buffer), bitBuf(0), bitCnt(0) {}
+
+    void write(const unsigned short *bs)
+    {
+        bitCnt += bs[1];
+        bitBuf |= static_cast<uint32_t>(bs[0]) << (24 - bitCnt);
+        while (bitCnt >= 8)
+        {
+            unsigned char c = (bitBuf >> 16) & 255;
+            out.push_back(c);
+            if (c == 255)
+            {
+                out.push_back(0);
+            }
+            bitBuf <<= 8;
+            bitCnt -= 8;
+        }
+    }
+
+    // Pad the last byte with 1 bits
+    void flush()
+    {
+        static const unsigned short fillBits[] = {0x7F, 7};
+        write(fillBits);
+    }
+};
+
+void dct(float *d0p, float *d1p, float *d2p, float *d3p, float *d4p, float *d5p, float *d6p, float *d7p)
+{
+    float d0 = *d0p, d1 = *d1p, d2 = *d2p, d3 = *d3p, d4 = *d4p, d5 = *d5p, d6 = *d6p, d7 = *d7p;
+    float z1, z2, z3, z4, z5, z11, z13;
+
+    float tmp0 = d0 + d7;
+    float tmp7 = d0 - d7;
+    float tmp1 = d1 + d6;
+    float tmp6 = d1 - d6;
+    float tmp2 = d2 + d5;
+    float tmp5 = d2 - d5;
+    float tmp3 = d3 + d4;
+    float tmp4 = d3 - d4;
+
+    // Even part
+    float tmp10 = tmp0 + tmp3; // phase 2
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+
+    d0 = tmp10 + tmp11; // phase 3
+    d4 = tmp10 - tmp11;
+
+    z1 = (tmp12 + tmp13) * 0.707106781f; // c4
+    d2 = tmp13 + z1;                     // phase 5
+    d6 = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5; // phase 2
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+
+    // The rotator is modified from fig 4-8 to avoid extra negations.
+    z5 = (tmp10 - tmp12) * 0.382683433f; // c6
+    z2 = tmp10 * 0.541196100f + z5;      // c2-c6
+    z4 = tmp12 * 1.306562965f + z5;      // c2+c6
+    z3 = tmp11 * 0.707106781f;           // c4
+
+    z11 = tmp7 + z3; // phase 5
+    z13 = tmp7 - z3;
+
+    *d5p = z13 + z2; // phase 6
+    *d3p = z13 - z2;
+    *d1p = z11 + z4;
+    *d7p = z11 - z4;
+
+    *d0p = d0;
+    *d2p = d2;
+    *d4p = d4;
+    *d6p = d6;
+}
+
+void calcBits(int val, unsigned short bits[2])
+{
+    int tmp1 = val < 0 ? -val : val;
+    val = val < 0 ? val - 1 : val;
+    bits[1] = 1;
+    while (tmp1 >>= 1)
+    {
+        ++bits[1];
+    }
+    bits[0] = val & ((1 << bits[1]) - 1);
+}
+
+// Transform, quantize and entropy-code one 8x8 data unit; returns its DC
+// coefficient for the next unit's prediction
+int processDU(BitWriter &writer, float *CDU, int duStride, const float *fdtbl, int DC, const unsigned short HTDC[256][2], const unsigned short HTAC[256][2])
+{
+    const unsigned short EOB[2] = {HTAC[0x00][0], HTAC[0x00][1]};
+    const unsigned short M16zeroes[2] = {HTAC[0xF0][0], HTAC[0xF0][1]};
+    int DU[64];
+
+    // DCT rows
+    for (int dataOff = 0, n = duStride * 8; dataOff < n; dataOff += duStride)
+    {
+        dct(&CDU[dataOff], &CDU[dataOff + 1], &CDU[dataOff + 2], &CDU[dataOff + 3], &CDU[dataOff + 4], &CDU[dataOff + 5], &CDU[dataOff + 6], &CDU[dataOff + 7]);
+    }
+    // DCT columns
+    for (int dataOff = 0; dataOff < 8; ++dataOff)
+    {
+        dct(&CDU[dataOff], &CDU[dataOff + duStride], &CDU[dataOff + duStride * 2], &CDU[dataOff + duStride * 3], &CDU[dataOff + duStride * 4],
+            &CDU[dataOff + duStride * 5], &CDU[dataOff + duStride * 6], &CDU[dataOff + duStride * 7]);
+    }
+    // Quantize/descale/zigzag the coefficients
+    for (int y = 0, j = 0; y < 8; ++y)
+    {
+        for (int x = 0; x < 8; ++x, ++j)
+        {
+            float v = CDU[y * duStride + x] * fdtbl[j];
+            DU[zigZag[j]] = static_cast<int>(v < 0 ? v - 0.5f : v + 0.5f);
+        }
+    }
+
+    // Encode DC
+    int diff = DU[0] - DC;
+    if (diff == 0)
+    {
+        writer.write(HTDC[0]);
+    }
+    else
+    {
+        unsigned short bits[2];
+        calcBits(diff, bits);
+        writer.write(HTDC[bits[1]]);
+        writer.write(bits);
+    }
+
+    // Encode ACs; end0pos = last non-zero coefficient
+    int end0pos = 63;
+    while (end0pos > 0 && DU[end0pos] == 0)
+    {
+        --end0pos;
+    }
+    if (end0pos == 0)
+    {
+        writer.write(EOB);
+        return DU[0];
+    }
+    for (int i = 1; i <= end0pos; ++i)
+    {
+        int startpos = i;
+        for (; DU[i] == 0 && i <= end0pos; ++i)
+        {
+        }
+        int nrzeroes = i - startpos;
+        if (nrzeroes >= 16)
+        {
+            int lng = nrzeroes >> 4;
+            for (int nrmarker = 1; nrmarker <= lng; ++nrmarker)
+            {
+                writer.write(M16zeroes);
+            }
+            nrzeroes &= 15;
+        }
+        unsigned short bits[2];
+        calcBits(DU[i], bits);
+        writer.write(HTAC[(nrzeroes << 4) + bits[1]]);
+        writer.write(bits);
+    }
+    if (end0pos != 63)
+    {
+        writer.write(EOB);
+    }
+    return DU[0];
+}
+
+// Byte offsets of R, G and B inside one pixel
+struct ChannelOffsets
+{
+    int r, g, b;
+};
+
+ChannelOffsets channelOffsets(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRA8:
+    case PixelFormat::BGRX8:
+    case PixelFormat::BGR8:
+        return {2, 1, 0};
+    default:
+        return {0, 1, 2};
+    }
+}
+
+// Convert a size x size block at (x, y) to YCbCr, replicating the last row
+// and column past the image edge
+void loadBlock(const unsigned char *pixels, int width, int height, int stride, int bpp, const ChannelOffsets &ofs, int x, int y, int size, float *Y, float *U, float *V)
+{
+    for (int row = y, pos = 0; row < y + size; ++row)
+    {
+        const unsigned char *line = pixels + static_cast<size_t>(row < height ? row : height - 1) * stride;
+        for (int col = x; col < x + size; ++col, ++pos)
+        {
+            const unsigned char *p = line + (col < width ? col : width - 1) * bpp;
+            float r = p[ofs.r], g = p[ofs.g], b = p[ofs.b];
+            Y[pos] = +0.29900f * r + 0.58700f * g + 0.11400f * b - 128;
+            U[pos] = -0.16874f * r - 0.33126f * g + 0.50000f * b;
+            V[pos] = +0.50000f * r - 0.41869f * g - 0.08131f * b;
+        }
+    }
+}
+
+bool encodeJpegStb(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality, bool subsample,
+                   std::vector<unsigned char> &out)
+{
+    float fdtbl_Y[64], fdtbl_UV[64];
+    unsigned char YTable[64], UVTable[64];
+
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    quality = quality < 50 ? 5000 / quality : 200 - quality * 2;
+
+    for (int i = 0; i < 64; ++i)
+    {
+        int yti = (YQT[i] * quality + 50) / 100;
+        YTable[zigZag[i]] = static_cast<unsigned char>(yti < 1 ? 1 : yti > 255 ? 255 : yti);
+        int uvti = (UVQT[i] * quality + 50) / 100;
+        UVTable[zigZag[i]] = static_cast<unsigned char>(uvti < 1 ? 1 : uvti > 255 ? 255 : uvti);
+    }
+
+    for (int row = 0, k = 0; row < 8; ++row)
+    {
+        for (int col = 0; col < 8; ++col, ++k)
+        {
+            fdtbl_Y[k] = 1 / (YTable[zigZag[k]] * aasf[row] * aasf[col]);
+            fdtbl_UV[k] = 1 / (UVTable[zigZag[k]] * aasf[row] * aasf[col]);
+        }
+    }
+
+    out.clear();
+
+    // Write headers
+    {
+        static const unsigned char head0[] = {0xFF, 0xD8, 0xFF, 0xE0, 0, 0x10, 'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0, 0xFF, 0xDB, 0, 0x84, 0};
+        static const unsigned char head2[] = {0xFF, 0xDA, 0, 0xC, 3, 1, 0, 2, 0x11, 3, 0x11, 0, 0x3F, 0};
+        const unsigned char head1[] = {0xFF, 0xC0, 0, 0x11, 8, static_cast<unsigned char>(height >> 8), static_cast<unsigned char>(height),
+                                       static_cast<unsigned char>(width >> 8), static_cast<unsigned char>(width), 3, 1,
+                                       static_cast<unsigned char>(subsample ? 0x22 : 0x11), 0, 2, 0x11, 1, 3, 0x11, 1, 0xFF, 0xC4, 0x01, 0xA2, 0};
+        auto put = [&out](const unsigned char *data, size_t len) { out.insert(out.end(), data, data + len); };
+        put(head0, sizeof(head0));
+        put(YTable, sizeof(YTable));
+        out.push_back(1);
+        put(UVTable, sizeof(UVTable));
+        put(head1, sizeof(head1));
+        put(std_dc_luminance_nrcodes + 1, sizeof(std_dc_luminance_nrcodes) - 1);
+        put(std_dc_luminance_values, sizeof(std_dc_luminance_values));
+        out.push_back(0x10); // HTYACinfo
+        put(std_ac_luminance_nrcodes + 1, sizeof(std_ac_luminance_nrcodes) - 1);
+        put(std_ac_luminance_values, sizeof(std_ac_luminance_values));
+        out.push_back(1); // HTUDCinfo
+        put(std_dc_chrominance_nrcodes + 1, sizeof(std_dc_chrominance_nrcodes) - 1);
+        put(std_dc_chrominance_values, sizeof(std_dc_chrominance_values));
+        out.push_back(0x11); // HTUACinfo
+        put(std_ac_chrominance_nrcodes + 1, sizeof(std_ac_chrominance_nrcodes) - 1);
+        put(std_ac_chrominance_values, sizeof(std_ac_chrominance_values));
+        put(head2, sizeof(head2));
+    }
+
+    // Encode 8x8 macroblocks
+    const int bpp = bytesPerPixel(format);
+    const ChannelOffsets ofs = channelOffsets(format);
+    BitWriter writer(out);
+    int DCY = 0, DCU = 0, DCV = 0;
+    if (subsample)
+    {
+        for (int y = 0; y < height; y += 16)
+        {
+            for (int x = 0; x < width; x += 16)
+            {
+                float Y[256], U[256], V[256];
+                loadBlock(pixels, width, height, stride, bpp, ofs, x, y, 16, Y, U, V);
+                DCY = processDU(writer, Y + 0, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                DCY = processDU(writer, Y + 8, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                DCY = processDU(writer, Y + 128, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                DCY = processDU(writer, Y + 136, 16, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+
+                // Subsample U, V
+                float subU[64], subV[64];
+                for (int yy = 0, pos = 0; yy < 8; ++yy)
+                {
+                    for (int xx = 0; xx < 8; ++xx, ++pos)
+                    {
+                        int j = yy * 32 + xx * 2;
+                        subU[pos] = (U[j + 0] + U[j + 1] + U[j + 16] + U[j + 17]) * 0.25f;
+                        subV[pos] = (V[j + 0] + V[j + 1] + V[j + 16] + V[j + 17]) * 0.25f;
+                    }
+                }
+                DCU = processDU(writer, subU, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                DCV = processDU(writer, subV, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+            }
+        }
+    }
+    else
+    {
+        for (int y = 0; y < height; y += 8)
+        {
+            for (int x = 0; x < width; x += 8)
+            {
+                float Y[64], U[64], V[64];
+                loadBlock(pixels, width, height, stride, bpp, ofs, x, y, 8, Y, U, V);
+                DCY = processDU(writer, Y, 8, fdtbl_Y, DCY, YDC_HT, YAC_HT);
+                DCU = processDU(writer, U, 8, fdtbl_UV, DCU, UVDC_HT, UVAC_HT);
+                DCV = processDU(writer, V, 8, fdtbl_UV, DCV, UVDC_HT, UVAC_HT);
+            }
+        }
+    }
+
+    // Do the bit alignment of the EOI marker
+    writer.flush();
+
+    // EOI
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+    return true;
+}
+
+bool encodeWith(bool turbo, const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality, bool subsample,
+                bool optimizeHuffman, std::vector<unsigned char> &out)
+{
+#if defined(SCREENSHOT_HAVE_JPEG_TURBO)
+    if (turbo)
+    {
+        return encodeJpegTurbo(pixels, width, height, stride, format, quality, subsample, optimizeHuffman, out);
+    }
+#else
+    (void)turbo;
+    (void)optimizeHuffman;
+#endif
+    return encodeJpegStb(pixels, width, height, stride, format, quality, subsample, out);
+}
+
+// Image rows per restart segment: four 4:2:0 MCU rows (eight 4:4:4 ones),
+// so even a 450-row collage splits over several cores
+const int kRestartRows = 64;
+
+// Where the pieces of a complete single-scan baseline JPEG start
+struct ScanLayout
+{
+    size_t sof;       // SOF0 marker
+    size_t sos;       // SOS marker
+    size_t scanBegin; // entropy-coded data, right after the SOS header
+    size_t scanEnd;   // EOI marker
+};
+
+bool findScan(const std::vector<unsigned char> &jpeg, ScanLayout &layout)
+{
+    layout.sof = 0;
+    size_t pos = 2; // past SOI
+    while (pos + 4 <= jpeg.size() && jpeg[pos] == 0xFF)
+    {
+        const unsigned char marker = jpeg[pos + 1];
+        const size_t length = (static_cast<size_t>(jpeg[pos + 2]) << 8) | jpeg[pos + 3];
+        if (marker == 0xC0)
+        {
+            layout.sof = pos;
+        }
+        else if (marker == 0xDA)
+        {
+            layout.sos = pos;
+            layout.scanBegin = pos + 2 + length;
+            layout.scanEnd = jpeg.size() - 2;
+            return layout.sof && layout.scanBegin <= layout.scanEnd && jpeg[layout.scanEnd] == 0xFF && jpeg[layout.scanEnd + 1] == 0xD9;
+        }
+        pos += 2 + length;
+    }
+    return false;
+}
+
+// Every kRestartRows rows are encoded on the pool as a JPEG of their own,
+// then the scans are joined under the first stripe's headers, separated by
+// RST markers and announced by a DRI segment. A restart resets the DC
+// predictors exactly like the start of a scan, and the quantization and
+// Huffman tables are the same for every stripe, so the result is one
+// baseline JPEG any decoder reads. False when the stripes cannot be joined
+// (an image one stripe tall, or too wide for a 16-bit restart interval).
+bool encodeJpegSegmented(bool turbo, const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality,
+                         bool subsample, int threads, std::vector<unsigned char> &out)
+{
+    const int mcuSize = subsample ? 16 : 8;
+    const size_t interval = static_cast<size_t>((width + mcuSize - 1) / mcuSize) * (kRestartRows / mcuSize);
+    const size_t stripeCount = (height + kRestartRows - 1) / kRestartRows;
+    if (stripeCount < 2 || interval > 0xffff)
+    {
+        return false;
+    }
+
+    std::vector<std::vector<unsigned char>> stripes(stripeCount);
+    std::vector<ScanLayout> layouts(stripeCount);
+    std::vector<char> ok(stripeCount, 0);
+    ThreadPool::shared().parallelFor(stripeCount, [&](size_t s) {
+        const int y = static_cast<int>(s) * kRestartRows;
+        ok[s] = encodeWith(turbo, pixels + static_cast<size_t>(y) * stride, width, std::min(kRestartRows, height - y), stride, format, quality,
+                           subsample, false, stripes[s]) &&
+                findScan(stripes[s], layouts[s]);
+    }, threads);
+    size_t total = 6 + 2;
+    for (size_t s = 0; s < stripeCount; ++s)
+    {
+        if (!ok[s])
+        {
+            return false;
+        }
+        total += layouts[s].scanEnd - layouts[s].scanBegin + 2;
+    }
+
+    const std::vector<unsigned char> &first = stripes[0];
+    const ScanLayout &head = layouts[0];
+    out.clear();
+    out.reserve(head.scanBegin + total);
+    out.insert(out.end(), first.begin(), first.begin() + head.sos);
+    out[head.sof + 5] = static_cast<unsigned char>(height >> 8);
+    out[head.sof + 6] = static_cast<unsigned char>(height);
+    const unsigned char dri[] = {0xFF, 0xDD, 0, 4, static_cast<unsigned char>(interval >> 8), static_cast<unsigned char>(interval)};
+    out.insert(out.end(), dri, dri + sizeof(dri));
+    out.insert(out.end(), first.begin() + head.sos, first.begin() + head.scanBegin);
+    for (size_t s = 0; s < stripeCount; ++s)
+    {
+        out.insert(out.end(), stripes[s].begin() + layouts[s].scanBegin, stripes[s].begin() + layouts[s].scanEnd);
+        if (s + 1 < stripeCount)
+        {
+            out.push_back(0xFF);
+            out.push_back(static_cast<unsigned char>(0xD0 + s % 8)); // RST0..RST7
+        }
+    }
+    out.push_back(0xFF);
+    out.push_back(0xD9);
+    return true;
+}
+
+} // namespace
+
+const char *jpegBackendName(JpegBackend backend)
+{
+    switch (backend)
+    {
+    case JpegBackend::Auto:
+        return "auto";
+    case JpegBackend::Stb:
+        return "stb";
+    case JpegBackend::Turbo:
+        return "turbo";
+    }
+    return "unknown";
+}
+
+const char *jpegSubsamplingName(JpegSubsampling subsampling)
+{
+    switch (subsampling)
+    {
+    case JpegSubsampling::Auto:
+        return "auto";
+    case JpegSubsampling::S444:
+        return "444";
+    case JpegSubsampling::S420:
+        return "420";
+    }
+    return "unknown";
+}
+
+bool parseJpegBackend(const std::string &name, JpegBackend &backend)
+{
+    const JpegBackend backends[] = {JpegBackend::Auto, JpegBackend::Stb, JpegBackend::Turbo};
+    for (JpegBackend candidate : backends)
+    {
+        if (name == jpegBackendName(candidate))
+        {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseJpegSubsampling(const std::string &name, JpegSubsampling &subsampling)
+{
+    const JpegSubsampling modes[] = {JpegSubsampling::Auto, JpegSubsampling::S444, JpegSubsampling::S420};
+    for (JpegSubsampling candidate : modes)
+    {
+        if (name == jpegSubsamplingName(candidate))
+        {
+            subsampling = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool jpegBackendAvailable(JpegBackend backend)
+{
+#if defined(SCREENSHOT_HAVE_JPEG_TURBO)
+    (void)backend;
+    return true;
+#else
+    return backend != JpegBackend::Turbo;
+#endif
+}
+
+bool encodeJpeg(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, const JpegOptions &options,
+                std::vector<unsigned char> &out, int threads)
+{
+    if (!pixels || width <= 0 || height <= 0 || width > 0xffff || height > 0xffff)
+    {
+        std::cerr << "Cannot encode a " << width << "x" << height << " JPEG" << std::endl;
+        return false;
+    }
+
+    int quality = options.quality ? options.quality : 90;
+    bool subsample = options.subsampling == JpegSubsampling::Auto ? quality <= 90 : options.subsampling == JpegSubsampling::S420;
+    bool turbo = options.backend != JpegBackend::Stb && jpegBackendAvailable(JpegBackend::Turbo);
+
+    // Huffman tables fitted per stripe would differ between segments
+    if (options.restartSegments && !(turbo && options.optimizeHuffman) &&
+        encodeJpegSegmented(turbo, pixels, width, height, stride, format, quality, subsample, threads, out))
+    {
+        return true;
+    }
+    return encodeWith(turbo, pixels, width, height, stride, format, quality, subsample, options.optimizeHuffman, out);
+}
+
+bool encodeJpeg(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality, std::vector<unsigned char> &out)
+{
+    JpegOptions options;
+    options.quality = quality;
+    return encodeJpeg(pixels, width, height, stride, format, options, out);
+}
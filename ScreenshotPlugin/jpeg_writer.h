@@ -0,0 +1,64 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <string>
+#include <vector>
+
+enum class JpegBackend
+{
+    Auto,  // libjpeg-turbo when the build has it (SCREENSHOT_JPEG), stb otherwise
+    Stb,   // port of stbi_write_jpg: float DCT, fixed Huffman tables
+    Turbo  // libjpeg-turbo: SIMD DCT and colour conversion, optional optimized Huffman tables
+};
+
+enum class JpegSubsampling
+{
+    Auto, // 4:2:0 at quality 90 and below, 4:4:4 above (stbi_write_jpg's rule)
+    S444,
+    S420
+};
+
+const char *jpegBackendName(JpegBackend backend);
+const char *jpegSubsamplingName(JpegSubsampling subsampling);
+
+// Parse "auto", "stb" or "turbo" / "auto", "444" or "420"; false leaves the
+// value as is
+bool parseJpegBackend(const std::string &name, JpegBackend &backend);
+bool parseJpegSubsampling(const std::string &name, JpegSubsampling &subsampling);
+
+// Whether backend can be used in this build (Auto and Stb always can)
+bool jpegBackendAvailable(JpegBackend backend);
+
+struct JpegOptions
+{
+    int quality; // 1-100
+    JpegSubsampling subsampling;
+    bool optimizeHuffman; // Huffman tables fitted to the image (a second pass); Turbo only
+    JpegBackend backend;
+
+    // Encode bands of 64 rows in parallel as restart-interval segments of one
+    // baseline scan. Ignored with optimizeHuffman on Turbo; off reproduces
+    // stbi_write_jpg byte for byte on the stb backend.
+    bool restartSegments;
+
+    JpegOptions()
+        : quality(90), subsampling(JpegSubsampling::Auto), optimizeHuffman(false), backend(JpegBackend::Auto), restartSegments(true)
+    {
+    }
+};
+
+// Baseline JPEG encoder that reads capture and compositor buffers as they
+// are: any PixelFormat, any row stride. Alpha is ignored. The stb backend
+// (the stb_image_write / jo_jpeg core) resolves channel order in the
+// RGB->YCbCr step, which touches every pixel anyway, so BGRA/BGRX input
+// costs nothing extra; libjpeg-turbo reads the same layouts through its
+// extended colour spaces. A backend the build lacks falls back to stb.
+// Restart segments run on up to threads threads of the shared pool (0 = all
+// of them); the output does not depend on the thread count.
+bool encodeJpeg(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, const JpegOptions &options,
+                std::vector<unsigned char> &out, int threads = 0);
+
+// encodeJpeg() with the default options at quality, which follows
+// stbi_write_jpg: 1-100, chroma is subsampled 4:2:0 at 90 and below
+bool encodeJpeg(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, int quality, std::vector<unsigned char> &out);
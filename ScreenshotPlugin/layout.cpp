@@ -0,0 +1,277 @@
+#include "layout.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+
+LayoutRect intersect(const LayoutRect &a, const LayoutRect &b)
+{
+    int left = std::max(a.x, b.x);
+    int top = std::max(a.y, b.y);
+    int right = std::min(a.x + a.width, b.x + b.width);
+    int bottom = std::min(a.y + a.height, b.y + b.height);
+    return LayoutRect(left, top, std::max(right - left, 0), std::max(bottom - top, 0));
+}
+
+// a minus b as up to four disjoint rectangles: full-width bands above and
+// below b, then the parts left and right of it
+void subtract(const LayoutRect &a, const LayoutRect &b, std::vector<LayoutRect> &out)
+{
+    LayoutRect overlap = intersect(a, b);
+    if (overlap.empty())
+    {
+        out.push_back(a);
+        return;
+    }
+    LayoutRect pieces[4] = {
+        LayoutRect(a.x, a.y, a.width, overlap.y - a.y),
+        LayoutRect(a.x, overlap.y + overlap.height, a.width, a.y + a.height - overlap.y - overlap.height),
+        LayoutRect(a.x, overlap.y, overlap.x - a.x, overlap.height),
+        LayoutRect(overlap.x + overlap.width, overlap.y, a.x + a.width - overlap.x - overlap.width, overlap.height),
+    };
+    for (const LayoutRect &piece : pieces)
+    {
+        if (!piece.empty())
+        {
+            out.push_back(piece);
+        }
+    }
+}
+
+// The non-empty parts of area outside every placement from first on
+std::vector<LayoutRect> uncovered(const LayoutRect &area, const std::vector<LayoutPlacement> &placements, size_t first)
+{
+    std::vector<LayoutRect> pieces;
+    if (!area.empty())
+    {
+        pieces.push_back(area);
+    }
+    for (size_t p = first; p < placements.size() && !pieces.empty(); ++p)
+    {
+        std::vector<LayoutRect> remaining;
+        for (const LayoutRect &piece : pieces)
+        {
+            subtract(piece, placements[p].rect, remaining);
+        }
+        pieces.swap(remaining);
+    }
+    return pieces;
+}
+
+// Largest size with the source's aspect ratio that fits the cell, truncated
+// the way combineImages always has
+std::pair<int, int> fitIntoCell(const std::pair<int, int> &size, int cellWidth, int cellHeight)
+{
+    float scale = std::min(static_cast<float>(cellWidth) / size.first, static_cast<float>(cellHeight) / size.second);
+    return std::make_pair(static_cast<int>(size.first * scale), static_cast<int>(size.second * scale));
+}
+
+void place(Layout &layout, size_t source, const LayoutRect &rect)
+{
+    if (rect.empty())
+    {
+        return;
+    }
+    LayoutPlacement placement;
+    placement.source = source;
+    placement.rect = rect;
+    layout.placements.push_back(placement);
+}
+
+void placeRowOrColumn(const LayoutSpec &spec, const std::vector<std::pair<int, int>> &sizes, bool row, Layout &layout)
+{
+    int offset = 0;
+    for (size_t i = 0; i < sizes.size(); ++i)
+    {
+        std::pair<int, int> fitted = fitIntoCell(sizes[i], spec.cellWidth, spec.cellHeight);
+        if (row)
+        {
+            place(layout, i, LayoutRect(offset, 0, fitted.first, fitted.second));
+            offset += fitted.first + spec.gap;
+            layout.height = std::max(layout.height, fitted.second);
+        }
+        else
+        {
+            place(layout, i, LayoutRect(0, offset, fitted.first, fitted.second));
+            offset += fitted.second + spec.gap;
+            layout.width = std::max(layout.width, fitted.first);
+        }
+    }
+    (row ? layout.width : layout.height) = std::max(offset - spec.gap, 0);
+}
+
+void placeGrid(const LayoutSpec &spec, const std::vector<std::pair<int, int>> &sizes, Layout &layout)
+{
+    const int count = static_cast<int>(sizes.size());
+    const int columns = spec.columns > 0 ? spec.columns : static_cast<int>(std::ceil(std::sqrt(static_cast<double>(count))));
+    const int rows = (count + columns - 1) / columns;
+    layout.width = columns * spec.cellWidth + (columns - 1) * spec.gap;
+    layout.height = rows * spec.cellHeight + (rows - 1) * spec.gap;
+    for (int i = 0; i < count; ++i)
+    {
+        std::pair<int, int> fitted = fitIntoCell(sizes[i], spec.cellWidth, spec.cellHeight);
+        int cellX = (i % columns) * (spec.cellWidth + spec.gap);
+        int cellY = (i / columns) * (spec.cellHeight + spec.gap);
+        place(layout, i,
+              LayoutRect(cellX + (spec.cellWidth - fitted.first) / 2, cellY + (spec.cellHeight - fitted.second) / 2, fitted.first, fitted.second));
+    }
+}
+
+void placePip(const LayoutSpec &spec, const std::vector<std::pair<int, int>> &sizes, Layout &layout)
+{
+    layout.width = sizes[0].first;
+    layout.height = sizes[0].second;
+    place(layout, 0, LayoutRect(0, 0, layout.width, layout.height));
+
+    // Every inset has the same size, a fraction of the main source
+    int insetWidth = static_cast<int>(layout.width * spec.insetScale);
+    int insetHeight = static_cast<int>(layout.height * spec.insetScale);
+    int x = layout.width - insetWidth - spec.margin;
+    int y = layout.height - insetHeight - spec.margin;
+    int placed = 0;
+    for (size_t i = 1; i < sizes.size() && x >= 0 && y >= 0 && (spec.maxInsets < 0 || placed < spec.maxInsets); ++i)
+    {
+        place(layout, i, LayoutRect(x, y, insetWidth, insetHeight));
+        y -= insetHeight + spec.insetGap;
+        ++placed;
+    }
+}
+
+void placeCustom(const LayoutSpec &spec, const std::vector<std::pair<int, int>> &sizes, Layout &layout)
+{
+    layout.width = std::max(spec.canvasWidth, 0);
+    layout.height = std::max(spec.canvasHeight, 0);
+    for (size_t i = 0; i < sizes.size() && i < spec.rects.size(); ++i)
+    {
+        place(layout, i, spec.rects[i]);
+    }
+}
+
+// Source pixels [begin, end) of a source size long that the canvas part
+// [clippedBegin, clippedBegin + clippedLength) of its placement at
+// [placedBegin, placedBegin + placedLength) shows, rounded outwards
+std::pair<int, int> cropSpan(int size, int placedBegin, int placedLength, int clippedBegin, int clippedLength)
+{
+    long long begin = static_cast<long long>(clippedBegin - placedBegin) * size / placedLength;
+    long long end = (static_cast<long long>(clippedBegin + clippedLength - placedBegin) * size + placedLength - 1) / placedLength;
+    return std::make_pair(static_cast<int>(begin), static_cast<int>(std::min<long long>(end, size)));
+}
+
+// Cut placement down to the canvas with the part of its source that stays
+// on it, so the rest is cut off rather than squeezed in
+void clipToCanvas(LayoutPlacement &placement, const std::pair<int, int> &size, const LayoutRect &canvas)
+{
+    placement.crop = LayoutRect(0, 0, size.first, size.second);
+    const LayoutRect &rect = placement.rect;
+    LayoutRect clipped = intersect(rect, canvas);
+    if (clipped.empty() || (clipped.width == rect.width && clipped.height == rect.height))
+    {
+        placement.rect = clipped;
+        return;
+    }
+    std::pair<int, int> columns = cropSpan(size.first, rect.x, rect.width, clipped.x, clipped.width);
+    std::pair<int, int> rows = cropSpan(size.second, rect.y, rect.height, clipped.y, clipped.height);
+    placement.crop = LayoutRect(columns.first, rows.first, columns.second - columns.first, rows.second - rows.first);
+    placement.rect = clipped;
+}
+
+} // namespace
+
+const char *layoutKindName(LayoutKind kind)
+{
+    switch (kind)
+    {
+    case LayoutKind::Auto:
+        return "auto";
+    case LayoutKind::Row:
+        return "row";
+    case LayoutKind::Column:
+        return "column";
+    case LayoutKind::Grid:
+        return "grid";
+    case LayoutKind::Pip:
+        return "pip";
+    case LayoutKind::Custom:
+        return "custom";
+    }
+    return "unknown";
+}
+
+bool parseLayoutKind(const std::string &name, LayoutKind &kind)
+{
+    const LayoutKind kinds[] = {LayoutKind::Auto, LayoutKind::Row, LayoutKind::Column, LayoutKind::Grid, LayoutKind::Pip, LayoutKind::Custom};
+    for (LayoutKind candidate : kinds)
+    {
+        if (name == layoutKindName(candidate))
+        {
+            kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+LayoutSpec collageLayoutSpec()
+{
+    LayoutSpec spec;
+    spec.kind = LayoutKind::Row;
+    return spec;
+}
+
+LayoutSpec pipLayoutSpec()
+{
+    LayoutSpec spec;
+    spec.kind = LayoutKind::Pip;
+    return spec;
+}
+
+Layout computeLayout(const LayoutSpec &spec, const std::vector<std::pair<int, int>> &sizes)
+{
+    Layout layout;
+    if (sizes.empty())
+    {
+        return layout;
+    }
+
+    switch (spec.kind)
+    {
+    case LayoutKind::Auto:
+    case LayoutKind::Row:
+        placeRowOrColumn(spec, sizes, true, layout);
+        break;
+    case LayoutKind::Column:
+        placeRowOrColumn(spec, sizes, false, layout);
+        break;
+    case LayoutKind::Grid:
+        placeGrid(spec, sizes, layout);
+        break;
+    case LayoutKind::Pip:
+        placePip(spec, sizes, layout);
+        break;
+    case LayoutKind::Custom:
+        placeCustom(spec, sizes, layout);
+        break;
+    }
+
+    LayoutRect canvas(0, 0, layout.width, layout.height);
+    std::vector<LayoutPlacement> onCanvas;
+    for (LayoutPlacement &placement : layout.placements)
+    {
+        clipToCanvas(placement, sizes[placement.source], canvas);
+        if (!placement.rect.empty() && !placement.crop.empty())
+        {
+            onCanvas.push_back(placement);
+        }
+    }
+    layout.placements.swap(onCanvas);
+
+    // What each placement still shows once everything above it is drawn
+    for (size_t p = 0; p < layout.placements.size(); ++p)
+    {
+        layout.placements[p].visible = uncovered(layout.placements[p].rect, layout.placements, p + 1);
+    }
+    layout.gutters = uncovered(canvas, layout.placements, 0);
+    return layout;
+}
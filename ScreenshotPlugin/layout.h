@@ -0,0 +1,96 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+// Declarative composite layouts. A LayoutSpec describes the arrangement;
+// computeLayout() turns it and the source sizes into the canvas size and one
+// placement per shown source, each with the parts of its rectangle that stay
+// visible, plus the gutters between them. Compositing then fills every
+// visible part once, resampling its source straight into place, and clears
+// only the gutters, so nothing is drawn and then overwritten.
+
+enum class LayoutKind
+{
+    Auto,   // collage or PIP, whichever the caller asked for
+    Row,    // side by side, each source fitted into cellWidth x cellHeight (the collage)
+    Column, // stacked top to bottom, each source fitted into cellWidth x cellHeight
+    Grid,   // columns x rows of cellWidth x cellHeight cells, sources centred in their cell
+    Pip,    // source 0 at full size, the others as insets stacked up its right edge
+    Custom  // source i scaled into rects[i] on a canvasWidth x canvasHeight canvas
+};
+
+const char *layoutKindName(LayoutKind kind);
+
+// Parses "auto", "row", "column", "grid", "pip" or "custom"; false leaves
+// kind as is
+bool parseLayoutKind(const std::string &name, LayoutKind &kind);
+
+struct LayoutRect
+{
+    int x;
+    int y;
+    int width;
+    int height;
+
+    LayoutRect() : x(0), y(0), width(0), height(0) {}
+    LayoutRect(int x, int y, int width, int height) : x(x), y(y), width(width), height(height) {}
+
+    bool empty() const { return width <= 0 || height <= 0; }
+};
+
+struct LayoutSpec
+{
+    LayoutKind kind;
+
+    // Row, Column and Grid
+    int cellWidth;
+    int cellHeight;
+    int gap;     // pixels between neighbouring cells
+    int columns; // Grid; 0 picks the smallest square grid that fits
+
+    // Pip
+    double insetScale; // inset size relative to the main source
+    int margin;        // from the right and bottom edges to the first inset
+    int insetGap;      // between stacked insets
+    int maxInsets;     // -1: as many as fit above each other
+
+    // Custom; sources without a rect are left out
+    int canvasWidth;
+    int canvasHeight;
+    std::vector<LayoutRect> rects;
+
+    LayoutSpec()
+        : kind(LayoutKind::Auto), cellWidth(800), cellHeight(800), gap(0), columns(0), insetScale(1 / 3.2), margin(20), insetGap(15),
+          maxInsets(-1), canvasWidth(0), canvasHeight(0)
+    {
+    }
+};
+
+// The layouts combineImages and pipImages have always produced
+LayoutSpec collageLayoutSpec();
+LayoutSpec pipLayoutSpec();
+
+struct LayoutPlacement
+{
+    size_t source;                   // index into the sources
+    LayoutRect crop;                 // part of the source shown: all of it unless it would overflow the canvas
+    LayoutRect rect;                 // crop, scaled to this rectangle inside the canvas
+    std::vector<LayoutRect> visible; // canvas rectangles of rect not covered by later placements
+};
+
+struct Layout
+{
+    int width;
+    int height;
+    std::vector<LayoutPlacement> placements; // in paint order: later placements lie on top
+    std::vector<LayoutRect> gutters;         // canvas rectangles no placement covers; none when the sources tile the canvas
+
+    Layout() : width(0), height(0) {}
+};
+
+// Place sources of the given (width, height) sizes. Auto is treated as Row.
+// Placements that overflow the canvas (negative gaps or margins, Custom
+// rects beyond it) are clipped to it, cropping their sources to match.
+Layout computeLayout(const LayoutSpec &spec, const std::vector<std::pair<int, int>> &sizes);
@@ -0,0 +1,390 @@
+#include "palette.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+inline unsigned hashColor(uint32_t color)
+{
+    // Fibonacci hashing: the top bits of the product mix every channel
+    return (color * 2654435769u) >> 22;
+}
+
+// Indexes rows of Bpp-byte pixels whose channels sit at R, G, B and A
+// (A < 0: opaque) into a palette table
+template <int R, int G, int B, int A, int Bpp>
+bool indexPixels(const ImageView &image, PaletteTable &table, unsigned char *indices)
+{
+    for (int y = 0; y < image.height; ++y)
+    {
+        const unsigned char *px = image.pixels + static_cast<size_t>(y) * image.stride;
+        unsigned char *dst = indices + static_cast<size_t>(y) * image.width;
+        for (int x = 0; x < image.width; ++x, px += Bpp)
+        {
+            int index = table.insert(packRgba(px[R], px[G], px[B], A < 0 ? 255 : px[A < 0 ? 0 : A]));
+            if (index < 0)
+            {
+                return false;
+            }
+            dst[x] = static_cast<unsigned char>(index);
+        }
+    }
+    return true;
+}
+
+// Median cut works on colours binned to 5 bits per colour channel and 3 for
+// alpha: 2^18 bins, few enough to sort the occupied ones
+const int kBinBits[4] = {5, 5, 5, 3};
+const int kBinShift[4] = {0, 5, 10, 15};
+const int kBins = 1 << 18;
+
+// Weights of the channel ranges when choosing boxes and split axes
+const double kChannelWeight[4] = {0.6, 1.0, 0.4, 1.0};
+
+// The same weights, squared and scaled to integers, for colour distances
+const int kDistanceWeight[4] = {9, 25, 4, 25};
+
+inline uint32_t binOf(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    return (r >> 3) | ((g >> 3) << 5) | ((b >> 3) << 10) | ((a >> 5) << 15);
+}
+
+// Channel c of a bin key, back on the 0-255 scale
+inline int binChannel(uint32_t key, int c)
+{
+    return static_cast<int>((key >> kBinShift[c]) & ((1u << kBinBits[c]) - 1)) << (8 - kBinBits[c]);
+}
+
+// Calls visitor(pixel index, r, g, b, a) for every pixel of Bpp-byte rows
+// whose channels sit at R, G, B and A (A < 0: opaque)
+template <int R, int G, int B, int A, int Bpp, typename Visitor>
+void visitPixels(const ImageView &image, Visitor &visitor)
+{
+    for (int y = 0; y < image.height; ++y)
+    {
+        const unsigned char *px = image.pixels + static_cast<size_t>(y) * image.stride;
+        size_t index = static_cast<size_t>(y) * image.width;
+        for (int x = 0; x < image.width; ++x, px += Bpp, ++index)
+        {
+            visitor(index, px[R], px[G], px[B], A < 0 ? 255u : px[A < 0 ? 0 : A]);
+        }
+    }
+}
+
+template <typename Visitor>
+void visitImage(const ImageView &image, Visitor &visitor)
+{
+    switch (image.format)
+    {
+    case PixelFormat::BGRA8:
+        visitPixels<2, 1, 0, 3, 4>(image, visitor);
+        break;
+    case PixelFormat::BGRX8:
+        visitPixels<2, 1, 0, -1, 4>(image, visitor);
+        break;
+    case PixelFormat::BGR8:
+        visitPixels<2, 1, 0, -1, 3>(image, visitor);
+        break;
+    case PixelFormat::RGBA8:
+        visitPixels<0, 1, 2, 3, 4>(image, visitor);
+        break;
+    case PixelFormat::RGB8:
+        visitPixels<0, 1, 2, -1, 3>(image, visitor);
+        break;
+    }
+}
+
+struct HistogramVisitor
+{
+    std::vector<uint32_t> &counts;
+
+    void operator()(size_t, unsigned r, unsigned g, unsigned b, unsigned a) { ++counts[binOf(r, g, b, a)]; }
+};
+
+// Writes each pixel's palette index and sums its channels into its entry
+struct MappingVisitor
+{
+    const std::vector<unsigned char> &binIndex;
+    unsigned char *indices;
+    std::vector<uint64_t> &sums; // r, g, b, a and the pixel count per entry
+
+    void operator()(size_t pixel, unsigned r, unsigned g, unsigned b, unsigned a)
+    {
+        unsigned char index = binIndex[binOf(r, g, b, a)];
+        indices[pixel] = index;
+        uint64_t *sum = &sums[index * 5];
+        sum[0] += r;
+        sum[1] += g;
+        sum[2] += b;
+        sum[3] += a;
+        ++sum[4];
+    }
+};
+
+struct ColorBin
+{
+    uint32_t key;
+    uint32_t count;
+};
+
+// A run of bins [begin, end) of the sorted bin list
+struct ColorBox
+{
+    size_t begin;
+    size_t end;
+    uint64_t count;
+    int axis;      // channel with the widest weighted range
+    double spread; // that range, weighted; 0 when the box cannot be split
+};
+
+void measureBox(const std::vector<ColorBin> &bins, ColorBox &box)
+{
+    int lo[4] = {255, 255, 255, 255};
+    int hi[4] = {0, 0, 0, 0};
+    box.count = 0;
+    for (size_t i = box.begin; i < box.end; ++i)
+    {
+        box.count += bins[i].count;
+        for (int c = 0; c < 4; ++c)
+        {
+            int v = binChannel(bins[i].key, c);
+            lo[c] = std::min(lo[c], v);
+            hi[c] = std::max(hi[c], v);
+        }
+    }
+    box.axis = 0;
+    box.spread = 0;
+    for (int c = 0; c < 4; ++c)
+    {
+        double spread = (hi[c] - lo[c]) * kChannelWeight[c];
+        if (spread > box.spread)
+        {
+            box.spread = spread;
+            box.axis = c;
+        }
+    }
+}
+
+} // namespace
+
+PaletteTable::PaletteTable() : count_(0), lastColor_(0), lastIndex_(-1)
+{
+    std::memset(values_, 0xff, sizeof(values_));
+}
+
+int PaletteTable::insert(uint32_t color)
+{
+    if (color == lastColor_ && lastIndex_ >= 0)
+    {
+        return lastIndex_;
+    }
+    unsigned slot = hashColor(color);
+    while (values_[slot] >= 0)
+    {
+        if (keys_[slot] == color)
+        {
+            lastColor_ = color;
+            lastIndex_ = values_[slot];
+            return lastIndex_;
+        }
+        slot = (slot + 1) & (kSlots - 1);
+    }
+    if (count_ == kMaxPaletteColors)
+    {
+        return -1;
+    }
+    keys_[slot] = color;
+    values_[slot] = static_cast<int16_t>(count_);
+    colors_[count_] = color;
+    lastColor_ = color;
+    lastIndex_ = count_;
+    return count_++;
+}
+
+bool buildExactPalette(const ImageView &image, std::vector<uint32_t> &palette, std::vector<unsigned char> &indices)
+{
+    palette.clear();
+    indices.resize(static_cast<size_t>(image.width) * image.height);
+    PaletteTable table;
+    bool fits = false;
+    switch (image.format)
+    {
+    case PixelFormat::BGRA8:
+        fits = indexPixels<2, 1, 0, 3, 4>(image, table, indices.data());
+        break;
+    case PixelFormat::BGRX8:
+        fits = indexPixels<2, 1, 0, -1, 4>(image, table, indices.data());
+        break;
+    case PixelFormat::BGR8:
+        fits = indexPixels<2, 1, 0, -1, 3>(image, table, indices.data());
+        break;
+    case PixelFormat::RGBA8:
+        fits = indexPixels<0, 1, 2, 3, 4>(image, table, indices.data());
+        break;
+    case PixelFormat::RGB8:
+        fits = indexPixels<0, 1, 2, -1, 3>(image, table, indices.data());
+        break;
+    }
+    if (!fits)
+    {
+        indices.clear();
+        return false;
+    }
+    palette.assign(table.colors(), table.colors() + table.size());
+    return true;
+}
+
+bool quantizePalette(const ImageView &image, int maxColors, std::vector<uint32_t> &palette, std::vector<unsigned char> &indices)
+{
+    palette.clear();
+    indices.clear();
+    if (!image.pixels || image.width <= 0 || image.height <= 0 || maxColors < 1 || maxColors > kMaxPaletteColors)
+    {
+        return false;
+    }
+
+    std::vector<uint32_t> counts(kBins, 0);
+    HistogramVisitor histogram = {counts};
+    visitImage(image, histogram);
+    std::vector<ColorBin> bins;
+    for (uint32_t key = 0; key < static_cast<uint32_t>(kBins); ++key)
+    {
+        if (counts[key])
+        {
+            ColorBin bin = {key, counts[key]};
+            bins.push_back(bin);
+        }
+    }
+
+    // Split the box with the largest spread times sqrt(pixels) at the pixel
+    // median of its widest channel until there are maxColors boxes or none
+    // can split
+    std::vector<ColorBox> boxes(1);
+    boxes[0].begin = 0;
+    boxes[0].end = bins.size();
+    measureBox(bins, boxes[0]);
+    while (static_cast<int>(boxes.size()) < maxColors)
+    {
+        size_t next = boxes.size();
+        double bestScore = 0;
+        for (size_t i = 0; i < boxes.size(); ++i)
+        {
+            double score = boxes[i].spread * std::sqrt(static_cast<double>(boxes[i].count));
+            if (boxes[i].end - boxes[i].begin > 1 && score > bestScore)
+            {
+                bestScore = score;
+                next = i;
+            }
+        }
+        if (next == boxes.size())
+        {
+            break;
+        }
+        ColorBox &box = boxes[next];
+        const int axis = box.axis;
+        std::sort(bins.begin() + box.begin, bins.begin() + box.end,
+                  [axis](const ColorBin &a, const ColorBin &b) { return binChannel(a.key, axis) < binChannel(b.key, axis); });
+        size_t split = box.begin + 1;
+        uint64_t below = bins[box.begin].count;
+        while (split + 1 < box.end && below * 2 < box.count)
+        {
+            below += bins[split++].count;
+        }
+        ColorBox upper;
+        upper.begin = split;
+        upper.end = box.end;
+        box.end = split;
+        measureBox(bins, box);
+        measureBox(bins, upper);
+        boxes.push_back(upper);
+    }
+
+    // Each box's mean over its bins seeds the palette; every bin then maps to
+    // the nearest entry, which may belong to another box when the median
+    // split left a rare colour at the edge of a large one
+    std::vector<int> seeds(boxes.size() * 4);
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        double mean[4] = {0, 0, 0, 0};
+        for (size_t b = boxes[i].begin; b < boxes[i].end; ++b)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                mean[c] += static_cast<double>(binChannel(bins[b].key, c)) * bins[b].count;
+            }
+        }
+        for (int c = 0; c < 4; ++c)
+        {
+            seeds[i * 4 + c] = static_cast<int>(mean[c] / boxes[i].count + 0.5);
+        }
+    }
+    std::vector<unsigned char> binIndex(kBins, 0);
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        for (size_t b = boxes[i].begin; b < boxes[i].end; ++b)
+        {
+            int best = static_cast<int>(i);
+            int bestDistance = 0x7fffffff;
+            for (size_t j = 0; j < boxes.size(); ++j)
+            {
+                int distance = 0;
+                for (int c = 0; c < 4; ++c)
+                {
+                    int d = binChannel(bins[b].key, c) - seeds[j * 4 + c];
+                    distance += d * d * kDistanceWeight[c];
+                }
+                if (distance < bestDistance)
+                {
+                    bestDistance = distance;
+                    best = static_cast<int>(j);
+                }
+            }
+            binIndex[bins[b].key] = static_cast<unsigned char>(best);
+        }
+    }
+    indices.resize(static_cast<size_t>(image.width) * image.height);
+    std::vector<uint64_t> sums(boxes.size() * 5, 0);
+    MappingVisitor mapping = {binIndex, indices.data(), sums};
+    visitImage(image, mapping);
+
+    palette.resize(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i)
+    {
+        const uint64_t *sum = &sums[i * 5];
+        const uint64_t n = std::max<uint64_t>(sum[4], 1);
+        palette[i] = packRgba(static_cast<unsigned>((sum[0] + n / 2) / n), static_cast<unsigned>((sum[1] + n / 2) / n),
+                              static_cast<unsigned>((sum[2] + n / 2) / n), static_cast<unsigned>((sum[3] + n / 2) / n));
+    }
+    return true;
+}
+
+const char *pngPaletteName(PngPalette palette)
+{
+    switch (palette)
+    {
+    case PngPalette::Off:
+        return "off";
+    case PngPalette::Exact:
+        return "exact";
+    case PngPalette::Quantize:
+        return "quantize";
+    }
+    return "unknown";
+}
+
+bool parsePngPalette(const std::string &name, PngPalette &palette)
+{
+    const PngPalette palettes[] = {PngPalette::Off, PngPalette::Exact, PngPalette::Quantize};
+    for (PngPalette candidate : palettes)
+    {
+        if (name == pngPaletteName(candidate))
+        {
+            palette = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "image.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Most colours an indexed PNG holds
+const int kMaxPaletteColors = 256;
+
+// Colours are packed as little-endian RGBA words: r | g << 8 | b << 16 | a << 24
+inline uint32_t packRgba(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+// Open-addressing hash map from colour to palette index, sized so it never
+// holds more than a quarter of its slots. Consecutive lookups of the same
+// colour, the common case in UI content, skip the hash.
+class PaletteTable
+{
+public:
+    PaletteTable();
+
+    // Index of color, added with the next free index if it is new; -1 when
+    // the palette is full and color is not in it
+    int insert(uint32_t color);
+
+    int size() const { return count_; }
+    const uint32_t *colors() const { return colors_; }
+
+private:
+    static const int kSlots = 1024;
+
+    uint32_t keys_[kSlots];
+    int16_t values_[kSlots]; // -1 for an empty slot
+    uint32_t colors_[kMaxPaletteColors];
+    int count_;
+    uint32_t lastColor_;
+    int lastIndex_;
+};
+
+// Every distinct colour of image, in first-seen order, and one index byte per
+// pixel in indices (width bytes per row, no padding). 3-byte and BGRX8
+// pixels are opaque. Stops and returns false as soon as a colour beyond
+// kMaxPaletteColors shows up, so truecolor content costs only the pixels
+// read until then.
+bool buildExactPalette(const ImageView &image, std::vector<uint32_t> &palette, std::vector<unsigned char> &indices);
+
+// Reduces image to at most maxColors (1-256) colours by median cut and
+// writes the palette and one index byte per pixel as buildExactPalette()
+// does. Colours are binned at 5 bits per colour channel and 3 for alpha;
+// the box split next has the widest channel range times the square root of
+// its pixel count, with green weighted above red and red above blue as the
+// eye sees errors in them. Every bin then takes the nearest box colour, and
+// each palette entry is the mean of the pixels mapped to it. No dithering:
+// flat UI areas stay flat.
+bool quantizePalette(const ImageView &image, int maxColors, std::vector<uint32_t> &palette, std::vector<unsigned char> &indices);
+
+// When PNG output is written with a palette
+enum class PngPalette
+{
+    Off,     // always truecolor
+    Exact,   // indexed when the image has at most 256 colours, lossless either way
+    Quantize // always indexed, quantized when there are more than 256 colours
+};
+
+const char *pngPaletteName(PngPalette palette);
+
+// Parses "off", "exact" or "quantize"; false leaves palette as is
+bool parsePngPalette(const std::string &name, PngPalette &palette);
@@ -0,0 +1,490 @@
+#include "pixel_convert.h"
+#include "cpu_features.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+
+const uint32_t kOpaque = 0xff000000u;
+
+// Scalar kernels. Pixels are handled as little-endian 32-bit words: swapping
+// R and B is a rotate of the two outer bytes.
+
+inline uint32_t swapRedBlue(uint32_t v)
+{
+    return (v & 0xff00ff00u) | ((v >> 16) & 0xffu) | ((v & 0xffu) << 16);
+}
+
+void swizzle4Scalar(const unsigned char *src, unsigned char *dst, int pixelCount, uint32_t alpha)
+{
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        uint32_t v;
+        std::memcpy(&v, src + i * 4, 4);
+        v = swapRedBlue(v) | alpha;
+        std::memcpy(dst + i * 4, &v, 4);
+    }
+}
+
+void expand3Scalar(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    const int r = swap ? 2 : 0;
+    const int b = swap ? 0 : 2;
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        dst[i * 4 + 0] = src[i * 3 + r];
+        dst[i * 4 + 1] = src[i * 3 + 1];
+        dst[i * 4 + 2] = src[i * 3 + b];
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+void pack3Scalar(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    const int r = swap ? 2 : 0;
+    const int b = swap ? 0 : 2;
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        dst[i * 3 + 0] = src[i * 4 + r];
+        dst[i * 3 + 1] = src[i * 4 + 1];
+        dst[i * 3 + 2] = src[i * 4 + b];
+    }
+}
+
+void bgraToRgbaScalar(const unsigned char *src, unsigned char *dst, int n) { swizzle4Scalar(src, dst, n, 0); }
+void bgrxToRgbaScalar(const unsigned char *src, unsigned char *dst, int n) { swizzle4Scalar(src, dst, n, kOpaque); }
+void bgrToRgbaScalar(const unsigned char *src, unsigned char *dst, int n) { expand3Scalar(src, dst, n, true); }
+void rgbToRgbaScalar(const unsigned char *src, unsigned char *dst, int n) { expand3Scalar(src, dst, n, false); }
+void bgraToRgbScalar(const unsigned char *src, unsigned char *dst, int n) { pack3Scalar(src, dst, n, true); }
+void rgbaToRgbScalar(const unsigned char *src, unsigned char *dst, int n) { pack3Scalar(src, dst, n, false); }
+
+#if defined(SCREENSHOT_SIMD_X86)
+
+// SSSE3: 4 pixels per pshufb
+
+SIMD_TARGET("ssse3")
+void swizzle4Ssse3(const unsigned char *src, unsigned char *dst, int pixelCount, uint32_t alpha)
+{
+    const __m128i mask = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m128i alphaBits = _mm_set1_epi32(static_cast<int>(alpha));
+    int i = 0;
+    for (; i + 4 <= pixelCount; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, mask), alphaBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), v);
+    }
+    swizzle4Scalar(src + i * 4, dst + i * 4, pixelCount - i, alpha);
+}
+
+SIMD_TARGET("ssse3")
+void expand3Ssse3(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    const __m128i mask = swap ? _mm_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                              : _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m128i alphaBits = _mm_set1_epi32(static_cast<int>(kOpaque));
+    int i = 0;
+    // Each step reads 16 bytes but consumes 12, so stop while a full load fits
+    for (; i + 6 <= pixelCount; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3));
+        v = _mm_or_si128(_mm_shuffle_epi8(v, mask), alphaBits);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 4), v);
+    }
+    expand3Scalar(src + i * 3, dst + i * 4, pixelCount - i, swap);
+}
+
+SIMD_TARGET("ssse3")
+void pack3Ssse3(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    const __m128i mask = swap ? _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                              : _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    int i = 0;
+    // Each step stores 16 bytes but produces 12, so stop while a full store fits
+    for (; i + 6 <= pixelCount; i += 4)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i * 3), _mm_shuffle_epi8(v, mask));
+    }
+    pack3Scalar(src + i * 4, dst + i * 3, pixelCount - i, swap);
+}
+
+void bgraToRgbaSsse3(const unsigned char *src, unsigned char *dst, int n) { swizzle4Ssse3(src, dst, n, 0); }
+void bgrxToRgbaSsse3(const unsigned char *src, unsigned char *dst, int n) { swizzle4Ssse3(src, dst, n, kOpaque); }
+void bgrToRgbaSsse3(const unsigned char *src, unsigned char *dst, int n) { expand3Ssse3(src, dst, n, true); }
+void rgbToRgbaSsse3(const unsigned char *src, unsigned char *dst, int n) { expand3Ssse3(src, dst, n, false); }
+void bgraToRgbSsse3(const unsigned char *src, unsigned char *dst, int n) { pack3Ssse3(src, dst, n, true); }
+void rgbaToRgbSsse3(const unsigned char *src, unsigned char *dst, int n) { pack3Ssse3(src, dst, n, false); }
+
+// AVX2: 8 pixels per vpshufb (the shuffle works within each 128-bit lane)
+
+SIMD_TARGET("avx2")
+void swizzle4Avx2(const unsigned char *src, unsigned char *dst, int pixelCount, uint32_t alpha)
+{
+    const __m256i mask = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                          2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+    const __m256i alphaBits = _mm256_set1_epi32(static_cast<int>(alpha));
+    int i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4 + 32));
+        a = _mm256_or_si256(_mm256_shuffle_epi8(a, mask), alphaBits);
+        b = _mm256_or_si256(_mm256_shuffle_epi8(b, mask), alphaBits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), a);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4 + 32), b);
+    }
+    for (; i + 8 <= pixelCount; i += 8)
+    {
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+        a = _mm256_or_si256(_mm256_shuffle_epi8(a, mask), alphaBits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), a);
+    }
+    swizzle4Scalar(src + i * 4, dst + i * 4, pixelCount - i, alpha);
+}
+
+SIMD_TARGET("avx2")
+void expand3Avx2(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    const __m256i mask = swap ? _mm256_setr_epi8(2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1,
+                                                 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1)
+                              : _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    const __m256i alphaBits = _mm256_set1_epi32(static_cast<int>(kOpaque));
+    int i = 0;
+    // Two 12-byte groups, one per lane; the second load ends 4 bytes past them
+    for (; i + 10 <= pixelCount; i += 8)
+    {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 3 + 12));
+        __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+        v = _mm256_or_si256(_mm256_shuffle_epi8(v, mask), alphaBits);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), v);
+    }
+    expand3Scalar(src + i * 3, dst + i * 4, pixelCount - i, swap);
+}
+
+SIMD_TARGET("avx2")
+void pack3Avx2(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    const __m256i mask = swap ? _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                 2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1)
+                              : _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                                 0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    // Close the 4-byte gap between the two lanes' 12-byte groups
+    const __m256i compact = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+    int i = 0;
+    // 24 bytes produced per 32-byte store
+    for (; i + 11 <= pixelCount; i += 8)
+    {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i * 4));
+        v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, mask), compact);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 3), v);
+    }
+    pack3Scalar(src + i * 4, dst + i * 3, pixelCount - i, swap);
+}
+
+void bgraToRgbaAvx2(const unsigned char *src, unsigned char *dst, int n) { swizzle4Avx2(src, dst, n, 0); }
+void bgrxToRgbaAvx2(const unsigned char *src, unsigned char *dst, int n) { swizzle4Avx2(src, dst, n, kOpaque); }
+void bgrToRgbaAvx2(const unsigned char *src, unsigned char *dst, int n) { expand3Avx2(src, dst, n, true); }
+void rgbToRgbaAvx2(const unsigned char *src, unsigned char *dst, int n) { expand3Avx2(src, dst, n, false); }
+void bgraToRgbAvx2(const unsigned char *src, unsigned char *dst, int n) { pack3Avx2(src, dst, n, true); }
+void rgbaToRgbAvx2(const unsigned char *src, unsigned char *dst, int n) { pack3Avx2(src, dst, n, false); }
+
+// AVX-512BW: 16 pixels per vpshufb, masked loads/stores for the row tail
+
+SIMD_TARGET("avx512f,avx512bw")
+void swizzle4Avx512(const unsigned char *src, unsigned char *dst, int pixelCount, uint32_t alpha)
+{
+    const __m512i mask = _mm512_set4_epi32(0x0f0c0d0e, 0x0b08090a, 0x07040506, 0x03000102);
+    const __m512i alphaBits = _mm512_set1_epi32(static_cast<int>(alpha));
+    int i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        __m512i v = _mm512_loadu_si512(src + i * 4);
+        v = _mm512_or_si512(_mm512_shuffle_epi8(v, mask), alphaBits);
+        _mm512_storeu_si512(dst + i * 4, v);
+    }
+    if (i < pixelCount)
+    {
+        __mmask16 tail = static_cast<__mmask16>((1u << (pixelCount - i)) - 1);
+        __m512i v = _mm512_maskz_loadu_epi32(tail, src + i * 4);
+        v = _mm512_or_si512(_mm512_shuffle_epi8(v, mask), alphaBits);
+        _mm512_mask_storeu_epi32(dst + i * 4, tail, v);
+    }
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void expand3Avx512(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    // Same byte masks as the SSSE3 kernel, written as little-endian dwords
+    const __m512i mask = swap ? _mm512_set4_epi32(static_cast<int>(0xff090a0b), static_cast<int>(0xff060708), static_cast<int>(0xff030405), static_cast<int>(0xff000102))
+                              : _mm512_set4_epi32(static_cast<int>(0xff0b0a09), static_cast<int>(0xff080706), static_cast<int>(0xff050403), static_cast<int>(0xff020100));
+    const __m512i alphaBits = _mm512_set1_epi32(static_cast<int>(kOpaque));
+    int i = 0;
+    // Four 12-byte groups, one per 128-bit lane
+    for (; i + 18 <= pixelCount; i += 16)
+    {
+        const unsigned char *p = src + i * 3;
+        __m512i v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12)), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 24)), 2);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 36)), 3);
+        v = _mm512_or_si512(_mm512_shuffle_epi8(v, mask), alphaBits);
+        _mm512_storeu_si512(dst + i * 4, v);
+    }
+    expand3Scalar(src + i * 3, dst + i * 4, pixelCount - i, swap);
+}
+
+SIMD_TARGET("avx512f,avx512bw")
+void pack3Avx512(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    // Same byte masks as the SSSE3 kernel, written as little-endian dwords
+    const __m512i mask = swap ? _mm512_set4_epi32(-1, 0x0c0d0e08, 0x090a0405, 0x06000102)
+                              : _mm512_set4_epi32(-1, 0x0e0d0c0a, 0x09080605, 0x04020100);
+    const __m512i compact = _mm512_setr_epi32(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, 3, 7, 11, 15);
+    int i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        __m512i v = _mm512_loadu_si512(src + i * 4);
+        v = _mm512_maskz_permutexvar_epi32(0x0fff, compact, _mm512_shuffle_epi8(v, mask));
+        _mm512_mask_storeu_epi32(dst + i * 3, 0x0fff, v);
+    }
+    if (i < pixelCount)
+    {
+        int rest = pixelCount - i;
+        __m512i v = _mm512_maskz_loadu_epi32(static_cast<__mmask16>((1u << rest) - 1), src + i * 4);
+        v = _mm512_maskz_permutexvar_epi32(0x0fff, compact, _mm512_shuffle_epi8(v, mask));
+        _mm512_mask_storeu_epi8(dst + i * 3, (1ull << (rest * 3)) - 1, v);
+    }
+}
+
+void bgraToRgbaAvx512(const unsigned char *src, unsigned char *dst, int n) { swizzle4Avx512(src, dst, n, 0); }
+void bgrxToRgbaAvx512(const unsigned char *src, unsigned char *dst, int n) { swizzle4Avx512(src, dst, n, kOpaque); }
+void bgrToRgbaAvx512(const unsigned char *src, unsigned char *dst, int n) { expand3Avx512(src, dst, n, true); }
+void rgbToRgbaAvx512(const unsigned char *src, unsigned char *dst, int n) { expand3Avx512(src, dst, n, false); }
+void bgraToRgbAvx512(const unsigned char *src, unsigned char *dst, int n) { pack3Avx512(src, dst, n, true); }
+void rgbaToRgbAvx512(const unsigned char *src, unsigned char *dst, int n) { pack3Avx512(src, dst, n, false); }
+
+#elif defined(SCREENSHOT_SIMD_NEON)
+
+// NEON: de-interleaving loads make the swizzle a register rename
+
+void swizzle4Neon(const unsigned char *src, unsigned char *dst, int pixelCount, bool forceOpaque)
+{
+    const uint8x16_t opaque = vdupq_n_u8(255);
+    int i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x4_t v = vld4q_u8(src + i * 4);
+        uint8x16_t blue = v.val[0];
+        v.val[0] = v.val[2];
+        v.val[2] = blue;
+        if (forceOpaque)
+        {
+            v.val[3] = opaque;
+        }
+        vst4q_u8(dst + i * 4, v);
+    }
+    swizzle4Scalar(src + i * 4, dst + i * 4, pixelCount - i, forceOpaque ? kOpaque : 0);
+}
+
+void expand3Neon(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    int i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x3_t in = vld3q_u8(src + i * 3);
+        uint8x16x4_t out;
+        out.val[0] = swap ? in.val[2] : in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = swap ? in.val[0] : in.val[2];
+        out.val[3] = vdupq_n_u8(255);
+        vst4q_u8(dst + i * 4, out);
+    }
+    expand3Scalar(src + i * 3, dst + i * 4, pixelCount - i, swap);
+}
+
+void pack3Neon(const unsigned char *src, unsigned char *dst, int pixelCount, bool swap)
+{
+    int i = 0;
+    for (; i + 16 <= pixelCount; i += 16)
+    {
+        uint8x16x4_t in = vld4q_u8(src + i * 4);
+        uint8x16x3_t out;
+        out.val[0] = swap ? in.val[2] : in.val[0];
+        out.val[1] = in.val[1];
+        out.val[2] = swap ? in.val[0] : in.val[2];
+        vst3q_u8(dst + i * 3, out);
+    }
+    pack3Scalar(src + i * 4, dst + i * 3, pixelCount - i, swap);
+}
+
+void bgraToRgbaNeon(const unsigned char *src, unsigned char *dst, int n) { swizzle4Neon(src, dst, n, false); }
+void bgrxToRgbaNeon(const unsigned char *src, unsigned char *dst, int n) { swizzle4Neon(src, dst, n, true); }
+void bgrToRgbaNeon(const unsigned char *src, unsigned char *dst, int n) { expand3Neon(src, dst, n, true); }
+void rgbToRgbaNeon(const unsigned char *src, unsigned char *dst, int n) { expand3Neon(src, dst, n, false); }
+void bgraToRgbNeon(const unsigned char *src, unsigned char *dst, int n) { pack3Neon(src, dst, n, true); }
+void rgbaToRgbNeon(const unsigned char *src, unsigned char *dst, int n) { pack3Neon(src, dst, n, false); }
+
+#endif
+
+const PixelKernels kScalarKernels = {"scalar", bgraToRgbaScalar, bgrxToRgbaScalar, bgrToRgbaScalar, rgbToRgbaScalar, bgraToRgbScalar, rgbaToRgbScalar};
+#if defined(SCREENSHOT_SIMD_X86)
+const PixelKernels kSsse3Kernels = {"ssse3", bgraToRgbaSsse3, bgrxToRgbaSsse3, bgrToRgbaSsse3, rgbToRgbaSsse3, bgraToRgbSsse3, rgbaToRgbSsse3};
+const PixelKernels kAvx2Kernels = {"avx2", bgraToRgbaAvx2, bgrxToRgbaAvx2, bgrToRgbaAvx2, rgbToRgbaAvx2, bgraToRgbAvx2, rgbaToRgbAvx2};
+const PixelKernels kAvx512Kernels = {"avx512", bgraToRgbaAvx512, bgrxToRgbaAvx512, bgrToRgbaAvx512, rgbToRgbaAvx512, bgraToRgbAvx512, rgbaToRgbAvx512};
+#elif defined(SCREENSHOT_SIMD_NEON)
+const PixelKernels kNeonKernels = {"neon", bgraToRgbaNeon, bgrxToRgbaNeon, bgrToRgbaNeon, rgbToRgbaNeon, bgraToRgbNeon, rgbaToRgbNeon};
+#endif
+
+PixelKernels selectPixelKernels()
+{
+    // cpuFeatures() already applies the SCREENSHOT_SIMD cap
+    const CpuFeatures &features = cpuFeatures();
+#if defined(SCREENSHOT_SIMD_X86)
+    if (features.avx512bw)
+    {
+        return kAvx512Kernels;
+    }
+    if (features.avx2)
+    {
+        return kAvx2Kernels;
+    }
+    if (features.ssse3)
+    {
+        return kSsse3Kernels;
+    }
+#elif defined(SCREENSHOT_SIMD_NEON)
+    if (features.neon)
+    {
+        return kNeonKernels;
+    }
+#endif
+    return kScalarKernels;
+}
+
+// Resolved while the library loads so no capture ever pays for the cpuid
+const PixelKernels activeKernels = selectPixelKernels();
+
+} // namespace
+
+const PixelKernels &pixelKernels()
+{
+    return activeKernels;
+}
+
+std::vector<PixelKernels> supportedPixelKernels()
+{
+    std::vector<PixelKernels> kernels;
+    kernels.push_back(kScalarKernels);
+#if defined(SCREENSHOT_SIMD_X86)
+    CpuFeatures features = detectCpuFeatures();
+    if (features.ssse3)
+    {
+        kernels.push_back(kSsse3Kernels);
+    }
+    if (features.avx2)
+    {
+        kernels.push_back(kAvx2Kernels);
+    }
+    if (features.avx512bw)
+    {
+        kernels.push_back(kAvx512Kernels);
+    }
+#elif defined(SCREENSHOT_SIMD_NEON)
+    kernels.push_back(kNeonKernels);
+#endif
+    return kernels;
+}
+
+PixelRowConverter rowConverterToRGBA(PixelFormat format, const PixelKernels &kernels)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRA8:
+        return kernels.bgraToRgba;
+    case PixelFormat::BGRX8:
+        return kernels.bgrxToRgba;
+    case PixelFormat::BGR8:
+        return kernels.bgrToRgba;
+    case PixelFormat::RGB8:
+        return kernels.rgbToRgba;
+    case PixelFormat::RGBA8:
+        break;
+    }
+    return nullptr;
+}
+
+PixelFormat packedFormat(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGR8:
+        return PixelFormat::BGRX8;
+    case PixelFormat::RGB8:
+        return PixelFormat::RGBA8;
+    default:
+        return format;
+    }
+}
+
+PixelRowConverter rowConverter(PixelFormat from, PixelFormat to, const PixelKernels &kernels)
+{
+    if (to == PixelFormat::RGBA8)
+    {
+        return rowConverterToRGBA(from, kernels);
+    }
+    if (to == PixelFormat::RGB8)
+    {
+        switch (from)
+        {
+        case PixelFormat::BGRA8:
+        case PixelFormat::BGRX8:
+            return kernels.bgraToRgb;
+        case PixelFormat::RGBA8:
+            return kernels.rgbaToRgb;
+        default:
+            return nullptr;
+        }
+    }
+    // The RGB expander appends an opaque fourth byte without touching
+    // channel order, so it also widens BGR8 to BGRX8
+    if (from == PixelFormat::BGR8 && to == PixelFormat::BGRX8)
+    {
+        return kernels.rgbToRgba;
+    }
+    return nullptr;
+}
+
+bool canConvert(PixelFormat from, PixelFormat to)
+{
+    return from == to || rowConverter(from, to) != nullptr;
+}
+
+bool convertImage(const ImageView &src, PixelFormat dstFormat, unsigned char *dst, int dstStride)
+{
+    // The conversion is resolved once per image, never per pixel
+    if (!canConvert(src.format, dstFormat))
+    {
+        return false;
+    }
+    PixelRowConverter convert = rowConverter(src.format, dstFormat);
+    size_t rowBytes = static_cast<size_t>(src.width) * bytesPerPixel(dstFormat);
+
+    for (int y = 0; y < src.height; ++y)
+    {
+        unsigned char *out = dst + static_cast<size_t>(y) * dstStride;
+        if (convert)
+        {
+            convert(src.row(y), out, src.width);
+        }
+        else
+        {
+            std::memcpy(out, src.row(y), rowBytes);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "frame_source.h"
+#include "image.h"
+
+#include <vector>
+
+// Converts pixelCount pixels from src to tightly packed pixels in dst. For
+// the 4-byte to 4-byte conversions src and dst may be the same buffer.
+typedef void (*PixelRowConverter)(const unsigned char *src, unsigned char *dst, int pixelCount);
+
+// One implementation of every conversion, all built for the same instruction
+// set
+struct PixelKernels
+{
+    const char *isa;
+    PixelRowConverter bgraToRgba; // swap R and B, keep alpha
+    PixelRowConverter bgrxToRgba; // swap R and B, alpha forced to 255
+    PixelRowConverter bgrToRgba;  // 24bpp, swap R and B, alpha 255
+    PixelRowConverter rgbToRgba;  // 24bpp, alpha 255
+    PixelRowConverter bgraToRgb;  // drop the fourth byte, swap R and B
+    PixelRowConverter rgbaToRgb;  // drop the fourth byte
+};
+
+// The fastest kernel set this CPU supports, picked once via cpuid when the
+// library is loaded. SCREENSHOT_SIMD=scalar|ssse3|avx2|avx512 caps the choice.
+const PixelKernels &pixelKernels();
+
+// Every kernel set this CPU can run, scalar first (for benchmarks)
+std::vector<PixelKernels> supportedPixelKernels();
+
+// Row converter from format to RGBA, or nullptr when format is already RGBA8
+PixelRowConverter rowConverterToRGBA(PixelFormat format, const PixelKernels &kernels = pixelKernels());
+
+// Row converter between two formats: anything to RGBA8, 4-byte formats to
+// RGB8 (opaque output) and BGR8 to BGRX8. nullptr when from == to (a plain
+// copy) or when the pair is unsupported; canConvert() tells the two apart.
+PixelRowConverter rowConverter(PixelFormat from, PixelFormat to, const PixelKernels &kernels = pixelKernels());
+bool canConvert(PixelFormat from, PixelFormat to);
+
+// The 4-byte format a format widens to without reordering channels: BGR8
+// becomes BGRX8, RGB8 becomes RGBA8, 4-byte formats stay as they are
+PixelFormat packedFormat(PixelFormat format);
+
+// Convert a view into dst, dstStride bytes per row; false if canConvert()
+// rejects the pair
+bool convertImage(const ImageView &src, PixelFormat dstFormat, unsigned char *dst, int dstStride);
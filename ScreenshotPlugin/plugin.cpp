@@ -1,31 +1,22 @@
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include "base64.h"
+#include "frame_source.h"
+#include "image_pipeline.h"
 
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 
-#if defined(_WIN32)
-#include <windows.h>
-#elif defined(__APPLE__)
-#include <ApplicationServices/ApplicationServices.h>
-#endif
-
 #include <iostream>
 #include <string>
+#include <cstdint>
 #include <ctime>
 #include <vector>
-#include <utility> // For std::pair
 #include <memory>
-#include <cstring> // for memcpy
+#include <mutex>
 
 // for hosting
 
 #include <fstream>
 
-// for base64 encoding
-#include <sstream>
-#include <iomanip>
-
 // Utility function to get the current time as a string
 std::string getCurrentTime()
 {
@@ -35,248 +26,6 @@ std::string getCurrentTime()
     return std::string(buf);
 }
 
-// Utility function to save an image as a PNG file
-void saveImage(const std::string &filename, int width, int height, unsigned char *data)
-{
-    if (!stbi_write_png(filename.c_str(), width, height, 4, data, width * 4))
-    {
-        std::cerr << "Failed to save image to " << filename << std::endl;
-    }
-    else
-    {
-        std::cout << "Image saved to " << filename << std::endl;
-    }
-}
-
-void printImages(const std::vector<std::pair<int, unsigned char *>> &images)
-{
-    for (const auto &imagePair : images)
-    {
-        int width = imagePair.first;                 // Assuming the first element is width
-        unsigned char *imageData = imagePair.second; // Pointer to image data
-
-        std::cout << "Image Width: " << width
-                  << ", Data Pointer: " << static_cast<void *>(imageData) << std::endl;
-
-        // If you want to print the first few bytes of the image data
-        std::cout << "First 10 bytes of image data: ";
-        for (int i = 0; i < 10 && imageData[i]; ++i)
-        {
-            std::cout << static_cast<int>(imageData[i]) << " ";
-        }
-        std::cout << std::endl;
-    }
-}
-
-#include <memory>
-#include <cstring> // For memcpy
-
-// Helper function to downscale an image
-unsigned char* downscaleImage(unsigned char* data, int originalWidth, int originalHeight, int newWidth, int newHeight) {
-    std::unique_ptr<unsigned char[]> resizedData(new unsigned char[newWidth * newHeight * 4]);
-    float xRatio = static_cast<float>(originalWidth) / newWidth;
-    float yRatio = static_cast<float>(originalHeight) / newHeight;
-
-    for (int y = 0; y < newHeight; ++y) {
-        for (int x = 0; x < newWidth; ++x) {
-            int srcX = static_cast<int>(x * xRatio);
-            int srcY = static_cast<int>(y * yRatio);
-            std::memcpy(&resizedData[(y * newWidth + x) * 4],
-                        &data[(srcY * originalWidth + srcX) * 4],
-                        4); // Copy RGBA pixel
-        }
-    }
-    return resizedData.release();
-}
-
-// Combine images and compress the output
-void combineImages(const std::vector<std::pair<int, unsigned char*>>& images, const std::vector<int>& heights, const std::string& outputFilePath) {
-    if (images.empty()) {
-        std::cerr << "No images to combine.\n";
-        return;
-    }
-
-    // Calculate total width and max height
-    int totalWidth = 0;
-    int maxHeight = 0;
-    std::vector<int> scaledHeights;
-    std::vector<int> scaledWidths;
-    std::vector<std::unique_ptr<unsigned char[]>> scaledImages;
-
-    const int targetWidth = 800; // Adjust to your needs
-    const int targetHeight = 800;
-
-    for (size_t i = 0; i < images.size(); ++i) {
-        int originalWidth = images[i].first;
-        int originalHeight = heights[i];
-
-        // Compute new dimensions maintaining aspect ratio
-        float scale = std::min(static_cast<float>(targetWidth) / originalWidth, static_cast<float>(targetHeight) / originalHeight);
-        int newWidth = static_cast<int>(originalWidth * scale);
-        int newHeight = static_cast<int>(originalHeight * scale);
-
-        scaledWidths.push_back(newWidth);
-        scaledHeights.push_back(newHeight);
-
-        // Downscale image
-        scaledImages.emplace_back(downscaleImage(images[i].second, originalWidth, originalHeight, newWidth, newHeight));
-
-        totalWidth += newWidth;
-        maxHeight = std::max(maxHeight, newHeight);
-    }
-
-    // Allocate memory for the combined image
-    std::unique_ptr<unsigned char[]> combinedData(new unsigned char[totalWidth * maxHeight * 4]());
-
-    // Copy scaled images into the combined image
-    int offsetX = 0;
-    for (size_t i = 0; i < scaledImages.size(); ++i) {
-        int width = scaledWidths[i];
-        int height = scaledHeights[i];
-        unsigned char* data = scaledImages[i].get();
-        for (int y = 0; y < height; ++y) {
-            std::memcpy(combinedData.get() + (y * totalWidth + offsetX) * 4,
-                        data + (y * width) * 4, width * 4);
-        }
-        offsetX += width;
-    }
-
-    // Save the combined image as a compressed format (e.g., JPEG or WebP)
-    int quality = 90; // Adjust the quality (1-100)
-    if (stbi_write_jpg(outputFilePath.c_str(), totalWidth, maxHeight, 4, combinedData.get(), quality)) {
-        std::cout << "Image saved successfully as: " << outputFilePath << "\n";
-    } else {
-        std::cerr << "Failed to save the image.\n";
-    }
-}
-
-// Function to arrange images in a Picture-in-Picture (PIP) layout
-void pipImages(const std::vector<std::pair<int, unsigned char *>> &images, const std::vector<int> &heights, const std::string &outputFilePath)
-{
-    if (images.empty())
-        return;
-
-    const int mainIndex = 0;
-    int mainWidth = images[mainIndex].first;
-    int mainHeight = heights[mainIndex];
-
-    int pipWidth = mainWidth / 3.2;
-    int pipHeight = mainHeight / 3.2;
-
-    // Calculate the total width and height needed for the final image
-    int totalWidth = mainWidth;
-    int totalHeight = mainHeight;
-
-    // Create a new image data array to hold the final PIP layout
-    std::unique_ptr<unsigned char[]> combinedData(new unsigned char[totalWidth * totalHeight * 4]());
-
-    // Copy the main display image into the final image data
-    std::memcpy(combinedData.get(), images[mainIndex].second, mainWidth * mainHeight * 4);
-
-    // Calculate positions and copy PIP images into the final image
-    int offsetX = mainWidth - pipWidth - 20;   // 10 pixels margin from the right edge
-    int offsetY = mainHeight - pipHeight - 20; // 10 pixels margin from the bottom edge
-
-    for (size_t i = 1; i < images.size(); ++i)
-    {
-        unsigned char *pipData = images[i].second;
-
-        // Resize the PIP image to fit the 4:1 ratio size
-        for (int y = 0; y < pipHeight; ++y)
-        {
-            for (int x = 0; x < pipWidth; ++x)
-            {
-                int pipX = x * images[i].first / pipWidth;
-                int pipY = y * heights[i] / pipHeight;
-
-                int srcIndex = (pipY * images[i].first + pipX) * 4;
-                int dstIndex = ((y + offsetY) * totalWidth + (x + offsetX)) * 4;
-
-                std::memcpy(&combinedData[dstIndex], &pipData[srcIndex], 4);
-            }
-        }
-
-        // Update the position for the next PIP display (if any)
-        offsetY -= pipHeight + 15;
-    }
-
-    // Save the final image
-    saveImage(outputFilePath, totalWidth, totalHeight, combinedData.get());
-}
-
-// encode the image
-
-static const std::string base64_chars =
-    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-    "abcdefghijklmnopqrstuvwxyz"
-    "0123456789+/";
-
-std::string base64_encode(unsigned char const *bytes_to_encode, unsigned int in_len)
-{
-    std::string ret;
-    int i = 0;
-    int j = 0;
-    unsigned char char_array_3[3];
-    unsigned char char_array_4[4];
-
-    while (in_len--)
-    {
-        char_array_3[i++] = *(bytes_to_encode++);
-        if (i == 3)
-        {
-            char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-            char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-            char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-            char_array_4[3] = char_array_3[2] & 0x3f;
-
-            for (i = 0; i < 4; i++)
-                ret += base64_chars[char_array_4[i]];
-            i = 0;
-        }
-    }
-
-    if (i)
-    {
-        for (j = i; j < 3; j++)
-            char_array_3[j] = '\0';
-
-        char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-        char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-        char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-        char_array_4[3] = char_array_3[2] & 0x3f;
-
-        for (j = 0; j < i + 1; j++)
-            ret += base64_chars[char_array_4[j]];
-
-        while (i++ < 3)
-            ret += '=';
-    }
-
-    return ret;
-}
-
-// Function to encode the image file as a Base64 string
-std::string base64encode(const std::string &filePath)
-{
-    // Open the file in binary mode
-    std::cout << "Base64encoding entered....\n";
-    std::ifstream imageFile(filePath, std::ios::binary);
-    std::cout << "image is taken into stream";
-
-    if (!imageFile.is_open())
-    {
-        std::cout << "Could not open file for reading.\n";
-    }
-
-    std::cout << "Going to read img..\n";
-    // Read the contents of the file
-    std::vector<unsigned char> imageData((std::istreambuf_iterator<char>(imageFile)), std::istreambuf_iterator<char>());
-    std::cout << "Image read...\n";
-    std::cout << "Base64rncoding....\n";
-    // Encode the image data to Base64
-    return base64_encode(imageData.data(), imageData.size());
-}
-
 using json = nlohmann::json;
 
 // Callback function to capture response data
@@ -287,7 +36,7 @@ static size_t WriteCallback(void *contents, size_t size, size_t nmemb, void *use
 }
 
 // Function to upload image data to API and receive response
-std::string uploadImageToAPI(const std::string &apiUrl, const std::string &imageKey, const std::string &base64Image)
+std::string uploadImageToAPI(const std::string &apiUrl, const std::string &imageKey, const std::string &base64Image, const std::string &contentType)
 {
     CURL *curl;
     CURLcode res;
@@ -297,7 +46,7 @@ std::string uploadImageToAPI(const std::string &apiUrl, const std::string &image
     curl = curl_easy_init();
     if (curl)
     {
-        std::string jsonPayload = "{\"contentType\":\"image/png\", \"imageDataAsBase64String\":\"" + base64Image + "\", \"key\":\"" + imageKey + "\"}";
+        std::string jsonPayload = "{\"contentType\":\"" + contentType + "\", \"imageDataAsBase64String\":\"" + base64Image + "\", \"key\":\"" + imageKey + "\"}";
 
         std::ofstream outFile("request.json");
         if (outFile.is_open())
@@ -413,249 +162,219 @@ void postImageToIfttt(std::string imageUrl)
 }
 
 
-#if defined(_WIN32)
-// Convert BGRA to RGBA
-void convertBGRAToRGBA(unsigned char *data, int width, int height)
+// config[key] if it is at least minimum, else value (with a warning)
+static int layoutValue(const json &config, const char *key, int value, int minimum)
 {
-    for (int i = 0; i < width * height; ++i)
+    int parsed = config.value(key, value);
+    if (parsed < minimum)
     {
-        std::swap(data[i * 4], data[i * 4 + 2]); // Swap red and blue
+        std::cerr << "Layout " << key << " " << parsed << " is below " << minimum << ", using " << value << std::endl;
+        return value;
     }
+    return parsed;
 }
 
-// // Capture a screenshot of a monitor and return the image data
-// std::pair<int, unsigned char*> captureScreenshot(HMONITOR hMonitor, int& height) {
-//     MONITORINFO mi;
-//     mi.cbSize = sizeof(MONITORINFO);
-//     GetMonitorInfo(hMonitor, &mi);
-//     int width = mi.rcMonitor.right - mi.rcMonitor.left;
-//     height = mi.rcMonitor.bottom - mi.rcMonitor.top;
-
-//     HDC hScreen = GetDC(NULL);
-//     HDC hDC = CreateCompatibleDC(hScreen);
-//     HBITMAP hBitmap = CreateCompatibleBitmap(hScreen, width, height);
-//     SelectObject(hDC, hBitmap);
-//     BitBlt(hDC, 0, 0, width, height, hScreen, mi.rcMonitor.left, mi.rcMonitor.top, SRCCOPY);
-//     ReleaseDC(NULL, hScreen);
-
-//     BITMAPINFOHEADER bi = { sizeof(BITMAPINFOHEADER), width, -height, 1, 32, BI_RGB, 0, 0, 0, 0, 0 };
-//     unsigned char* data = new unsigned char[width * height * 4];
-//     GetDIBits(hDC, hBitmap, 0, height, data, (BITMAPINFO*)&bi, DIB_RGB_COLORS);
-
-//     DeleteObject(hBitmap);
-//     DeleteDC(hDC);
-
-//     // Convert BGRA to RGBA
-//     convertBGRAToRGBA(data, width, height);
-
-//     return std::make_pair(width, data);
-//
-
-void captureScreenshotForMonitor(HDC hScreenDC, int width, int height, unsigned char* imgData, std::vector<std::pair<int, unsigned char *>>& images, std::vector<int>& heights)
+// Parse a "layout" object, e.g. {"kind": "grid", "columns": 2, "gap": 8} or
+// {"kind": "custom", "canvasWidth": 1920, "canvasHeight": 1080, "rects": [[0, 0, 1280, 1080], [1280, 0, 640, 360]]};
+// the other keys are the LayoutSpec fields of the same name
+static void parseLayoutSpec(const json &config, LayoutSpec &spec)
 {
-    HBITMAP hBitmap = CreateCompatibleBitmap(hScreenDC, width, height);
-    if (hBitmap == NULL) {
-        std::cerr << "Failed to create bitmap" << std::endl;
-        return;
+    if (config.contains("kind") && !parseLayoutKind(config["kind"].get<std::string>(), spec.kind))
+    {
+        std::cerr << "Unknown layout " << config["kind"] << ", using " << layoutKindName(spec.kind) << std::endl;
     }
-
-    HDC hMemoryDC = CreateCompatibleDC(hScreenDC);
-    SelectObject(hMemoryDC, hBitmap);
-
-    // Capture screen into the bitmap
-    if (!BitBlt(hMemoryDC, 0, 0, width, height, hScreenDC, 0, 0, SRCCOPY)) {
-        std::cerr << "Failed to copy screen to bitmap" << std::endl;
-        DeleteObject(hBitmap);
-        DeleteDC(hMemoryDC);
-        return;
+    spec.cellWidth = layoutValue(config, "cellWidth", spec.cellWidth, 1);
+    spec.cellHeight = layoutValue(config, "cellHeight", spec.cellHeight, 1);
+    spec.gap = layoutValue(config, "gap", spec.gap, 0);
+    spec.columns = layoutValue(config, "columns", spec.columns, 0);
+    double insetScale = config.value("insetScale", spec.insetScale);
+    if (insetScale > 0 && insetScale <= 1)
+    {
+        spec.insetScale = insetScale;
     }
-
-    BITMAP bmp;
-    GetObject(hBitmap, sizeof(BITMAP), &bmp);
-    unsigned char* pixels = new unsigned char[bmp.bmWidthBytes * bmp.bmHeight];
-    GetBitmapBits(hBitmap, bmp.bmWidthBytes * bmp.bmHeight, pixels);
-
-    // Prepare image data in RGBA format
-    imgData = new unsigned char[width * height * 4]; // Allocate memory for the image data
-    for (int y = 0; y < height; ++y) {
-        for (int x = 0; x < width; ++x) {
-            int pixelIndex = y * bmp.bmWidthBytes + x * (bmp.bmBitsPixel / 8);
-            int imgIndex = y * width + x;
-
-            if (bmp.bmBitsPixel == 32) {
-                imgData[imgIndex * 4 + 0] = pixels[pixelIndex + 2]; // Red
-                imgData[imgIndex * 4 + 1] = pixels[pixelIndex + 1]; // Green
-                imgData[imgIndex * 4 + 2] = pixels[pixelIndex + 0]; // Blue
-                imgData[imgIndex * 4 + 3] = pixels[pixelIndex + 3]; // Alpha
-            } else {
-                imgData[imgIndex * 4 + 0] = pixels[pixelIndex + 2]; // Red
-                imgData[imgIndex * 4 + 1] = pixels[pixelIndex + 1]; // Green
-                imgData[imgIndex * 4 + 2] = pixels[pixelIndex + 0]; // Blue
-                imgData[imgIndex * 4 + 3] = 255; // Fully opaque alpha
-            }
+    else
+    {
+        std::cerr << "Layout insetScale " << insetScale << " is outside (0, 1], using " << spec.insetScale << std::endl;
+    }
+    spec.margin = layoutValue(config, "margin", spec.margin, 0);
+    spec.insetGap = layoutValue(config, "insetGap", spec.insetGap, 0);
+    spec.maxInsets = layoutValue(config, "maxInsets", spec.maxInsets, -1);
+    spec.canvasWidth = layoutValue(config, "canvasWidth", spec.canvasWidth, 0);
+    spec.canvasHeight = layoutValue(config, "canvasHeight", spec.canvasHeight, 0);
+    if (config.contains("rects"))
+    {
+        for (const json &rect : config["rects"])
+        {
+            spec.rects.push_back(LayoutRect(rect.at(0).get<int>(), rect.at(1).get<int>(), rect.at(2).get<int>(), rect.at(3).get<int>()));
         }
     }
-
-    // Store the captured data in the images vector
-    images.push_back({width, imgData});
-    heights.push_back(height);
-
-    // Cleanup
-    delete[] pixels;
-    DeleteObject(hBitmap);
-    DeleteDC(hMemoryDC);
 }
-void captureScreenshot(const std::string &outputFilePath,bool isPip)
-{
-    // Create vectors to store image data and heights for all monitors
-    std::vector<std::pair<int, unsigned char *>> images;
-    std::vector<int> heights;
-
-    // EnumDisplayDevices to get all connected monitors
-    DISPLAY_DEVICE dd;
-    memset(&dd, 0, sizeof(dd));
-    dd.cb = sizeof(dd);
-
-    int monitorIndex = 0;
-
-    while (EnumDisplayDevices(NULL, monitorIndex, &dd, 0)) {
-        // Get the device context of the monitor
-        HDC hScreenDC = CreateDC(dd.DeviceName, NULL, NULL, NULL);
-        if (hScreenDC == NULL) {
-            std::cerr << "Failed to get monitor DC for monitor " << monitorIndex << std::endl;
-            monitorIndex++;
-            continue;
-        }
 
-        // Get the monitor's width and height
-        DEVMODE devMode;
-        memset(&devMode, 0, sizeof(devMode));
-        devMode.dmSize = sizeof(devMode);
-        if (EnumDisplaySettings(dd.DeviceName, ENUM_CURRENT_SETTINGS, &devMode)) {
-            int width = devMode.dmPelsWidth;
-            int height = devMode.dmPelsHeight;
-
-            // Capture screenshot for this monitor
-            unsigned char* imgData = nullptr; // Pass nullptr initially
-            captureScreenshotForMonitor(hScreenDC, width, height, imgData, images, heights);
-        }
-
-        // Release the device context
-        DeleteDC(hScreenDC);
-        monitorIndex++;
+// Parse a "jpeg" object, e.g. {"quality": 85, "subsampling": "444", "optimizeHuffman": false, "backend": "stb"}
+static void parseJpegOptions(const json &config, JpegOptions &jpeg)
+{
+    jpeg.quality = config.value("quality", jpeg.quality);
+    if (config.contains("subsampling") && !parseJpegSubsampling(config["subsampling"].get<std::string>(), jpeg.subsampling))
+    {
+        std::cerr << "Unknown subsampling " << config["subsampling"] << ", using " << jpegSubsamplingName(jpeg.subsampling) << std::endl;
     }
-
-    // After collecting all monitor images, call pipImages
-    if (!images.empty()) {
-
-       isPip?pipImages(images, heights, outputFilePath):combineImages(images, heights, outputFilePath);
-    } else {
-        std::cerr << "No monitors found or screenshots were not captured." << std::endl;
+    jpeg.optimizeHuffman = config.value("optimizeHuffman", jpeg.optimizeHuffman);
+    jpeg.restartSegments = config.value("restartSegments", jpeg.restartSegments);
+    if (config.contains("backend") && !parseJpegBackend(config["backend"].get<std::string>(), jpeg.backend))
+    {
+        std::cerr << "Unknown JPEG backend " << config["backend"] << ", using " << jpegBackendName(jpeg.backend) << std::endl;
     }
 }
 
+// Parse a "webp" object, e.g. {"lossless": false, "quality": 80, "method": 4}
+static void parseWebpOptions(const json &config, WebpOptions &webp)
+{
+    webp.lossless = config.value("lossless", webp.lossless);
+    webp.quality = config.value("quality", webp.quality);
+    webp.method = config.value("method", webp.method);
+}
 
-// Monitor enumeration callback to capture screenshots from all monitors
-// BOOL CALLBACK MonitorEnumProc(HMONITOR hMonitor, HDC hdcMonitor, LPRECT lprcMonitor, LPARAM dwData) {
-//     std::vector<std::pair<int, unsigned char*>>& images = *reinterpret_cast<std::vector<std::pair<int, unsigned char*>>*>(dwData);
-//     std::vector<int>& heights = *reinterpret_cast<std::vector<int>*>(dwData + sizeof(std::vector<std::pair<int, unsigned char*>>));
-
-//     std::cout<<"Screenshots captured\n";
-//     int height;
-//     images.push_back(captureScreenshot(hMonitor, height));
-//     heights.push_back(height);
-//     return TRUE;
-// }
-
-#elif defined(__APPLE__)
-#include <CoreGraphics/CoreGraphics.h>
-// Convert BGRA to RGBA
-void convertBGRAToRGBA(unsigned char *data, int width, int height)
+// Parse the JSON options accepted by CaptureScreenshotWithOptions, e.g.
+// {"opaque": false, "filter": "lanczos3", "threads": 4, "layout": {"kind": "grid"}, "saveFile": false,
+// "pngLevel": 3, "pngPalette": "exact", "format": "webp", "maxBytes": 500000, "jpeg": {"quality": 85}, "webp": {"lossless": true}}. Unknown keys are ignored; a malformed string leaves the defaults in place.
+static CaptureOptions parseCaptureOptions(const char *optionsJson)
 {
-    for (int i = 0; i < width * height; ++i)
+    CaptureOptions options;
+    if (!optionsJson || !*optionsJson)
     {
-        std::swap(data[i * 4], data[i * 4 + 2]); // Swap red and blue
+        return options;
     }
-}
 
-// Capture a screenshot of a display and return the image data
-std::pair<int, unsigned char *> captureScreenshot(CGDirectDisplayID displayId, int &height)
-{
-    CGImageRef screenshot = CGDisplayCreateImage(displayId);
-    int width = static_cast<int>(CGImageGetWidth(screenshot));
-    height = static_cast<int>(CGImageGetHeight(screenshot));
+    try
+    {
+        json config = json::parse(optionsJson);
+        if (config.contains("opaque"))
+        {
+            options.opaque = config["opaque"].get<bool>();
+        }
+        if (config.contains("filter") && !parseResampleFilter(config["filter"].get<std::string>(), options.filter))
+        {
+            std::cerr << "Unknown filter " << config["filter"] << ", using " << resampleFilterName(options.filter) << std::endl;
+        }
+        if (config.contains("threads"))
+        {
+            options.threads = config["threads"].get<int>();
+        }
+        if (config.contains("layout"))
+        {
+            parseLayoutSpec(config["layout"], options.layout);
+        }
+        if (config.contains("saveFile"))
+        {
+            options.saveFile = config["saveFile"].get<bool>();
+        }
+        if (config.contains("pngLevel"))
+        {
+            options.pngLevel = config["pngLevel"].get<int>();
+        }
+        if (config.contains("pngPalette") && !parsePngPalette(config["pngPalette"].get<std::string>(), options.pngPalette))
+        {
+            std::cerr << "Unknown pngPalette " << config["pngPalette"] << ", using " << pngPaletteName(options.pngPalette) << std::endl;
+        }
+        if (config.contains("format") && !parseImageFormat(config["format"].get<std::string>(), options.format))
+        {
+            std::cerr << "Unknown format " << config["format"] << ", using " << imageFormatName(options.format) << std::endl;
+        }
+        if (config.contains("maxBytes"))
+        {
+            int64_t maxBytes = config["maxBytes"].get<int64_t>();
+            if (maxBytes < 0)
+            {
+                std::cerr << "Negative maxBytes " << maxBytes << ", using " << options.maxBytes << std::endl;
+            }
+            else
+            {
+                options.maxBytes = static_cast<size_t>(maxBytes);
+            }
+        }
+        if (config.contains("jpeg"))
+        {
+            parseJpegOptions(config["jpeg"], options.jpeg);
+        }
+        if (config.contains("webp"))
+        {
+            parseWebpOptions(config["webp"], options.webp);
+        }
+    }
+    catch (const json::exception &e)
+    {
+        std::cerr << "Ignoring capture options: " << e.what() << std::endl;
+    }
+    return options;
+}
 
-    CFDataRef dataRef = CGDataProviderCopyData(CGImageGetDataProvider(screenshot));
-    const UInt8 *data = CFDataGetBytePtr(dataRef);
+// The capture source is kept across captures, so per-output state such as
+// X11's shared-memory segments is set up once rather than on every capture.
+// Its frames are only valid until the next capture, so captures take turns.
+static std::mutex sourceMutex;
+static std::unique_ptr<FrameSource> source;
 
-    unsigned char *imgData = new unsigned char[width * height * 4];
-    std::memcpy(imgData, data, width * height * 4);
+static void captureAndUpload(const char *baseFilename, bool isPip, const CaptureOptions &options)
+{
+    std::string baseFilepath(baseFilename);
 
-    CFRelease(dataRef);
-    CGImageRelease(screenshot);
+    EncodedImage encoded;
+    {
+        std::lock_guard<std::mutex> lock(sourceMutex);
+        if (!source)
+        {
+            source = createFrameSource();
+        }
+        if (!source)
+        {
+            std::cerr << "Capture failed: no screen to capture from" << std::endl;
+            return;
+        }
+        if (!captureScreenshot(*source, isPip, encoded, options))
+        {
+            return;
+        }
+    }
+    std::cout << "\nImages captured";
+    std::string outputFilePath = baseFilepath + "_output." + imageFormatExtension(encoded.format);
+
+    // The upload works from memory; the file on disk is a side output
+    std::shared_ptr<const std::vector<unsigned char>> bytes = std::make_shared<std::vector<unsigned char>>(std::move(encoded.bytes));
+    // Written while the upload runs, and waited for before returning (the
+    // future's destructor at the latest), so no write outlives the call
+    std::future<bool> saved;
+    if (options.saveFile)
+    {
+        saved = writeFileAsync(outputFilePath, bytes);
+    }
+    std::string base64Image = base64_encode(bytes->data(), static_cast<unsigned int>(bytes->size()));
 
-    convertBGRAToRGBA(imgData, width, height);
+    std::cout << "\nImages base64 encoded";
+    std::string imageKey = "/IFFTImages/" + baseFilepath;
+    std::string apiUrl = "https://svcs-dev02.myharmony.com/UserAccountDirectorPlatform/UserAccountDirector.svc/json2/UploadFileToS3Bucket";
+    std::cout << "\napi to be hit";
+    std::string imageUrl = uploadImageToAPI(apiUrl, imageKey, base64Image, imageFormatMimeType(encoded.format));
 
-    return std::make_pair(width, imgData);
+    postImageToIfttt(imageUrl);
+    std::cout << "\nposted to ifttt";
+    if (saved.valid())
+    {
+        saved.wait();
+    }
 }
-#endif
 
 extern "C"
 {
     // Capture screenshots from all monitors and combine them into a single image
     void CaptureScreenshot(const char *baseFilename,bool isPip)
     {
-        std::string baseFilepath(baseFilename);
-        std::vector<std::pair<int, unsigned char *>> images;
-        std::vector<int> heights;
-
-        // std::cout << "Enter Type of Image\n1.Collage\n2.PIP: ";
-        // int option;
-        // std::cin >> option;
-
-        // std::cout<<"Accumulating monitors\n";
-        // #if defined(_WIN32)
-        // EnumDisplayMonitors(NULL, NULL, MonitorEnumProc, reinterpret_cast<LPARAM>(&images));
-        // #elif defined(__APPLE__)
-        // uint32_t displayCount;
-        // CGGetActiveDisplayList(0, NULL, &displayCount);
-        // CGDirectDisplayID displays[displayCount];
-        // CGGetActiveDisplayList(displayCount, displays, &displayCount);
-
-        // for (uint32_t i = 0; i < displayCount; ++i) {
-        //     int height;
-        //     images.push_back(captureScreenshot(displays[i], height));
-        //     heights.push_back(height);
-        // }
-        // #else
-        // std::cerr << "Unsupported platform." << std::endl;
-        // return;
-        // #endif
-
-        std::string outputFilePath = baseFilepath + "_output.png";
-
-        // if (option == 1)
-        //     combineImages(images, heights, outputFilePath);
-        // else if (option == 2)
-        //     pipImages(images, heights, outputFilePath);
-
-        captureScreenshot(outputFilePath,isPip);
-        std::cout << "\nImages captured";
-        std::string base64Image = base64encode(outputFilePath);
-
-        std::cout << "\nImages base64 encoded";
-        std::string imageKey = "/IFFTImages/" + baseFilepath;
-        std::string apiUrl = "https://svcs-dev02.myharmony.com/UserAccountDirectorPlatform/UserAccountDirector.svc/json2/UploadFileToS3Bucket";
-        std::cout << "\napi to be hit";
-        std::string imageUrl = uploadImageToAPI(apiUrl, imageKey, base64Image);
-
-        postImageToIfttt(imageUrl);
-        std::cout << "\nposted to ifttt";
+        captureAndUpload(baseFilename, isPip, CaptureOptions());
+    }
 
-        // Cleanup
-        for (auto &image : images)
-        {
-            delete[] image.second;
-        }
+    // Same as CaptureScreenshot, with per-capture settings given as a JSON
+    // object (see parseCaptureOptions); nullptr or "" means the defaults
+    void CaptureScreenshotWithOptions(const char *baseFilename, bool isPip, const char *optionsJson)
+    {
+        captureAndUpload(baseFilename, isPip, parseCaptureOptions(optionsJson));
     }
 }
\ No newline at end of file
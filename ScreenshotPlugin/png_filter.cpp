@@ -0,0 +1,373 @@
+#include "png_filter.h"
+#include "cpu_features.h"
+
+#include <cstdint>
+#include <cstdlib>
+
+namespace
+{
+
+const int kFilterTypes = 5;
+
+// Scalar kernels. The first bpp bytes of a row have no left neighbour: a and
+// c read as 0 there.
+
+inline unsigned char paeth(int a, int b, int c)
+{
+    int p = a + b - c, pa = std::abs(p - a), pb = std::abs(p - b), pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return static_cast<unsigned char>(a);
+    if (pb <= pc)
+        return static_cast<unsigned char>(b);
+    return static_cast<unsigned char>(c);
+}
+
+inline unsigned char residual(const unsigned char *row, const unsigned char *prev, int i, int bpp, int type)
+{
+    const int a = i >= bpp ? row[i - bpp] : 0;
+    const int b = prev[i];
+    const int c = i >= bpp ? prev[i - bpp] : 0;
+    switch (type)
+    {
+    case 1:
+        return static_cast<unsigned char>(row[i] - a);
+    case 2:
+        return static_cast<unsigned char>(row[i] - b);
+    case 3:
+        return static_cast<unsigned char>(row[i] - ((a + b) >> 1));
+    case 4:
+        return static_cast<unsigned char>(row[i] - paeth(a, b, c));
+    }
+    return row[i];
+}
+
+// Adds the magnitudes of bytes [first, last) of every filter's residuals to
+// costs
+void addCostsScalar(const unsigned char *row, const unsigned char *prev, int first, int last, int bpp, uint64_t costs[kFilterTypes])
+{
+    for (int i = first; i < last; ++i)
+    {
+        for (int type = 0; type < kFilterTypes; ++type)
+        {
+            costs[type] += std::abs(static_cast<signed char>(residual(row, prev, i, bpp, type)));
+        }
+    }
+}
+
+void applyScalar(const unsigned char *row, const unsigned char *prev, int first, int last, int bpp, int type, unsigned char *out)
+{
+    for (int i = first; i < last; ++i)
+    {
+        out[i] = residual(row, prev, i, bpp, type);
+    }
+}
+
+int cheapestFilter(const uint64_t costs[kFilterTypes])
+{
+    int best = 0;
+    for (int type = 1; type < kFilterTypes; ++type)
+    {
+        if (costs[type] < costs[best])
+        {
+            best = type;
+        }
+    }
+    return best;
+}
+
+// Residual of filter Type for a byte with a left neighbour (i >= bpp)
+template <int Type>
+inline unsigned char bodyResidual(const unsigned char *row, const unsigned char *prev, int i, int bpp)
+{
+    switch (Type)
+    {
+    case 1:
+        return static_cast<unsigned char>(row[i] - row[i - bpp]);
+    case 2:
+        return static_cast<unsigned char>(row[i] - prev[i]);
+    case 3:
+        return static_cast<unsigned char>(row[i] - ((row[i - bpp] + prev[i]) >> 1));
+    case 4:
+        return static_cast<unsigned char>(row[i] - paeth(row[i - bpp], prev[i], prev[i - bpp]));
+    }
+    return row[i];
+}
+
+// One loop per filter type keeps the type out of the inner loop
+template <int Type>
+uint64_t bodyCost(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp)
+{
+    uint64_t cost = 0;
+    for (int i = bpp; i < rowBytes; ++i)
+    {
+        cost += std::abs(static_cast<signed char>(bodyResidual<Type>(row, prev, i, bpp)));
+    }
+    return cost;
+}
+
+template <int Type>
+void applyBody(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp, unsigned char *out)
+{
+    for (int i = bpp; i < rowBytes; ++i)
+    {
+        out[i] = bodyResidual<Type>(row, prev, i, bpp);
+    }
+}
+
+int filterRowScalar(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp, unsigned char *out)
+{
+    uint64_t costs[kFilterTypes] = {0};
+    addCostsScalar(row, prev, 0, bpp, bpp, costs);
+    costs[0] += bodyCost<0>(row, prev, rowBytes, bpp);
+    costs[1] += bodyCost<1>(row, prev, rowBytes, bpp);
+    costs[2] += bodyCost<2>(row, prev, rowBytes, bpp);
+    costs[3] += bodyCost<3>(row, prev, rowBytes, bpp);
+    costs[4] += bodyCost<4>(row, prev, rowBytes, bpp);
+    const int type = cheapestFilter(costs);
+    applyScalar(row, prev, 0, bpp, bpp, type, out);
+    switch (type)
+    {
+    case 0:
+        applyBody<0>(row, prev, rowBytes, bpp, out);
+        break;
+    case 1:
+        applyBody<1>(row, prev, rowBytes, bpp, out);
+        break;
+    case 2:
+        applyBody<2>(row, prev, rowBytes, bpp, out);
+        break;
+    case 3:
+        applyBody<3>(row, prev, rowBytes, bpp, out);
+        break;
+    case 4:
+        applyBody<4>(row, prev, rowBytes, bpp, out);
+        break;
+    }
+    return type;
+}
+
+#if defined(SCREENSHOT_SIMD_X86)
+
+// The encoder sees the whole row up front, so unlike decoding every
+// residual is independent: x is the row, a its bytes bpp to the left, b the
+// row above and c the row above shifted by bpp, all loaded unaligned. The
+// first bpp bytes go through the scalar kernels. Paeth widens to 16 bits.
+
+SIMD_TARGET("ssse3")
+inline __m128i paethSsse3(__m128i a, __m128i b, __m128i c)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i halves[2];
+    for (int h = 0; h < 2; ++h)
+    {
+        __m128i a16 = h ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+        __m128i b16 = h ? _mm_unpackhi_epi8(b, zero) : _mm_unpacklo_epi8(b, zero);
+        __m128i c16 = h ? _mm_unpackhi_epi8(c, zero) : _mm_unpacklo_epi8(c, zero);
+        __m128i pa = _mm_abs_epi16(_mm_sub_epi16(b16, c16));
+        __m128i pb = _mm_abs_epi16(_mm_sub_epi16(a16, c16));
+        __m128i pc = _mm_abs_epi16(_mm_sub_epi16(_mm_add_epi16(a16, b16), _mm_add_epi16(c16, c16)));
+        __m128i notA = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        __m128i notB = _mm_cmpgt_epi16(pb, pc);
+        __m128i bc = _mm_or_si128(_mm_and_si128(notB, c16), _mm_andnot_si128(notB, b16));
+        halves[h] = _mm_or_si128(_mm_and_si128(notA, bc), _mm_andnot_si128(notA, a16));
+    }
+    return _mm_packus_epi16(halves[0], halves[1]);
+}
+
+SIMD_TARGET("ssse3")
+inline __m128i residualSsse3(int type, __m128i x, __m128i a, __m128i b, __m128i c)
+{
+    switch (type)
+    {
+    case 1:
+        return _mm_sub_epi8(x, a);
+    case 2:
+        return _mm_sub_epi8(x, b);
+    case 3:
+        // pavgb rounds up; the filter rounds down
+        return _mm_sub_epi8(x, _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1))));
+    case 4:
+        return _mm_sub_epi8(x, paethSsse3(a, b, c));
+    }
+    return x;
+}
+
+SIMD_TARGET("ssse3")
+int filterRowSsse3(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp, unsigned char *out)
+{
+    uint64_t costs[kFilterTypes] = {0};
+    addCostsScalar(row, prev, 0, bpp, bpp, costs);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sums[kFilterTypes];
+    for (int type = 0; type < kFilterTypes; ++type)
+    {
+        sums[type] = zero;
+    }
+    int i = bpp;
+    for (; i + 16 <= rowBytes; i += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i - bpp));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i - bpp));
+        for (int type = 0; type < kFilterTypes; ++type)
+        {
+            sums[type] = _mm_add_epi64(sums[type], _mm_sad_epu8(_mm_abs_epi8(residualSsse3(type, x, a, b, c)), zero));
+        }
+    }
+    for (int type = 0; type < kFilterTypes; ++type)
+    {
+        costs[type] += static_cast<uint64_t>(_mm_cvtsi128_si32(sums[type])) + _mm_cvtsi128_si32(_mm_srli_si128(sums[type], 8));
+    }
+    addCostsScalar(row, prev, i, rowBytes, bpp, costs);
+
+    const int type = cheapestFilter(costs);
+    applyScalar(row, prev, 0, bpp, bpp, type, out);
+    for (i = bpp; i + 16 <= rowBytes; i += 16)
+    {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i - bpp));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i));
+        __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i - bpp));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), residualSsse3(type, x, a, b, c));
+    }
+    applyScalar(row, prev, i, rowBytes, bpp, type, out);
+    return type;
+}
+
+SIMD_TARGET("avx2")
+inline __m256i paethAvx2(__m256i a, __m256i b, __m256i c)
+{
+    // Unpacking and packing both work within 128-bit lanes, so the bytes
+    // come back in order
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i halves[2];
+    for (int h = 0; h < 2; ++h)
+    {
+        __m256i a16 = h ? _mm256_unpackhi_epi8(a, zero) : _mm256_unpacklo_epi8(a, zero);
+        __m256i b16 = h ? _mm256_unpackhi_epi8(b, zero) : _mm256_unpacklo_epi8(b, zero);
+        __m256i c16 = h ? _mm256_unpackhi_epi8(c, zero) : _mm256_unpacklo_epi8(c, zero);
+        __m256i pa = _mm256_abs_epi16(_mm256_sub_epi16(b16, c16));
+        __m256i pb = _mm256_abs_epi16(_mm256_sub_epi16(a16, c16));
+        __m256i pc = _mm256_abs_epi16(_mm256_sub_epi16(_mm256_add_epi16(a16, b16), _mm256_add_epi16(c16, c16)));
+        __m256i notA = _mm256_or_si256(_mm256_cmpgt_epi16(pa, pb), _mm256_cmpgt_epi16(pa, pc));
+        __m256i notB = _mm256_cmpgt_epi16(pb, pc);
+        __m256i bc = _mm256_blendv_epi8(b16, c16, notB);
+        halves[h] = _mm256_blendv_epi8(a16, bc, notA);
+    }
+    return _mm256_packus_epi16(halves[0], halves[1]);
+}
+
+SIMD_TARGET("avx2")
+inline __m256i residualAvx2(int type, __m256i x, __m256i a, __m256i b, __m256i c)
+{
+    switch (type)
+    {
+    case 1:
+        return _mm256_sub_epi8(x, a);
+    case 2:
+        return _mm256_sub_epi8(x, b);
+    case 3:
+        return _mm256_sub_epi8(x, _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1))));
+    case 4:
+        return _mm256_sub_epi8(x, paethAvx2(a, b, c));
+    }
+    return x;
+}
+
+SIMD_TARGET("avx2")
+int filterRowAvx2(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp, unsigned char *out)
+{
+    uint64_t costs[kFilterTypes] = {0};
+    addCostsScalar(row, prev, 0, bpp, bpp, costs);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i sums[kFilterTypes];
+    for (int type = 0; type < kFilterTypes; ++type)
+    {
+        sums[type] = zero;
+    }
+    int i = bpp;
+    for (; i + 32 <= rowBytes; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i - bpp));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev + i));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev + i - bpp));
+        for (int type = 0; type < kFilterTypes; ++type)
+        {
+            sums[type] = _mm256_add_epi64(sums[type], _mm256_sad_epu8(_mm256_abs_epi8(residualAvx2(type, x, a, b, c)), zero));
+        }
+    }
+    for (int type = 0; type < kFilterTypes; ++type)
+    {
+        uint64_t lanes[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sums[type]);
+        costs[type] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+    addCostsScalar(row, prev, i, rowBytes, bpp, costs);
+
+    const int type = cheapestFilter(costs);
+    applyScalar(row, prev, 0, bpp, bpp, type, out);
+    for (i = bpp; i + 32 <= rowBytes; i += 32)
+    {
+        __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+        __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i - bpp));
+        __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev + i));
+        __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev + i - bpp));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), residualAvx2(type, x, a, b, c));
+    }
+    applyScalar(row, prev, i, rowBytes, bpp, type, out);
+    return type;
+}
+
+#endif
+
+const PngFilterKernels kScalarKernels = {"scalar", filterRowScalar};
+#if defined(SCREENSHOT_SIMD_X86)
+const PngFilterKernels kSsse3Kernels = {"ssse3", filterRowSsse3};
+const PngFilterKernels kAvx2Kernels = {"avx2", filterRowAvx2};
+#endif
+
+PngFilterKernels selectPngFilterKernels()
+{
+    // cpuFeatures() already applies the SCREENSHOT_SIMD cap
+#if defined(SCREENSHOT_SIMD_X86)
+    const CpuFeatures &features = cpuFeatures();
+    if (features.avx2)
+    {
+        return kAvx2Kernels;
+    }
+    if (features.ssse3)
+    {
+        return kSsse3Kernels;
+    }
+#endif
+    return kScalarKernels;
+}
+
+const PngFilterKernels activeKernels = selectPngFilterKernels();
+
+} // namespace
+
+const PngFilterKernels &pngFilterKernels()
+{
+    return activeKernels;
+}
+
+std::vector<PngFilterKernels> supportedPngFilterKernels()
+{
+    std::vector<PngFilterKernels> kernels;
+    kernels.push_back(kScalarKernels);
+#if defined(SCREENSHOT_SIMD_X86)
+    CpuFeatures features = detectCpuFeatures();
+    if (features.ssse3)
+    {
+        kernels.push_back(kSsse3Kernels);
+    }
+    if (features.avx2)
+    {
+        kernels.push_back(kAvx2Kernels);
+    }
+#endif
+    return kernels;
+}
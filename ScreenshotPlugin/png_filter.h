@@ -0,0 +1,26 @@
+#pragma once
+
+#include <vector>
+
+// PNG row filtering (filter types 0-4: None, Sub, Up, Average, Paeth) for
+// the truecolor writer. The filter is chosen per row with stb_image_write's
+// heuristic, the smallest sum of the residuals' magnitudes as signed bytes,
+// ties going to the lower type, so every kernel set writes the same bytes.
+
+// Filters the rowBytes bytes of row against prev, the row above (all zeros
+// for the first row of the image), with bpp bytes per pixel. Writes the
+// residuals of the chosen filter to out and returns its type.
+typedef int (*PngRowFilter)(const unsigned char *row, const unsigned char *prev, int rowBytes, int bpp, unsigned char *out);
+
+struct PngFilterKernels
+{
+    const char *isa;
+    PngRowFilter filterRow;
+};
+
+// The fastest kernels this CPU supports, picked once when the library is
+// loaded. SCREENSHOT_SIMD caps the choice as for pixelKernels().
+const PngFilterKernels &pngFilterKernels();
+
+// Every kernel set this CPU can run, scalar first (for benchmarks)
+std::vector<PngFilterKernels> supportedPngFilterKernels();
@@ -0,0 +1,297 @@
+#include "deflate.h"
+
+#if defined(SCREENSHOT_DEFLATE_LIBDEFLATE) || defined(SCREENSHOT_DEFLATE_ZLIB)
+#define STBIW_ZLIB_COMPRESS zlibCompress
+#endif
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "png_writer.h"
+#include "checksum.h"
+#include "pixel_convert.h"
+#include "png_filter.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+// Container and filtering follow stbi_write_png_to_mem (same per-row filter
+// heuristic, same deflate call), so with the stb deflate backend at its
+// default level RGBA input produces byte-identical files. Filtering
+// (png_filter.h) runs in bands of rows on the shared thread pool; zlib
+// builds also deflate in stripes there.
+
+namespace
+{
+
+// Rows filtered per parallel task
+const int kFilterRows = 16;
+
+// Filtered bytes per independently deflated stripe (zlib builds): about 20
+// rows of a 4K RGB canvas, enough stripes to keep every core busy while
+// each stays far larger than the 32 KB window
+const size_t kStripeBytes = 256 * 1024;
+
+void put32(std::vector<unsigned char> &out, uint32_t v)
+{
+    out.push_back(static_cast<unsigned char>(v >> 24));
+    out.push_back(static_cast<unsigned char>(v >> 16));
+    out.push_back(static_cast<unsigned char>(v >> 8));
+    out.push_back(static_cast<unsigned char>(v));
+}
+
+void writeChunk(std::vector<unsigned char> &out, const char *tag, const unsigned char *data, size_t len)
+{
+    put32(out, static_cast<uint32_t>(len));
+    size_t start = out.size();
+    out.insert(out.end(), tag, tag + 4);
+    if (len)
+    {
+        out.insert(out.end(), data, data + len);
+    }
+    put32(out, crc32Update(0, out.data() + start, len + 4));
+}
+
+void bgrToRgbRow(const unsigned char *src, unsigned char *dst, int pixelCount)
+{
+    for (int i = 0; i < pixelCount; ++i)
+    {
+        dst[i * 3 + 0] = src[i * 3 + 2];
+        dst[i * 3 + 1] = src[i * 3 + 1];
+        dst[i * 3 + 2] = src[i * 3 + 0];
+    }
+}
+
+// Reorders, filters and tags rows [first, last) into their lines of
+// filtered. Each row only needs the one above it, so bands of rows are
+// independent.
+void filterRows(const unsigned char *pixels, int width, int stride, PixelFormat format, int first, int last, unsigned char *filtered)
+{
+    const int bpp = bytesPerPixel(format);
+    const int rowBytes = width * bpp;
+    const size_t filteredStride = static_cast<size_t>(rowBytes) + 1;
+
+    // Rows that are not in PNG channel order are reordered into a two-row
+    // ring (current + previous, which the Up/Average/Paeth filters read)
+    PixelRowConverter toRgba = nullptr;
+    if (format == PixelFormat::BGRA8 || format == PixelFormat::BGRX8)
+    {
+        toRgba = rowConverterToRGBA(format);
+    }
+    bool reorder = toRgba || format == PixelFormat::BGR8;
+
+    std::vector<unsigned char> ring(reorder ? rowBytes * 2 : 0);
+    std::vector<unsigned char> zeroRow(first == 0 ? rowBytes : 0, 0);
+    const PngRowFilter filterRow = pngFilterKernels().filterRow;
+    auto pngRow = [&](int y) {
+        const unsigned char *row = pixels + static_cast<size_t>(y) * stride;
+        if (!reorder)
+        {
+            return row;
+        }
+        unsigned char *slot = &ring[(y & 1) * rowBytes];
+        if (toRgba)
+        {
+            toRgba(row, slot, width);
+        }
+        else
+        {
+            bgrToRgbRow(row, slot, width);
+        }
+        return const_cast<const unsigned char *>(slot);
+    };
+
+    const unsigned char *prev = first == 0 ? zeroRow.data() : pngRow(first - 1);
+    for (int y = first; y < last; ++y)
+    {
+        const unsigned char *row = pngRow(y);
+
+        unsigned char *line = filtered + static_cast<size_t>(y) * filteredStride;
+        line[0] = static_cast<unsigned char>(filterRow(row, prev, rowBytes, bpp, line + 1));
+        prev = row;
+    }
+}
+
+#if defined(SCREENSHOT_DEFLATE_STRIPES)
+// One zlib stream from stripes of about kStripeBytes deflated on the pool.
+// Each stripe is primed with the 32 KB before it, so only the block
+// boundaries and sync markers (a few bytes per stripe) cost compression.
+bool compressFiltered(const std::vector<unsigned char> &filtered, int level, int threads, std::vector<unsigned char> &zlib)
+{
+    const size_t stripeCount = std::max<size_t>((filtered.size() + kStripeBytes / 2) / kStripeBytes, 1);
+    std::vector<std::vector<unsigned char>> stripes(stripeCount);
+    std::vector<uint32_t> adlers(stripeCount);
+    std::vector<char> ok(stripeCount, 0);
+    auto stripeBegin = [&](size_t s) { return filtered.size() * s / stripeCount; };
+    ThreadPool::shared().parallelFor(stripeCount, [&](size_t s) {
+        size_t begin = stripeBegin(s);
+        size_t end = stripeBegin(s + 1);
+        adlers[s] = adler32Update(1, filtered.data() + begin, end - begin);
+        ok[s] = deflateStripe(filtered.data(), begin, filtered.data() + begin, end - begin, s + 1 == stripeCount, level, stripes[s]);
+    }, threads);
+
+    size_t total = 2 + 4;
+    for (const auto &stripe : stripes)
+    {
+        total += stripe.size();
+    }
+    zlib.clear();
+    zlib.reserve(total);
+    unsigned char header[2];
+    zlibHeader(level, header);
+    zlib.insert(zlib.end(), header, header + 2);
+    uint32_t adler = 1;
+    for (size_t s = 0; s < stripeCount; ++s)
+    {
+        if (!ok[s])
+        {
+            return false;
+        }
+        zlib.insert(zlib.end(), stripes[s].begin(), stripes[s].end());
+        adler = adler32Combine(adler, adlers[s], stripeBegin(s + 1) - stripeBegin(s));
+    }
+    put32(zlib, adler);
+    return true;
+}
+#else
+bool compressFiltered(const std::vector<unsigned char> &filtered, int level, int, std::vector<unsigned char> &zlib)
+{
+    int zlen = 0;
+    unsigned char *data = stbi_zlib_compress(const_cast<unsigned char *>(filtered.data()), static_cast<int>(filtered.size()), &zlen, level);
+    if (!data)
+    {
+        return false;
+    }
+    zlib.assign(data, data + zlen);
+    STBIW_FREE(data);
+    return true;
+}
+#endif
+
+// Signature, IHDR, the IDAT of zlib and IEND, with the palette chunks in
+// between for colour type 3
+void writePng(int width, int height, int bitDepth, int colorType, const std::vector<unsigned char> &plte, const std::vector<unsigned char> &trns,
+              const std::vector<unsigned char> &zlib, std::vector<unsigned char> &out)
+{
+    static const unsigned char signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+    std::vector<unsigned char> header;
+    put32(header, static_cast<uint32_t>(width));
+    put32(header, static_cast<uint32_t>(height));
+    header.push_back(static_cast<unsigned char>(bitDepth));
+    header.push_back(static_cast<unsigned char>(colorType));
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+
+    out.clear();
+    out.reserve(8 + 25 + (plte.empty() ? 0 : 12 + plte.size()) + (trns.empty() ? 0 : 12 + trns.size()) + 12 + zlib.size() + 12);
+    out.insert(out.end(), signature, signature + 8);
+    writeChunk(out, "IHDR", header.data(), header.size());
+    if (!plte.empty())
+    {
+        writeChunk(out, "PLTE", plte.data(), plte.size());
+    }
+    if (!trns.empty())
+    {
+        writeChunk(out, "tRNS", trns.data(), trns.size());
+    }
+    writeChunk(out, "IDAT", zlib.data(), zlib.size());
+    writeChunk(out, "IEND", nullptr, 0);
+}
+
+} // namespace
+
+bool encodePng(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, std::vector<unsigned char> &out, int level,
+               int threads)
+{
+    if (!pixels || width <= 0 || height <= 0)
+    {
+        return false;
+    }
+
+    const int bpp = bytesPerPixel(format);
+    const size_t filteredStride = static_cast<size_t>(width) * bpp + 1;
+    std::vector<unsigned char> filtered(filteredStride * height);
+    const size_t bands = (height + kFilterRows - 1) / kFilterRows;
+    ThreadPool::shared().parallelFor(bands, [&](size_t band) {
+        int first = static_cast<int>(band) * kFilterRows;
+        filterRows(pixels, width, stride, format, first, std::min(first + kFilterRows, height), filtered.data());
+    }, threads);
+
+    std::vector<unsigned char> zlib;
+    if (!compressFiltered(filtered, level < 0 ? defaultDeflateLevel() : level, threads, zlib))
+    {
+        std::cerr << "PNG deflate failed" << std::endl;
+        return false;
+    }
+
+    writePng(width, height, 8, bpp == 4 ? 6 : 2, std::vector<unsigned char>(), std::vector<unsigned char>(), zlib, out); // RGBA or RGB
+    return true;
+}
+
+bool encodePngIndexed(const unsigned char *indices, int width, int height, const std::vector<uint32_t> &palette, std::vector<unsigned char> &out,
+                      int level, int threads)
+{
+    if (!indices || width <= 0 || height <= 0 || palette.empty() || palette.size() > 256)
+    {
+        return false;
+    }
+
+    // The smallest bit depth that holds every index; below 8 bits pixels
+    // are packed into bytes from the most significant bit down
+    const int bitDepth = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : palette.size() <= 16 ? 4 : 8;
+    const int pixelsPerByte = 8 / bitDepth;
+    const size_t rowBytes = (static_cast<size_t>(width) + pixelsPerByte - 1) / pixelsPerByte;
+
+    // Filter type 0 in front of every row
+    const size_t filteredStride = rowBytes + 1;
+    std::vector<unsigned char> filtered(filteredStride * height);
+    ThreadPool::shared().parallelFor((height + kFilterRows - 1) / kFilterRows, [&](size_t band) {
+        const int first = static_cast<int>(band) * kFilterRows;
+        for (int y = first; y < std::min(first + kFilterRows, height); ++y)
+        {
+            const unsigned char *row = indices + static_cast<size_t>(y) * width;
+            unsigned char *line = &filtered[y * filteredStride];
+            line[0] = 0;
+            if (bitDepth == 8)
+            {
+                std::memcpy(line + 1, row, width);
+                continue;
+            }
+            std::memset(line + 1, 0, rowBytes);
+            for (int x = 0; x < width; ++x)
+            {
+                line[1 + x / pixelsPerByte] |= static_cast<unsigned char>(row[x] << (8 - bitDepth * (x % pixelsPerByte + 1)));
+            }
+        }
+    }, threads);
+
+    std::vector<unsigned char> zlib;
+    if (!compressFiltered(filtered, level < 0 ? defaultDeflateLevel() : level, threads, zlib))
+    {
+        std::cerr << "PNG deflate failed" << std::endl;
+        return false;
+    }
+
+    // tRNS only needs to run up to the last colour that is not opaque
+    std::vector<unsigned char> plte;
+    std::vector<unsigned char> trns;
+    size_t lastTranslucent = 0;
+    for (size_t i = 0; i < palette.size(); ++i)
+    {
+        plte.push_back(static_cast<unsigned char>(palette[i]));
+        plte.push_back(static_cast<unsigned char>(palette[i] >> 8));
+        plte.push_back(static_cast<unsigned char>(palette[i] >> 16));
+        trns.push_back(static_cast<unsigned char>(palette[i] >> 24));
+        if (trns.back() != 255)
+        {
+            lastTranslucent = i + 1;
+        }
+    }
+    trns.resize(lastTranslucent);
+    writePng(width, height, bitDepth, 3, plte, trns, zlib, out);
+    return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <cstdint>
+#include <vector>
+
+// PNG encoder that reads capture and compositor buffers as they are: any
+// PixelFormat, any row stride. BGR-ordered rows are reordered one at a time
+// right before the filter step, while they are still in cache, so BGRA/BGRX
+// frames never need a separate full-frame swizzle pass. 4-byte formats are
+// written as RGBA (BGRX with alpha 255), 3-byte formats as RGB. level is
+// the deflate level of the build's backend (see deflate.h); -1 uses its
+// default. Rows are filtered, and with zlib deflated, on up to threads
+// threads of the shared pool (0 = all of them); the output does not depend
+// on the thread count.
+bool encodePng(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, std::vector<unsigned char> &out,
+               int level = -1, int threads = 0);
+
+// Indexed-colour PNG. indices holds one palette index per pixel, width
+// bytes per row; palette holds 1-256 packRgba() colours (palette.h), written
+// as PLTE plus a tRNS chunk when any of them is not opaque. The file uses 1,
+// 2, 4 or 8 bits per pixel, the fewest the palette size allows. Rows are
+// stored unfiltered, as is usual for palette images; level and threads are
+// as for encodePng().
+bool encodePngIndexed(const unsigned char *indices, int width, int height, const std::vector<uint32_t> &palette, std::vector<unsigned char> &out,
+                      int level = -1, int threads = 0);
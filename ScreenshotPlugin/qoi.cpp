@@ -0,0 +1,282 @@
+#include "qoi.h"
+
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace
+{
+
+const unsigned char kOpIndex = 0x00; // 00xxxxxx: index of a recently seen pixel
+const unsigned char kOpDiff = 0x40;  // 01rrggbb: small channel differences
+const unsigned char kOpLuma = 0x80;  // 10gggggg, rrrrbbbb: green difference, red and blue relative to it
+const unsigned char kOpRun = 0xc0;   // 11xxxxxx: 1-62 repeats of the previous pixel
+const unsigned char kOpRgb = 0xfe;
+const unsigned char kOpRgba = 0xff;
+
+const size_t kHeaderSize = 14;
+const unsigned char kEndMarker[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+// The format's own limit, which keeps worst-case sizes far from overflow
+const uint64_t kMaxPixels = 400000000;
+
+inline uint32_t pack(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+inline unsigned hashIndex(unsigned r, unsigned g, unsigned b, unsigned a)
+{
+    return (r * 3 + g * 5 + b * 7 + a * 11) % 64;
+}
+
+void put32(unsigned char *p, uint32_t v)
+{
+    p[0] = static_cast<unsigned char>(v >> 24);
+    p[1] = static_cast<unsigned char>(v >> 16);
+    p[2] = static_cast<unsigned char>(v >> 8);
+    p[3] = static_cast<unsigned char>(v);
+}
+
+uint32_t get32(const unsigned char *p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+// Encodes into a small stack buffer that is appended to out whenever it
+// nears its end; out already has room for the worst case, so nothing
+// reallocates and the pixels are read exactly once. R, G, B and A are the
+// channel offsets in a pixel of Bpp bytes; A < 0 reads every pixel as opaque.
+template <int R, int G, int B, int A, int Bpp>
+void encodePixels(const unsigned char *pixels, int width, int height, int stride, std::vector<unsigned char> &out)
+{
+    unsigned char chunk[16384];
+    unsigned char *const chunkEnd = chunk + sizeof(chunk) - 6; // room for a pending run and the longest op
+    unsigned char *p = chunk;
+
+    uint32_t index[64] = {0};
+    unsigned char pr = 0, pg = 0, pb = 0, pa = 255;
+    int run = 0;
+    for (int y = 0; y < height; ++y)
+    {
+        const unsigned char *px = pixels + static_cast<size_t>(y) * stride;
+        for (int x = 0; x < width; ++x, px += Bpp)
+        {
+            const unsigned char r = px[R], g = px[G], b = px[B], a = A < 0 ? 255 : px[A < 0 ? 0 : A];
+            if (r == pr && g == pg && b == pb && a == pa)
+            {
+                if (++run == 62)
+                {
+                    if (p >= chunkEnd)
+                    {
+                        out.insert(out.end(), chunk, p);
+                        p = chunk;
+                    }
+                    *p++ = kOpRun | 61;
+                    run = 0;
+                }
+                continue;
+            }
+            if (p >= chunkEnd)
+            {
+                out.insert(out.end(), chunk, p);
+                p = chunk;
+            }
+            if (run)
+            {
+                *p++ = static_cast<unsigned char>(kOpRun | (run - 1));
+                run = 0;
+            }
+
+            const unsigned h = hashIndex(r, g, b, a);
+            const uint32_t packed = pack(r, g, b, a);
+            if (index[h] == packed)
+            {
+                *p++ = static_cast<unsigned char>(kOpIndex | h);
+            }
+            else if (a == pa)
+            {
+                index[h] = packed;
+                const signed char vr = static_cast<signed char>(r - pr);
+                const signed char vg = static_cast<signed char>(g - pg);
+                const signed char vb = static_cast<signed char>(b - pb);
+                const signed char vgr = static_cast<signed char>(vr - vg);
+                const signed char vgb = static_cast<signed char>(vb - vg);
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                {
+                    *p++ = static_cast<unsigned char>(kOpDiff | (vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                }
+                else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8)
+                {
+                    *p++ = static_cast<unsigned char>(kOpLuma | (vg + 32));
+                    *p++ = static_cast<unsigned char>((vgr + 8) << 4 | (vgb + 8));
+                }
+                else
+                {
+                    *p++ = kOpRgb;
+                    *p++ = r;
+                    *p++ = g;
+                    *p++ = b;
+                }
+            }
+            else
+            {
+                index[h] = packed;
+                *p++ = kOpRgba;
+                *p++ = r;
+                *p++ = g;
+                *p++ = b;
+                *p++ = a;
+            }
+            pr = r;
+            pg = g;
+            pb = b;
+            pa = a;
+        }
+    }
+    if (run)
+    {
+        *p++ = static_cast<unsigned char>(kOpRun | (run - 1));
+    }
+    out.insert(out.end(), chunk, p);
+}
+
+} // namespace
+
+bool encodeQoi(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, std::vector<unsigned char> &out)
+{
+    out.clear();
+    if (!pixels || width <= 0 || height <= 0 || static_cast<uint64_t>(width) * height > kMaxPixels)
+    {
+        std::cerr << "Cannot encode a " << width << "x" << height << " QOI image" << std::endl;
+        return false;
+    }
+
+    const bool alpha = format == PixelFormat::BGRA8 || format == PixelFormat::RGBA8;
+    const int channels = alpha ? 4 : 3;
+    out.reserve(kHeaderSize + static_cast<size_t>(width) * height * (channels + 1) + sizeof(kEndMarker));
+    out.resize(kHeaderSize);
+    std::memcpy(out.data(), "qoif", 4);
+    put32(out.data() + 4, static_cast<uint32_t>(width));
+    put32(out.data() + 8, static_cast<uint32_t>(height));
+    out[12] = static_cast<unsigned char>(channels);
+    out[13] = 0; // sRGB
+
+    switch (format)
+    {
+    case PixelFormat::BGRA8:
+        encodePixels<2, 1, 0, 3, 4>(pixels, width, height, stride, out);
+        break;
+    case PixelFormat::BGRX8:
+        encodePixels<2, 1, 0, -1, 4>(pixels, width, height, stride, out);
+        break;
+    case PixelFormat::BGR8:
+        encodePixels<2, 1, 0, -1, 3>(pixels, width, height, stride, out);
+        break;
+    case PixelFormat::RGBA8:
+        encodePixels<0, 1, 2, 3, 4>(pixels, width, height, stride, out);
+        break;
+    case PixelFormat::RGB8:
+        encodePixels<0, 1, 2, -1, 3>(pixels, width, height, stride, out);
+        break;
+    }
+    out.insert(out.end(), kEndMarker, kEndMarker + sizeof(kEndMarker));
+    return true;
+}
+
+bool decodeQoi(const unsigned char *data, size_t size, Frame &frame)
+{
+    if (!data || size < kHeaderSize + sizeof(kEndMarker) || std::memcmp(data, "qoif", 4) != 0)
+    {
+        return false;
+    }
+    const uint32_t width = get32(data + 4);
+    const uint32_t height = get32(data + 8);
+    const int channels = data[12];
+    if (!width || !height || width > 0x7fffffff || height > 0x7fffffff || static_cast<uint64_t>(width) * height > kMaxPixels ||
+        (channels != 3 && channels != 4))
+    {
+        return false;
+    }
+
+    Frame decoded(static_cast<int>(width), static_cast<int>(height), channels == 4 ? PixelFormat::RGBA8 : PixelFormat::RGB8);
+    uint32_t index[64] = {0};
+    unsigned char r = 0, g = 0, b = 0, a = 255;
+    int run = 0;
+    size_t pos = kHeaderSize;
+    const size_t end = size - sizeof(kEndMarker);
+    for (uint32_t y = 0; y < height; ++y)
+    {
+        unsigned char *px = decoded.row(static_cast<int>(y));
+        for (uint32_t x = 0; x < width; ++x, px += channels)
+        {
+            if (run)
+            {
+                --run;
+            }
+            else
+            {
+                if (pos >= end)
+                {
+                    return false;
+                }
+                const unsigned char op = data[pos++];
+                if (op == kOpRgb || op == kOpRgba)
+                {
+                    if (end - pos < (op == kOpRgba ? 4u : 3u))
+                    {
+                        return false;
+                    }
+                    r = data[pos++];
+                    g = data[pos++];
+                    b = data[pos++];
+                    if (op == kOpRgba)
+                    {
+                        a = data[pos++];
+                    }
+                }
+                else if ((op & 0xc0) == kOpIndex)
+                {
+                    const uint32_t packed = index[op & 63];
+                    r = static_cast<unsigned char>(packed);
+                    g = static_cast<unsigned char>(packed >> 8);
+                    b = static_cast<unsigned char>(packed >> 16);
+                    a = static_cast<unsigned char>(packed >> 24);
+                }
+                else if ((op & 0xc0) == kOpDiff)
+                {
+                    r = static_cast<unsigned char>(r + ((op >> 4) & 3) - 2);
+                    g = static_cast<unsigned char>(g + ((op >> 2) & 3) - 2);
+                    b = static_cast<unsigned char>(b + (op & 3) - 2);
+                }
+                else if ((op & 0xc0) == kOpLuma)
+                {
+                    if (pos >= end)
+                    {
+                        return false;
+                    }
+                    const unsigned char second = data[pos++];
+                    const int vg = (op & 63) - 32;
+                    r = static_cast<unsigned char>(r + vg - 8 + (second >> 4));
+                    g = static_cast<unsigned char>(g + vg);
+                    b = static_cast<unsigned char>(b + vg - 8 + (second & 15));
+                }
+                else
+                {
+                    run = op & 63;
+                }
+                index[hashIndex(r, g, b, a)] = pack(r, g, b, a);
+            }
+            px[0] = r;
+            px[1] = g;
+            px[2] = b;
+            if (channels == 4)
+            {
+                px[3] = a;
+            }
+        }
+    }
+    frame = std::move(decoded);
+    return true;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "frame_source.h"
+#include "image.h"
+
+#include <cstddef>
+#include <vector>
+
+// QOI ("Quite OK Image", qoiformat.org) encoder for captures where latency
+// matters more than bytes: one pass over the pixels, no entropy coder and no
+// allocation besides out, which is sized for the worst case up front and
+// shrunk at the end. Reads any PixelFormat and row stride; BGRA8 and RGBA8
+// are written with 4 channels, the other formats (BGRX8 included) with 3.
+bool encodeQoi(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, std::vector<unsigned char> &out);
+
+// Decode a QOI file into a new RGBA8 or RGB8 frame (by its channel count),
+// e.g. to recompress a capture uploaded as QOI to PNG or WebP later. False
+// on truncated or malformed data.
+bool decodeQoi(const unsigned char *data, size_t size, Frame &frame);
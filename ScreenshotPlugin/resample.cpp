@@ -0,0 +1,481 @@
+#include "resample.h"
+#include "cpu_features.h"
+#include "pixel_convert.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <tuple>
+
+namespace
+{
+
+const int kWeightBits = 14;
+const int kWeightOne = 1 << kWeightBits;
+// Blended rows keep 7 fractional bits: 255 << 7 still fits an int16
+const int kVerticalShift = kWeightBits - 7;
+const int kHorizontalShift = kWeightBits + 7;
+
+int32_t clamp(int32_t value, int32_t lo, int32_t hi)
+{
+    return std::min(std::max(value, lo), hi);
+}
+
+// Blends the channel values [begin, end) of one row
+void blendValues(const unsigned char *const *rows, const int16_t *weights, int rowCount, int16_t *dst, int begin, int end)
+{
+    for (int v = begin; v < end; ++v)
+    {
+        int32_t sum = 0;
+        for (int t = 0; t < rowCount; ++t)
+        {
+            sum += rows[t][v] * weights[t];
+        }
+        // Saturated like vpackssdw; only the negative lobes of bicubic and
+        // Lanczos reach the limits
+        dst[v] = static_cast<int16_t>(clamp((sum + (1 << (kVerticalShift - 1))) >> kVerticalShift, -32768, 32767));
+    }
+}
+
+void blendRowsScalar(const unsigned char *const *rows, const int16_t *weights, int rowCount, int16_t *dst, int valueCount)
+{
+    blendValues(rows, weights, rowCount, dst, 0, valueCount);
+}
+
+void filterRowScalar(const int16_t *src, unsigned char *dst, const ResampleCoefficients &coefficients, int first, int count)
+{
+    const int taps = coefficients.taps;
+    for (int i = first; i < first + count; ++i)
+    {
+        const int16_t *p = src + static_cast<size_t>(coefficients.starts[i]) * 4;
+        const int16_t *w = &coefficients.weights[static_cast<size_t>(i) * taps];
+        int32_t sum[4] = {0, 0, 0, 0};
+        for (int t = 0; t < taps; ++t)
+        {
+            for (int c = 0; c < 4; ++c)
+            {
+                sum[c] += p[t * 4 + c] * w[t];
+            }
+        }
+        for (int c = 0; c < 4; ++c)
+        {
+            dst[i * 4 + c] = static_cast<unsigned char>(clamp((sum[c] + (1 << (kHorizontalShift - 1))) >> kHorizontalShift, 0, 255));
+        }
+    }
+}
+
+#if defined(SCREENSHOT_SIMD_X86)
+
+// AVX2: 32 channel values per step, two rows per vpmaddwd
+SIMD_TARGET("avx2")
+void blendRowsAvx2(const unsigned char *const *rows, const int16_t *weights, int rowCount, int16_t *dst, int valueCount)
+{
+    // Rows and weights in pairs; an odd last row is paired with itself at
+    // weight zero
+    const int pairCount = (rowCount + 1) / 2;
+    const unsigned char *pairRows[64][2];
+    int32_t pairWeights[64];
+    if (pairCount > 64)
+    {
+        blendValues(rows, weights, rowCount, dst, 0, valueCount);
+        return;
+    }
+    for (int p = 0; p < pairCount; ++p)
+    {
+        bool odd = 2 * p + 1 == rowCount;
+        pairRows[p][0] = rows[2 * p];
+        pairRows[p][1] = rows[odd ? 2 * p : 2 * p + 1];
+        uint32_t second = odd ? 0 : static_cast<uint16_t>(weights[2 * p + 1]);
+        pairWeights[p] = static_cast<int32_t>(static_cast<uint16_t>(weights[2 * p]) | (second << 16));
+    }
+
+    const __m256i round = _mm256_set1_epi32(1 << (kVerticalShift - 1));
+    int v = 0;
+    for (; v + 32 <= valueCount; v += 32)
+    {
+        __m256i sums[4] = {_mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256(), _mm256_setzero_si256()};
+        for (int p = 0; p < pairCount; ++p)
+        {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pairRows[p][0] + v));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(pairRows[p][1] + v));
+            __m256i pair = _mm256_set1_epi32(pairWeights[p]);
+            // Interleaved bytes widen to (a, b) pairs of int16; the unpacks
+            // keep the values of each 128-bit lane in that lane
+            __m256i lowBytes = _mm256_unpacklo_epi8(a, b);
+            __m256i highBytes = _mm256_unpackhi_epi8(a, b);
+            __m256i zero = _mm256_setzero_si256();
+            sums[0] = _mm256_add_epi32(sums[0], _mm256_madd_epi16(_mm256_unpacklo_epi8(lowBytes, zero), pair));
+            sums[1] = _mm256_add_epi32(sums[1], _mm256_madd_epi16(_mm256_unpackhi_epi8(lowBytes, zero), pair));
+            sums[2] = _mm256_add_epi32(sums[2], _mm256_madd_epi16(_mm256_unpacklo_epi8(highBytes, zero), pair));
+            sums[3] = _mm256_add_epi32(sums[3], _mm256_madd_epi16(_mm256_unpackhi_epi8(highBytes, zero), pair));
+        }
+        for (int i = 0; i < 4; ++i)
+        {
+            sums[i] = _mm256_srai_epi32(_mm256_add_epi32(sums[i], round), kVerticalShift);
+        }
+        // Lane 0 holds values 0-15 and lane 1 values 16-31, four per sum
+        __m256i first = _mm256_packs_epi32(sums[0], sums[1]);
+        __m256i second = _mm256_packs_epi32(sums[2], sums[3]);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + v), _mm256_permute2x128_si256(first, second, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + v + 16), _mm256_permute2x128_si256(first, second, 0x31));
+    }
+    blendValues(rows, weights, rowCount, dst, v, valueCount);
+}
+
+// AVX2: four taps of one output pixel per vpmaddwd. The byte shuffle pairs
+// up the same channel of two neighbouring taps, so each 32-bit lane of the
+// product is already a two-tap partial sum for one channel.
+SIMD_TARGET("avx2")
+void filterRowAvx2(const int16_t *src, unsigned char *dst, const ResampleCoefficients &coefficients, int first, int count)
+{
+    const int taps = coefficients.taps;
+    const __m256i pairChannels = _mm256_setr_epi8(0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15,
+                                                  0, 1, 8, 9, 2, 3, 10, 11, 4, 5, 12, 13, 6, 7, 14, 15);
+    const __m256i spreadWeights = _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+    const __m128i round = _mm_set1_epi32(1 << (kHorizontalShift - 1));
+    for (int i = first; i < first + count; ++i)
+    {
+        const int16_t *p = src + static_cast<size_t>(coefficients.starts[i]) * 4;
+        const int16_t *w = &coefficients.weights[static_cast<size_t>(i) * taps];
+        __m256i sum = _mm256_setzero_si256();
+        for (int t = 0; t < taps; t += 4)
+        {
+            __m256i pixels = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + t * 4)), pairChannels);
+            __m256i weights = _mm256_permutevar8x32_epi32(
+                _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(w + t))), spreadWeights);
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pixels, weights));
+        }
+        __m128i channels = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        channels = _mm_srai_epi32(_mm_add_epi32(channels, round), kHorizontalShift);
+        channels = _mm_packus_epi16(_mm_packs_epi32(channels, channels), channels);
+        uint32_t pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(channels));
+        std::memcpy(dst + i * 4, &pixel, 4);
+    }
+}
+
+#endif
+
+const ResampleKernels kScalarResampleKernels = {"scalar", blendRowsScalar, filterRowScalar};
+#if defined(SCREENSHOT_SIMD_X86)
+const ResampleKernels kAvx2ResampleKernels = {"avx2", blendRowsAvx2, filterRowAvx2};
+#endif
+
+ResampleKernels selectResampleKernels()
+{
+#if defined(SCREENSHOT_SIMD_X86)
+    if (cpuFeatures().avx2)
+    {
+        return kAvx2ResampleKernels;
+    }
+#endif
+    return kScalarResampleKernels;
+}
+
+// Resolved while the library loads, like the pixel conversion kernels
+const ResampleKernels activeResampleKernels = selectResampleKernels();
+
+// Filter shapes, as functions of the distance in source pixels (scaled by the
+// reduction factor when reducing)
+double triangle(double x)
+{
+    x = std::fabs(x);
+    return x < 1.0 ? 1.0 - x : 0.0;
+}
+
+double catmullRom(double x)
+{
+    const double a = -0.5;
+    x = std::fabs(x);
+    if (x < 1.0)
+    {
+        return ((a + 2.0) * x - (a + 3.0)) * x * x + 1.0;
+    }
+    if (x < 2.0)
+    {
+        return ((a * x - 5.0 * a) * x + 8.0 * a) * x - 4.0 * a;
+    }
+    return 0.0;
+}
+
+double sinc(double x)
+{
+    if (x == 0.0)
+    {
+        return 1.0;
+    }
+    x *= 3.14159265358979323846;
+    return std::sin(x) / x;
+}
+
+double lanczos3(double x)
+{
+    return std::fabs(x) < 3.0 ? sinc(x) * sinc(x / 3.0) : 0.0;
+}
+
+} // namespace
+
+const char *resampleFilterName(ResampleFilter filter)
+{
+    switch (filter)
+    {
+    case ResampleFilter::Box:
+        return "box";
+    case ResampleFilter::Bilinear:
+        return "bilinear";
+    case ResampleFilter::Bicubic:
+        return "bicubic";
+    case ResampleFilter::Lanczos3:
+        return "lanczos3";
+    }
+    return "unknown";
+}
+
+bool parseResampleFilter(const std::string &name, ResampleFilter &filter)
+{
+    const ResampleFilter filters[] = {ResampleFilter::Box, ResampleFilter::Bilinear, ResampleFilter::Bicubic, ResampleFilter::Lanczos3};
+    for (ResampleFilter candidate : filters)
+    {
+        if (name == resampleFilterName(candidate))
+        {
+            filter = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+ResampleCoefficients::ResampleCoefficients(int srcSize, int dstSize, ResampleFilter filter)
+    : srcSize(srcSize), dstSize(dstSize), taps(0), starts(dstSize)
+{
+    // Source window [firsts[i], firsts[i] + counts[i]) of every output
+    std::vector<int> firsts(dstSize);
+    std::vector<int> counts(dstSize);
+    const double scale = static_cast<double>(srcSize) / dstSize;
+    const double filterScale = std::max(scale, 1.0);
+    double support = 0.0;
+    double (*shape)(double) = nullptr;
+    switch (filter)
+    {
+    case ResampleFilter::Box:
+        break;
+    case ResampleFilter::Bilinear:
+        support = 1.0;
+        shape = triangle;
+        break;
+    case ResampleFilter::Bicubic:
+        support = 2.0;
+        shape = catmullRom;
+        break;
+    case ResampleFilter::Lanczos3:
+        support = 3.0;
+        shape = lanczos3;
+        break;
+    }
+    support *= filterScale;
+
+    for (int i = 0; i < dstSize; ++i)
+    {
+        if (!shape)
+        {
+            // Output i covers [i * srcSize, (i + 1) * srcSize) in units of
+            // 1/dstSize source pixel
+            int64_t begin = static_cast<int64_t>(i) * srcSize;
+            firsts[i] = static_cast<int>(begin / dstSize);
+            counts[i] = static_cast<int>((begin + srcSize - 1) / dstSize) - firsts[i] + 1;
+        }
+        else
+        {
+            double center = (i + 0.5) * scale;
+            firsts[i] = std::max(0, static_cast<int>(std::floor(center - support + 0.5)));
+            counts[i] = std::min(srcSize, static_cast<int>(std::floor(center + support + 0.5))) - firsts[i];
+            counts[i] = std::max(counts[i], 1);
+            firsts[i] = std::min(firsts[i], srcSize - counts[i]);
+        }
+        taps = std::max(taps, counts[i]);
+    }
+    taps = (taps + 3) & ~3;
+
+    weights.assign(static_cast<size_t>(dstSize) * taps, 0);
+    std::vector<double> raw(taps);
+    for (int i = 0; i < dstSize; ++i)
+    {
+        double total = 0.0;
+        for (int t = 0; t < counts[i]; ++t)
+        {
+            if (!shape)
+            {
+                // Exact coverage of source pixel firsts[i] + t
+                int64_t begin = static_cast<int64_t>(i) * srcSize;
+                int64_t pixelBegin = static_cast<int64_t>(firsts[i] + t) * dstSize;
+                int64_t overlap = std::min(begin + srcSize, pixelBegin + dstSize) - std::max(begin, pixelBegin);
+                raw[t] = static_cast<double>(overlap);
+            }
+            else
+            {
+                raw[t] = shape((firsts[i] + t + 0.5 - (i + 0.5) * scale) / filterScale);
+            }
+            total += raw[t];
+        }
+
+        starts[i] = std::max(0, std::min(firsts[i], srcSize - taps));
+        int16_t *w = &weights[static_cast<size_t>(i) * taps + (firsts[i] - starts[i])];
+        int sum = 0;
+        int largest = 0;
+        for (int t = 0; t < counts[i]; ++t)
+        {
+            w[t] = static_cast<int16_t>(total != 0.0 ? std::lround(raw[t] / total * kWeightOne) : 0);
+            sum += w[t];
+            largest = std::abs(w[t]) > std::abs(w[largest]) ? t : largest;
+        }
+        // Rounding error goes to the heaviest tap so flat areas stay exact
+        w[largest] = static_cast<int16_t>(w[largest] + kWeightOne - sum);
+    }
+}
+
+const ResampleKernels &resampleKernels()
+{
+    return activeResampleKernels;
+}
+
+std::vector<ResampleKernels> supportedResampleKernels()
+{
+    std::vector<ResampleKernels> kernels;
+    kernels.push_back(kScalarResampleKernels);
+#if defined(SCREENSHOT_SIMD_X86)
+    if (detectCpuFeatures().avx2)
+    {
+        kernels.push_back(kAvx2ResampleKernels);
+    }
+#endif
+    return kernels;
+}
+
+Resampler::Resampler(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter)
+    : filter_(filter), horizontal_(srcWidth, dstWidth, filter), vertical_(srcHeight, dstHeight, filter)
+{
+}
+
+void Resampler::resample(const ImageView &src, const MutableImageView &dst, const ResampleKernels &kernels) const
+{
+    resampleRows(src, dst, 0, dst.height, kernels);
+}
+
+void Resampler::resampleRows(const ImageView &src, const MutableImageView &dst, int firstRow, int rowCount, const ResampleKernels &kernels) const
+{
+    resampleRect(src, dst, 0, firstRow, dst.width, rowCount, kernels);
+}
+
+void Resampler::resampleRect(const ImageView &src, const MutableImageView &dst, int x, int y, int width, int height,
+                             const ResampleKernels &kernels) const
+{
+    const PixelFormat packed = packedFormat(src.format);
+    if (src.empty() || src.width != horizontal_.srcSize || src.height != vertical_.srcSize || dst.width != horizontal_.dstSize ||
+        dst.height != vertical_.dstSize || !canConvert(src.format, packed) || !canConvert(packed, dst.format))
+    {
+        return;
+    }
+    const int firstColumn = std::max(x, 0);
+    const int endColumn = std::min(x + width, dst.width);
+    const int firstRow = std::max(y, 0);
+    const int endRow = std::min(y + height, dst.height);
+    if (firstColumn >= endColumn || firstRow >= endRow)
+    {
+        return;
+    }
+    PixelRowConverter widen = rowConverter(src.format, packed);
+    PixelRowConverter narrow = rowConverter(packed, dst.format);
+    const int dstBpp = bytesPerPixel(dst.format);
+    const int valueCount = src.width * 4;
+
+    // Source columns the requested output columns read
+    const int sourceBegin = horizontal_.starts[firstColumn];
+    const int sourceEnd = std::min(horizontal_.starts[endColumn - 1] + horizontal_.taps, src.width);
+
+    // The blended row is padded to at least one group of taps so the
+    // horizontal pass never reads past it
+    std::vector<int16_t> blended(static_cast<size_t>(std::max(src.width, horizontal_.taps)) * 4);
+    std::vector<unsigned char> outputRow(narrow ? static_cast<size_t>(dst.width) * 4 : 0);
+
+    // 3-byte sources are widened one row at a time, each row once:
+    // consecutive output rows share at most their boundary rows, and every
+    // window of taps source rows maps to distinct ring slots
+    const int ringSize = widen ? vertical_.taps : 0;
+    std::vector<unsigned char> ring(static_cast<size_t>(ringSize) * valueCount);
+    std::vector<int> ringRows(ringSize, -1);
+    std::vector<const unsigned char *> rows(vertical_.taps);
+
+    for (int row = firstRow; row < endRow; ++row)
+    {
+        const int start = vertical_.starts[row];
+        // Only short sources have padding taps past the last row
+        const int tapRows = std::min(vertical_.taps, src.height - start);
+        for (int t = 0; t < tapRows; ++t)
+        {
+            const int srcY = start + t;
+            rows[t] = src.row(srcY);
+            if (widen)
+            {
+                const int slot = srcY % ringSize;
+                unsigned char *widened = &ring[static_cast<size_t>(slot) * valueCount];
+                if (ringRows[slot] != srcY)
+                {
+                    widen(rows[t], widened, src.width);
+                    ringRows[slot] = srcY;
+                }
+                rows[t] = widened;
+            }
+            rows[t] += sourceBegin * 4;
+        }
+        kernels.vertical(rows.data(), &vertical_.weights[static_cast<size_t>(row) * vertical_.taps], tapRows, blended.data() + sourceBegin * 4,
+                         (sourceEnd - sourceBegin) * 4);
+
+        unsigned char *out = narrow ? outputRow.data() : dst.row(row);
+        kernels.horizontal(blended.data(), out, horizontal_, firstColumn, endColumn - firstColumn);
+        if (narrow)
+        {
+            narrow(outputRow.data() + firstColumn * 4, dst.row(row) + firstColumn * dstBpp, endColumn - firstColumn);
+        }
+    }
+}
+
+std::shared_ptr<const Resampler> cachedResampler(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter)
+{
+    typedef std::tuple<int, int, int, int, ResampleFilter> Key;
+    // Monitors and layouts rarely change, so a handful of entries covers
+    // every capture; the cache starts over if geometry keeps changing
+    const size_t maxEntries = 32;
+    static std::mutex mutex;
+    static std::map<Key, std::shared_ptr<const Resampler>> cache;
+
+    Key key(srcWidth, srcHeight, dstWidth, dstHeight, filter);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto found = cache.find(key);
+        if (found != cache.end())
+        {
+            return found->second;
+        }
+    }
+
+    // Built outside the lock; a racing thread that built the same tables
+    // first wins
+    std::shared_ptr<const Resampler> resampler = std::make_shared<Resampler>(srcWidth, srcHeight, dstWidth, dstHeight, filter);
+    std::lock_guard<std::mutex> lock(mutex);
+    if (cache.size() >= maxEntries)
+    {
+        cache.clear();
+    }
+    return cache.emplace(key, resampler).first->second;
+}
+
+void resampleImage(const ImageView &src, const MutableImageView &dst, ResampleFilter filter, const ResampleKernels &kernels)
+{
+    if (src.empty() || dst.width <= 0 || dst.height <= 0)
+    {
+        return;
+    }
+    cachedResampler(src.width, src.height, dst.width, dst.height, filter)->resample(src, dst, kernels);
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "image.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Separable fixed-point resampler. The vertical pass runs first, so the
+// horizontal one only sees as many rows as the output has. Coefficients are
+// 14-bit fixed point, the rows in between keep 7 fractional bits per channel,
+// and every kernel set produces identical bytes.
+
+enum class ResampleFilter
+{
+    Box,      // area averaging: each output pixel is the mean of the source area it covers
+    Bilinear, // triangle filter
+    Bicubic,  // Catmull-Rom (Keys, a = -0.5)
+    Lanczos3
+};
+
+const char *resampleFilterName(ResampleFilter filter);
+
+// Parses "box", "bilinear", "bicubic" or "lanczos3"; false leaves filter as is
+bool parseResampleFilter(const std::string &name, ResampleFilter &filter);
+
+// Per-output weights along one axis. Output i reads taps source pixels from
+// starts[i]; its weights are weights[i * taps, (i + 1) * taps) and sum to
+// 1 << 14. When reducing, the filter is stretched over the source pixels one
+// output pixel covers, so it averages instead of skipping pixels. taps is
+// padded to a multiple of 4 with zero weights and starts are moved left where
+// needed, so the SIMD passes can read whole groups without running past the
+// end of a row.
+struct ResampleCoefficients
+{
+    int srcSize;
+    int dstSize;
+    int taps;
+    std::vector<int> starts;
+    std::vector<int16_t> weights;
+
+    ResampleCoefficients(int srcSize, int dstSize, ResampleFilter filter);
+};
+
+// Vertical pass: blends rowCount source rows of 4-byte pixels into
+// valueCount 8.7 fixed-point channel values
+typedef void (*ResampleRowBlender)(const unsigned char *const *rows, const int16_t *weights, int rowCount, int16_t *dst, int valueCount);
+
+// Horizontal pass: filters one blended row into the 4-byte output pixels
+// [first, first + count) of dst
+typedef void (*ResampleRowFilter)(const int16_t *src, unsigned char *dst, const ResampleCoefficients &coefficients, int first, int count);
+
+// Both passes, built for the same instruction set
+struct ResampleKernels
+{
+    const char *isa;
+    ResampleRowBlender vertical;
+    ResampleRowFilter horizontal;
+};
+
+// The fastest kernel set this CPU supports, picked once from cpuFeatures()
+const ResampleKernels &resampleKernels();
+
+// Every kernel set this CPU can run, scalar first (for benchmarks)
+std::vector<ResampleKernels> supportedResampleKernels();
+
+// Tap tables for one (source size, output size, filter) combination. Building
+// them is the only part of a resample that depends on geometry alone, so one
+// Resampler serves every capture of a monitor. The resample methods are const
+// and may run on several threads at once.
+class Resampler
+{
+public:
+    Resampler(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter);
+
+    int srcWidth() const { return horizontal_.srcSize; }
+    int srcHeight() const { return vertical_.srcSize; }
+    int dstWidth() const { return horizontal_.dstSize; }
+    int dstHeight() const { return vertical_.dstSize; }
+    ResampleFilter filter() const { return filter_; }
+
+    // Resample src to fill dst (typically a canvas region). The sizes must
+    // match the ones the tables were built for. src may be in any
+    // PixelFormat and is filtered in packedFormat(src.format); dst is
+    // written in that format or in any format rowConverter() reaches from it.
+    void resample(const ImageView &src, const MutableImageView &dst, const ResampleKernels &kernels = resampleKernels()) const;
+
+    // Only output rows [firstRow, firstRow + rowCount) of dst, so bands of
+    // one image can be resampled on different threads
+    void resampleRows(const ImageView &src, const MutableImageView &dst, int firstRow, int rowCount,
+                      const ResampleKernels &kernels = resampleKernels()) const;
+
+    // Only the output rectangle (x, y, width, height) of dst, for the parts
+    // of an image that other images do not cover. Reads just the source
+    // columns that rectangle needs.
+    void resampleRect(const ImageView &src, const MutableImageView &dst, int x, int y, int width, int height,
+                      const ResampleKernels &kernels = resampleKernels()) const;
+
+private:
+    ResampleFilter filter_;
+    ResampleCoefficients horizontal_;
+    ResampleCoefficients vertical_;
+};
+
+// The Resampler for this geometry and filter, built on first use and kept
+// for later captures. Thread-safe.
+std::shared_ptr<const Resampler> cachedResampler(int srcWidth, int srcHeight, int dstWidth, int dstHeight, ResampleFilter filter);
+
+// Resample src to fill dst through the cached Resampler for their sizes
+void resampleImage(const ImageView &src, const MutableImageView &dst, ResampleFilter filter = ResampleFilter::Box,
+                   const ResampleKernels &kernels = resampleKernels());
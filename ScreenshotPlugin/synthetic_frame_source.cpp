@@ -0,0 +1,472 @@
+#include "frame_source.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <sstream>
+
+// Headless desktop generator. Every monitor is rendered once, on first
+// acquire, from (seed, monitor index) so repeated runs produce identical
+// pixels. The content deliberately mixes the three things that dominate real
+// screenshots: flat UI with lots of small text, smooth gradients and noisy
+// photographic regions.
+
+namespace
+{
+
+struct Rgb
+{
+    unsigned char r, g, b;
+};
+
+uint32_t hash3(uint32_t x, uint32_t y, uint32_t seed)
+{
+    uint32_t h = x * 0x8da6b343u ^ y * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 15;
+    h *= 0x2c1b3c6du;
+    h ^= h >> 12;
+    h *= 0x297a2d39u;
+    h ^= h >> 15;
+    return h;
+}
+
+class Rng
+{
+public:
+    explicit Rng(uint32_t seed) : state_(seed ? seed : 0x9e3779b9u) {}
+
+    uint32_t next()
+    {
+        state_ ^= state_ << 13;
+        state_ ^= state_ >> 17;
+        state_ ^= state_ << 5;
+        return state_;
+    }
+
+    int range(int lo, int hi) { return lo + static_cast<int>(next() % static_cast<uint32_t>(hi - lo + 1)); }
+
+    Rgb colour(int lo, int hi)
+    {
+        Rgb c = {static_cast<unsigned char>(range(lo, hi)), static_cast<unsigned char>(range(lo, hi)),
+                 static_cast<unsigned char>(range(lo, hi))};
+        return c;
+    }
+
+private:
+    uint32_t state_;
+};
+
+unsigned char clampByte(int v)
+{
+    return static_cast<unsigned char>(v < 0 ? 0 : (v > 255 ? 255 : v));
+}
+
+class Canvas
+{
+public:
+    Canvas(unsigned char *pixels, int width, int height, int stride, PixelFormat format)
+        : pixels_(pixels), width_(width), height_(height), stride_(stride), bpp_(bytesPerPixel(format))
+    {
+        bool rgbOrder = format == PixelFormat::RGBA8 || format == PixelFormat::RGB8;
+        redIndex_ = rgbOrder ? 0 : 2;
+        blueIndex_ = rgbOrder ? 2 : 0;
+        // BGRX sources leave the padding byte at zero, like most X servers do
+        fourthByte_ = format == PixelFormat::BGRX8 ? 0 : 255;
+    }
+
+    int width() const { return width_; }
+    int height() const { return height_; }
+
+    void set(int x, int y, Rgb c)
+    {
+        unsigned char *p = pixels_ + static_cast<size_t>(y) * stride_ + static_cast<size_t>(x) * bpp_;
+        p[redIndex_] = c.r;
+        p[1] = c.g;
+        p[blueIndex_] = c.b;
+        if (bpp_ == 4)
+        {
+            p[3] = fourthByte_;
+        }
+    }
+
+    void fillRect(int x, int y, int w, int h, Rgb c)
+    {
+        int x0 = std::max(x, 0);
+        int y0 = std::max(y, 0);
+        int x1 = std::min(x + w, width_);
+        int y1 = std::min(y + h, height_);
+        for (int py = y0; py < y1; ++py)
+        {
+            for (int px = x0; px < x1; ++px)
+            {
+                set(px, py, c);
+            }
+        }
+    }
+
+    bool contains(int x, int y) const { return x >= 0 && y >= 0 && x < width_ && y < height_; }
+
+private:
+    unsigned char *pixels_;
+    int width_;
+    int height_;
+    int stride_;
+    int bpp_;
+    int redIndex_;
+    int blueIndex_;
+    unsigned char fourthByte_;
+};
+
+struct Rect
+{
+    int x, y, w, h;
+};
+
+// Pseudo-font: a fixed alphabet of 5x7 glyphs so that, like real text, the
+// same shapes repeat all over the screen.
+const int kGlyphCount = 48;
+const int kGlyphCols = 5;
+const int kGlyphRows = 7;
+
+uint64_t glyphBits(int glyph)
+{
+    uint64_t bits = (static_cast<uint64_t>(hash3(glyph, 17, 3)) << 32) | hash3(glyph, 91, 7);
+    bits &= (1ull << (kGlyphCols * kGlyphRows)) - 1;
+    // Give roughly half the glyphs a vertical stem so they read as letters
+    if (glyph & 1)
+    {
+        for (int row = 0; row < kGlyphRows; ++row)
+        {
+            bits |= 1ull << (row * kGlyphCols);
+        }
+    }
+    return bits;
+}
+
+// Draws one line of pseudo-words starting at (x, y) and returns the x after
+// the last glyph
+int drawTextLine(Canvas &canvas, int x, int y, int maxWidth, int pixelSize, const Rgb *palette, int paletteSize, Rng &rng)
+{
+    const int cellWidth = (kGlyphCols + 1) * pixelSize;
+    int cursor = x;
+    int end = x + maxWidth;
+    Rgb colour = palette[0];
+    while (cursor + cellWidth < end)
+    {
+        int wordLength = rng.range(1, 9);
+        if (paletteSize > 1 && rng.range(0, 3) == 0)
+        {
+            colour = palette[rng.range(0, paletteSize - 1)];
+        }
+        for (int i = 0; i < wordLength && cursor + cellWidth < end; ++i)
+        {
+            uint64_t bits = glyphBits(rng.range(0, kGlyphCount - 1));
+            for (int gy = 0; gy < kGlyphRows; ++gy)
+            {
+                for (int gx = 0; gx < kGlyphCols; ++gx)
+                {
+                    if (bits & (1ull << (gy * kGlyphCols + gx)))
+                    {
+                        canvas.fillRect(cursor + gx * pixelSize, y + gy * pixelSize, pixelSize, pixelSize, colour);
+                    }
+                }
+            }
+            cursor += cellWidth;
+        }
+        cursor += cellWidth; // space
+        if (rng.range(0, 11) == 0)
+        {
+            break; // ragged line end
+        }
+    }
+    return cursor;
+}
+
+float lattice(int x, int y, uint32_t seed)
+{
+    return static_cast<float>(hash3(static_cast<uint32_t>(x), static_cast<uint32_t>(y), seed) >> 8) / 16777216.0f;
+}
+
+float valueNoise(float x, float y, uint32_t seed)
+{
+    int xi = static_cast<int>(std::floor(x));
+    int yi = static_cast<int>(std::floor(y));
+    float fx = x - xi;
+    float fy = y - yi;
+    fx = fx * fx * (3.0f - 2.0f * fx);
+    fy = fy * fy * (3.0f - 2.0f * fy);
+    float top = lattice(xi, yi, seed) + (lattice(xi + 1, yi, seed) - lattice(xi, yi, seed)) * fx;
+    float bottom = lattice(xi, yi + 1, seed) + (lattice(xi + 1, yi + 1, seed) - lattice(xi, yi + 1, seed)) * fx;
+    return top + (bottom - top) * fy;
+}
+
+void drawWallpaper(Canvas &canvas, Rng &rng)
+{
+    Rgb from = rng.colour(10, 120);
+    Rgb to = rng.colour(90, 230);
+    float w = static_cast<float>(canvas.width());
+    float h = static_cast<float>(canvas.height());
+    for (int y = 0; y < canvas.height(); ++y)
+    {
+        for (int x = 0; x < canvas.width(); ++x)
+        {
+            float t = 0.65f * x / w + 0.35f * y / h;
+            float dx = x / w - 0.5f;
+            float dy = y / h - 0.5f;
+            float vignette = 1.0f - 0.5f * (dx * dx + dy * dy);
+            Rgb c = {clampByte(static_cast<int>((from.r + (to.r - from.r) * t) * vignette)),
+                     clampByte(static_cast<int>((from.g + (to.g - from.g) * t) * vignette)),
+                     clampByte(static_cast<int>((from.b + (to.b - from.b) * t) * vignette))};
+            canvas.set(x, y, c);
+        }
+    }
+}
+
+void drawPhoto(Canvas &canvas, const Rect &area, uint32_t seed, float scale)
+{
+    float baseFrequency = 1.0f / (180.0f * scale);
+    for (int y = std::max(area.y, 0); y < std::min(area.y + area.h, canvas.height()); ++y)
+    {
+        for (int x = std::max(area.x, 0); x < std::min(area.x + area.w, canvas.width()); ++x)
+        {
+            float n = 0.0f;
+            float amplitude = 0.5f;
+            float frequency = baseFrequency;
+            for (int octave = 0; octave < 4; ++octave)
+            {
+                n += amplitude * valueNoise(x * frequency, y * frequency, seed + octave);
+                amplitude *= 0.5f;
+                frequency *= 2.0f;
+            }
+            float horizon = static_cast<float>(y - area.y) / area.h;
+            int grain = static_cast<int>(hash3(x, y, seed ^ 0x51u) & 15) - 8;
+            Rgb c = {clampByte(static_cast<int>(40 + 170 * n * (0.6f + horizon)) + grain),
+                     clampByte(static_cast<int>(70 + 150 * n) + grain),
+                     clampByte(static_cast<int>(200 - 140 * horizon * n) + grain)};
+            canvas.set(x, y, c);
+        }
+    }
+}
+
+void drawEditor(Canvas &canvas, const Rect &client, Rng &rng, int pixelSize, bool dark)
+{
+    Rgb background = dark ? Rgb{30, 30, 34} : Rgb{250, 250, 250};
+    Rgb sidebar = dark ? Rgb{37, 37, 42} : Rgb{236, 236, 240};
+    Rgb gutter = dark ? Rgb{110, 110, 120} : Rgb{150, 150, 160};
+    const Rgb syntaxDark[] = {{212, 212, 212}, {86, 156, 214}, {206, 145, 120}, {106, 153, 85}, {197, 134, 192}};
+    const Rgb syntaxLight[] = {{30, 30, 30}, {0, 0, 255}, {163, 21, 21}, {0, 128, 0}, {175, 0, 219}};
+    const Rgb *syntax = dark ? syntaxDark : syntaxLight;
+
+    canvas.fillRect(client.x, client.y, client.w, client.h, background);
+    int sidebarWidth = std::min(client.w / 4, 220 * pixelSize);
+    canvas.fillRect(client.x, client.y, sidebarWidth, client.h, sidebar);
+
+    const int lineHeight = 11 * pixelSize;
+    Rgb sidebarText[] = {gutter};
+    for (int y = client.y + 6 * pixelSize; y + lineHeight < client.y + client.h; y += lineHeight + 2 * pixelSize)
+    {
+        int indent = rng.range(1, 3) * 6 * pixelSize;
+        drawTextLine(canvas, client.x + indent, y, sidebarWidth - indent - 4 * pixelSize, pixelSize, sidebarText, 1, rng);
+    }
+
+    int codeX = client.x + sidebarWidth + 40 * pixelSize;
+    int indent = 0;
+    for (int y = client.y + 6 * pixelSize; y + lineHeight < client.y + client.h; y += lineHeight)
+    {
+        Rgb numberColour[] = {gutter};
+        Rng numberRng(static_cast<uint32_t>(y));
+        drawTextLine(canvas, client.x + sidebarWidth + 4 * pixelSize, y, 30 * pixelSize, pixelSize, numberColour, 1, numberRng);
+        if (rng.range(0, 6) == 0)
+        {
+            continue; // blank line
+        }
+        indent = std::max(0, std::min(6, indent + rng.range(-1, 1)));
+        int x = codeX + indent * 4 * 6 * pixelSize;
+        drawTextLine(canvas, x, y, client.x + client.w - x, pixelSize, syntax, 5, rng);
+    }
+}
+
+void drawTerminal(Canvas &canvas, const Rect &client, Rng &rng, int pixelSize)
+{
+    canvas.fillRect(client.x, client.y, client.w, client.h, Rgb{12, 12, 12});
+    const Rgb colours[] = {{204, 204, 204}, {78, 201, 176}, {229, 229, 16}, {204, 204, 204}};
+    const int lineHeight = 10 * pixelSize;
+    for (int y = client.y + 4 * pixelSize; y + lineHeight < client.y + client.h; y += lineHeight)
+    {
+        drawTextLine(canvas, client.x + 4 * pixelSize, y, client.w - 8 * pixelSize, pixelSize, colours, 4, rng);
+    }
+}
+
+void drawDashboard(Canvas &canvas, const Rect &client, Rng &rng, int pixelSize)
+{
+    canvas.fillRect(client.x, client.y, client.w, client.h, Rgb{244, 246, 250});
+    const Rgb label[] = {{60, 64, 72}};
+    int cardWidth = client.w / 3;
+    int cardHeight = client.h / 2;
+    for (int row = 0; row < 2; ++row)
+    {
+        for (int col = 0; col < 3; ++col)
+        {
+            Rect card = {client.x + col * cardWidth + 8 * pixelSize, client.y + row * cardHeight + 8 * pixelSize,
+                         cardWidth - 16 * pixelSize, cardHeight - 16 * pixelSize};
+            canvas.fillRect(card.x, card.y, card.w, card.h, Rgb{255, 255, 255});
+            drawTextLine(canvas, card.x + 8 * pixelSize, card.y + 8 * pixelSize, card.w / 2, pixelSize, label, 1, rng);
+
+            // Bar chart with vertical gradients
+            Rgb top = rng.colour(40, 220);
+            int bars = rng.range(6, 14);
+            int chartTop = card.y + 28 * pixelSize;
+            int chartHeight = card.h - 36 * pixelSize;
+            int barWidth = std::max(1, (card.w - 16 * pixelSize) / (bars * 2));
+            for (int b = 0; b < bars && chartHeight > 0; ++b)
+            {
+                int barHeight = rng.range(chartHeight / 6, chartHeight);
+                int bx = card.x + 8 * pixelSize + b * barWidth * 2;
+                for (int y = 0; y < barHeight; ++y)
+                {
+                    float t = static_cast<float>(y) / barHeight;
+                    Rgb c = {clampByte(static_cast<int>(top.r * (1.0f - 0.5f * t))),
+                             clampByte(static_cast<int>(top.g * (1.0f - 0.5f * t))),
+                             clampByte(static_cast<int>(top.b * (1.0f - 0.5f * t)))};
+                    canvas.fillRect(bx, chartTop + chartHeight - barHeight + y, barWidth, 1, c);
+                }
+            }
+        }
+    }
+}
+
+void drawWindow(Canvas &canvas, const Rect &frame, int kind, Rng &rng, uint32_t seed, float scale, int pixelSize)
+{
+    int titleHeight = std::max(1, static_cast<int>(30 * scale));
+    Rgb border = {90, 90, 96};
+    canvas.fillRect(frame.x - 1, frame.y - 1, frame.w + 2, frame.h + 2, border);
+    canvas.fillRect(frame.x, frame.y, frame.w, titleHeight, Rgb{222, 224, 228});
+    const Rgb titleColour[] = {{40, 40, 40}};
+    drawTextLine(canvas, frame.x + 10 * pixelSize, frame.y + (titleHeight - 7 * pixelSize) / 2, frame.w / 3, pixelSize, titleColour, 1, rng);
+    const Rgb buttons[] = {{255, 95, 87}, {254, 188, 46}, {40, 200, 64}};
+    for (int i = 0; i < 3; ++i)
+    {
+        int size = titleHeight / 2;
+        canvas.fillRect(frame.x + frame.w - (3 - i) * (size + size / 2) - size, frame.y + size / 2, size, size, buttons[i]);
+    }
+
+    Rect client = {frame.x, frame.y + titleHeight, frame.w, frame.h - titleHeight};
+    switch (kind)
+    {
+    case 0:
+        drawEditor(canvas, client, rng, pixelSize, rng.range(0, 1) == 0);
+        break;
+    case 1:
+        drawTerminal(canvas, client, rng, pixelSize);
+        break;
+    case 2:
+        drawPhoto(canvas, client, seed, scale);
+        break;
+    default:
+        drawDashboard(canvas, client, rng, pixelSize);
+        break;
+    }
+}
+
+void renderDesktop(Canvas &canvas, uint32_t seed, size_t monitorIndex)
+{
+    uint32_t monitorSeed = hash3(seed, static_cast<uint32_t>(monitorIndex), 0x5eed);
+    Rng rng(monitorSeed);
+    float scale = canvas.height() / 1080.0f;
+    int pixelSize = std::max(1, static_cast<int>(scale + 0.5f));
+
+    drawWallpaper(canvas, rng);
+
+    // At least a row, or the taskbar icons below would never advance
+    int taskbarHeight = std::max(1, static_cast<int>(40 * scale));
+    int desktopHeight = canvas.height() - taskbarHeight;
+
+    // Every monitor gets one photo window plus a rotating mix of UI windows
+    int windowCount = rng.range(3, 4);
+    for (int i = 0; i < windowCount; ++i)
+    {
+        int kind = i == 1 ? 2 : static_cast<int>((monitorIndex + i) % 4);
+        if (kind == 2 && i != 1)
+        {
+            kind = 0;
+        }
+        int w = rng.range(canvas.width() * 35 / 100, canvas.width() * 70 / 100);
+        int h = rng.range(desktopHeight * 40 / 100, desktopHeight * 80 / 100);
+        Rect frame = {rng.range(0, canvas.width() - w), rng.range(0, desktopHeight - h), w, h};
+        drawWindow(canvas, frame, kind, rng, monitorSeed + i, scale, pixelSize);
+    }
+
+    canvas.fillRect(0, desktopHeight, canvas.width(), taskbarHeight, Rgb{32, 34, 40});
+    for (int x = taskbarHeight / 4, i = 0; x + taskbarHeight < canvas.width() / 2; x += taskbarHeight, ++i)
+    {
+        Rgb icon = rng.colour(60, 250);
+        canvas.fillRect(x, desktopHeight + taskbarHeight / 4, taskbarHeight / 2, taskbarHeight / 2, icon);
+    }
+    const Rgb clock[] = {{230, 230, 230}};
+    drawTextLine(canvas, canvas.width() - 120 * pixelSize, desktopHeight + (taskbarHeight - 7 * pixelSize) / 2, 100 * pixelSize, pixelSize, clock, 1, rng);
+}
+
+class SyntheticFrameSource : public FrameSource
+{
+public:
+    explicit SyntheticFrameSource(const SyntheticDesktopConfig &config)
+        : config_(config), frames_(static_cast<size_t>(std::max(config.monitorCount, 0)))
+    {
+    }
+
+    const char *name() const override { return "synthetic"; }
+
+    std::vector<OutputInfo> enumerateOutputs() override
+    {
+        std::vector<OutputInfo> outputs;
+        for (int i = 0; i < config_.monitorCount; ++i)
+        {
+            OutputInfo output;
+            std::ostringstream name;
+            name << "SYNTHETIC-" << i;
+            output.name = name.str();
+            output.x = i * config_.width;
+            output.y = 0;
+            output.width = config_.width;
+            output.height = config_.height;
+            output.primary = i == 0;
+            outputs.push_back(output);
+        }
+        return outputs;
+    }
+
+    bool acquireFrame(size_t outputIndex, CapturedFrame &frame) override
+    {
+        if (outputIndex >= frames_.size())
+        {
+            return false;
+        }
+
+        int stride = config_.width * bytesPerPixel(config_.format);
+        std::vector<unsigned char> &pixels = frames_[outputIndex];
+        if (pixels.empty())
+        {
+            pixels.resize(static_cast<size_t>(stride) * config_.height);
+            Canvas canvas(pixels.data(), config_.width, config_.height, stride, config_.format);
+            renderDesktop(canvas, config_.seed, outputIndex);
+        }
+
+        frame.width = config_.width;
+        frame.height = config_.height;
+        frame.stride = stride;
+        frame.format = config_.format;
+        frame.pixels = pixels.data();
+        return true;
+    }
+
+private:
+    SyntheticDesktopConfig config_;
+    std::vector<std::vector<unsigned char>> frames_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> createSyntheticFrameSource(const SyntheticDesktopConfig &config)
+{
+    return std::unique_ptr<FrameSource>(new SyntheticFrameSource(config));
+}
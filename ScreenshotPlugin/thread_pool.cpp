@@ -0,0 +1,177 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+namespace
+{
+
+// Contiguous run of indices owned by one participant; the owner takes from
+// the front, thieves from the back
+struct Slice
+{
+    std::mutex mutex;
+    size_t begin = 0;
+    size_t end = 0;
+};
+
+} // namespace
+
+struct ThreadPool::Job
+{
+    const std::function<void(size_t)> *fn = nullptr;
+    std::unique_ptr<Slice[]> slices;
+    size_t sliceCount = 0;
+    size_t joined = 0; // guarded by ThreadPool::mutex_
+    size_t maxParticipants = 0;
+    std::atomic<size_t> remaining{0};
+    std::mutex doneMutex;
+    std::condition_variable done;
+};
+
+ThreadPool::ThreadPool(int threadCount) : stopping_(false)
+{
+    for (int i = 1; i < threadCount; ++i)
+    {
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (auto &worker : workers_)
+    {
+        worker.join();
+    }
+}
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &fn, int maxThreads)
+{
+    size_t participants = static_cast<size_t>(threadCount());
+    if (maxThreads > 0)
+    {
+        participants = std::min(participants, static_cast<size_t>(maxThreads));
+    }
+    participants = std::min(participants, count);
+    if (participants <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            fn(i);
+        }
+        return;
+    }
+
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->fn = &fn;
+    job->sliceCount = participants;
+    job->slices.reset(new Slice[participants]);
+    for (size_t s = 0; s < participants; ++s)
+    {
+        job->slices[s].begin = count * s / participants;
+        job->slices[s].end = count * (s + 1) / participants;
+    }
+    job->remaining = count;
+    job->maxParticipants = participants;
+    job->joined = 1; // the calling thread owns slice 0
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.push_back(job);
+    }
+    wake_.notify_all();
+
+    runTasks(*job, 0);
+    {
+        std::unique_lock<std::mutex> lock(job->doneMutex);
+        job->done.wait(lock, [&]() { return job->remaining == 0; });
+    }
+
+    // Workers that still hold the job find every slice empty and move on
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+}
+
+void ThreadPool::runTasks(Job &job, size_t home)
+{
+    for (;;)
+    {
+        size_t index = 0;
+        bool claimed = false;
+        for (size_t k = 0; k < job.sliceCount && !claimed; ++k)
+        {
+            Slice &slice = job.slices[(home + k) % job.sliceCount];
+            std::lock_guard<std::mutex> lock(slice.mutex);
+            if (slice.begin < slice.end)
+            {
+                index = k == 0 ? slice.begin++ : --slice.end;
+                claimed = true;
+            }
+        }
+        if (!claimed)
+        {
+            return;
+        }
+
+        (*job.fn)(index);
+        if (job.remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(job.doneMutex);
+            job.done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::workerLoop()
+{
+    for (;;)
+    {
+        std::shared_ptr<Job> job;
+        size_t home = 0;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [&]() {
+                if (stopping_)
+                {
+                    return true;
+                }
+                for (const auto &candidate : jobs_)
+                {
+                    if (candidate->joined < candidate->maxParticipants)
+                    {
+                        job = candidate;
+                        home = job->joined++;
+                        return true;
+                    }
+                }
+                return false;
+            });
+            if (!job)
+            {
+                return;
+            }
+        }
+        runTasks(*job, home);
+    }
+}
+
+ThreadPool &ThreadPool::shared()
+{
+    // Never destroyed: joining workers from the static destructors of an
+    // unloading DLL can deadlock at process exit
+    static ThreadPool *pool = []() {
+        int threads = static_cast<int>(std::thread::hardware_concurrency());
+        const char *requested = std::getenv("SCREENSHOT_THREADS");
+        if (requested && std::atoi(requested) > 0)
+        {
+            threads = std::atoi(requested);
+        }
+        return new ThreadPool(std::max(threads, 1));
+    }();
+    return *pool;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. parallelFor() splits
+// its index range into one slice per participating thread; a thread that
+// runs out of work steals from the back of the other slices, so bands of
+// uneven cost (monitors of different sizes, insets next to a full-screen
+// copy) still finish together. The calling thread always participates, which
+// also makes nested or concurrent parallelFor() calls safe.
+class ThreadPool
+{
+public:
+    // threadCount counts the calling thread, so a pool of 1 runs everything
+    // inline
+    explicit ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    int threadCount() const { return static_cast<int>(workers_.size()) + 1; }
+
+    // Runs fn(i) for every i in [0, count) and returns once all calls have
+    // finished. maxThreads caps the threads taking part (0 = all of them).
+    void parallelFor(size_t count, const std::function<void(size_t)> &fn, int maxThreads = 0);
+
+    // Process-wide pool with one thread per core, or SCREENSHOT_THREADS=<n>
+    // threads; created on first use
+    static ThreadPool &shared();
+
+private:
+    struct Job;
+
+    void workerLoop();
+    static void runTasks(Job &job, size_t home);
+
+    std::vector<std::thread> workers_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::shared_ptr<Job>> jobs_;
+    bool stopping_;
+};
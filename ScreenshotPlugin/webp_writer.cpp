@@ -0,0 +1,100 @@
+#include "webp_writer.h"
+
+#include <algorithm>
+#include <iostream>
+
+#if defined(SCREENSHOT_HAVE_WEBP)
+#include <webp/encode.h>
+
+namespace
+{
+
+// Writer that appends the encoder's output to the vector in custom_ptr
+int appendToVector(const uint8_t *data, size_t size, const WebPPicture *picture)
+{
+    std::vector<unsigned char> *out = static_cast<std::vector<unsigned char> *>(picture->custom_ptr);
+    out->insert(out->end(), data, data + size);
+    return 1;
+}
+
+// Import the pixels with the importer for format, which converts them into
+// the picture's own ARGB or YUV planes
+bool importPixels(WebPPicture &picture, const unsigned char *pixels, int stride, PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::BGRA8:
+        return WebPPictureImportBGRA(&picture, pixels, stride) != 0;
+    case PixelFormat::BGRX8:
+        return WebPPictureImportBGRX(&picture, pixels, stride) != 0;
+    case PixelFormat::BGR8:
+        return WebPPictureImportBGR(&picture, pixels, stride) != 0;
+    case PixelFormat::RGBA8:
+        return WebPPictureImportRGBA(&picture, pixels, stride) != 0;
+    case PixelFormat::RGB8:
+        return WebPPictureImportRGB(&picture, pixels, stride) != 0;
+    }
+    return false;
+}
+
+} // namespace
+
+bool webpAvailable()
+{
+    return true;
+}
+
+bool encodeWebp(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, const WebpOptions &options,
+                std::vector<unsigned char> &out, int threads)
+{
+    out.clear();
+    WebPConfig config;
+    if (!WebPConfigInit(&config))
+    {
+        std::cerr << "libwebp: version mismatch" << std::endl;
+        return false;
+    }
+    config.lossless = options.lossless ? 1 : 0;
+    config.quality = std::min(std::max(options.quality, 0.0f), 100.0f);
+    config.method = std::min(std::max(options.method, 0), 6);
+    config.thread_level = threads == 1 ? 0 : 1;
+    // Lossless: keep the RGB under fully transparent pixels, as PNG does
+    config.exact = 1;
+
+    WebPPicture picture;
+    if (!WebPPictureInit(&picture))
+    {
+        std::cerr << "libwebp: version mismatch" << std::endl;
+        return false;
+    }
+    picture.use_argb = config.lossless;
+    picture.width = width;
+    picture.height = height;
+    picture.writer = appendToVector;
+    picture.custom_ptr = &out;
+
+    bool ok = WebPValidateConfig(&config) && importPixels(picture, pixels, stride, format) && WebPEncode(&config, &picture);
+    if (!ok)
+    {
+        std::cerr << "libwebp: encoding failed (error " << picture.error_code << ")" << std::endl;
+        out.clear();
+    }
+    WebPPictureFree(&picture);
+    return ok;
+}
+
+#else
+
+bool webpAvailable()
+{
+    return false;
+}
+
+bool encodeWebp(const unsigned char *, int, int, int, PixelFormat, const WebpOptions &, std::vector<unsigned char> &out, int)
+{
+    std::cerr << "WebP output needs libwebp, which this build was configured without (SCREENSHOT_WEBP)" << std::endl;
+    out.clear();
+    return false;
+}
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "frame_source.h"
+
+#include <vector>
+
+struct WebpOptions
+{
+    bool lossless;
+
+    // Lossy: quality 0-100. Lossless: compression effort 0-100, libwebp's own
+    // meaning of quality in that mode (more effort, smaller file).
+    float quality;
+
+    // 0 (fastest) to 6 (smallest)
+    int method;
+
+    WebpOptions() : lossless(true), quality(50), method(0) {}
+};
+
+// Whether this build has libwebp (SCREENSHOT_WEBP)
+bool webpAvailable();
+
+// WebP encoder over libwebp's advanced API that reads capture and compositor
+// buffers as they are: any PixelFormat, any row stride. 4-byte formats keep
+// their alpha (BGRX as opaque), 3-byte formats are opaque. Lossy output
+// spreads its analysis over a second thread unless threads is 1. False, with
+// a message, on failure or when the build lacks libwebp.
+bool encodeWebp(const unsigned char *pixels, int width, int height, int stride, PixelFormat format, const WebpOptions &options,
+                std::vector<unsigned char> &out, int threads = 0);
@@ -0,0 +1,315 @@
+#include "frame_source.h"
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#if defined(SCREENSHOT_HAVE_XRANDR)
+#include <X11/extensions/Xrandr.h>
+#endif
+
+#include <sys/ipc.h>
+#include <sys/shm.h>
+
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+
+bool xErrorRaised = false;
+
+int recordXError(Display *, XErrorEvent *)
+{
+    xErrorRaised = true;
+    return 0;
+}
+
+// Captures X11 outputs with MIT-SHM. Each output owns a shared-memory XImage
+// that lives as long as the output does, including across enumerations that
+// leave its geometry alone, so a capture is a single server-side copy into
+// memory this process already maps and the frame handed to the pipeline
+// points straight at it. Monitors come from XRandR (one per CRTC monitor) on
+// every X screen, so a multi-screen Xvfb exposes each screen as an output.
+// Displays without MIT-SHM fall back to XGetImage.
+class X11FrameSource : public FrameSource
+{
+public:
+    explicit X11FrameSource(Display *display) : display_(display)
+    {
+        int major = 0;
+        int minor = 0;
+        Bool pixmaps = False;
+        useShm_ = XShmQueryExtension(display_) && XShmQueryVersion(display_, &major, &minor, &pixmaps);
+        if (!useShm_)
+        {
+            std::cerr << "MIT-SHM is not available, falling back to XGetImage" << std::endl;
+        }
+    }
+
+    ~X11FrameSource() override
+    {
+        releaseOutputs(outputs_);
+        XCloseDisplay(display_);
+    }
+
+    const char *name() const override { return useShm_ ? "x11-shm" : "x11"; }
+
+    std::vector<OutputInfo> enumerateOutputs() override
+    {
+        std::vector<Output> previous;
+        previous.swap(outputs_);
+
+        for (int screen = 0; screen < ScreenCount(display_); ++screen)
+        {
+            size_t before = outputs_.size();
+#if defined(SCREENSHOT_HAVE_XRANDR)
+            addRandrMonitors(screen);
+#endif
+            if (outputs_.size() == before)
+            {
+                // No RandR: the whole X screen is one output
+                Output output;
+                std::ostringstream name;
+                name << DisplayString(display_) << "." << screen;
+                output.info.name = name.str();
+                output.info.width = DisplayWidth(display_, screen);
+                output.info.height = DisplayHeight(display_, screen);
+                output.info.primary = screen == DefaultScreen(display_);
+                output.screen = screen;
+                outputs_.push_back(output);
+            }
+        }
+
+        // An output whose geometry has not changed keeps its image, and with
+        // it the shared segment, so repeated captures attach only once
+        for (size_t i = 0; i < outputs_.size(); ++i)
+        {
+            for (size_t j = 0; j < previous.size(); ++j)
+            {
+                if (previous[j].image && sameGeometry(previous[j], outputs_[i]))
+                {
+                    outputs_[i].image = previous[j].image;
+                    outputs_[i].shm = previous[j].shm;
+                    previous[j].image = nullptr;
+                    previous[j].shm = XShmSegmentInfo();
+                    break;
+                }
+            }
+        }
+        releaseOutputs(previous);
+
+        std::vector<OutputInfo> infos;
+        for (size_t i = 0; i < outputs_.size(); ++i)
+        {
+            infos.push_back(outputs_[i].info);
+        }
+        return infos;
+    }
+
+    bool acquireFrame(size_t outputIndex, CapturedFrame &frame) override
+    {
+        if (outputIndex >= outputs_.size())
+        {
+            return false;
+        }
+        // Xlib connections are not thread-safe; the pixel conversion that
+        // follows in the caller still runs concurrently
+        std::lock_guard<std::mutex> lock(mutex_);
+        Output &output = outputs_[outputIndex];
+        Window root = RootWindow(display_, output.screen);
+
+        if (useShm_ && !output.image)
+        {
+            attachSharedImage(output);
+        }
+
+        // A request the server rejects (BadMatch when the output no longer
+        // fits the root window) would otherwise reach the default handler,
+        // which exits the process
+        xErrorRaised = false;
+        XErrorHandler previous = XSetErrorHandler(recordXError);
+        bool captured;
+        if (output.shm.shmaddr)
+        {
+            captured = XShmGetImage(display_, root, output.image, output.info.x, output.info.y, AllPlanes);
+        }
+        else
+        {
+            if (output.image)
+            {
+                XDestroyImage(output.image);
+            }
+            output.image = XGetImage(display_, root, output.info.x, output.info.y, output.info.width, output.info.height, AllPlanes, ZPixmap);
+            captured = output.image != nullptr;
+        }
+        XSync(display_, False);
+        XSetErrorHandler(previous);
+
+        if (!captured || xErrorRaised)
+        {
+            std::cerr << (output.shm.shmaddr ? "XShmGetImage" : "XGetImage") << " failed for " << output.info.name << std::endl;
+            if (!output.shm.shmaddr && output.image)
+            {
+                XDestroyImage(output.image);
+                output.image = nullptr;
+            }
+            return false;
+        }
+
+        XImage *image = output.image;
+        if (image->bits_per_pixel != 32 || image->byte_order != LSBFirst || image->red_mask != 0xff0000 || image->blue_mask != 0xff)
+        {
+            std::cerr << "Unsupported X11 visual (" << image->bits_per_pixel << " bpp, depth " << image->depth << ")" << std::endl;
+            return false;
+        }
+
+        frame.width = image->width;
+        frame.height = image->height;
+        frame.stride = image->bytes_per_line;
+        frame.format = PixelFormat::BGRX8;
+        frame.pixels = reinterpret_cast<const unsigned char *>(image->data);
+        return true;
+    }
+
+private:
+    struct Output
+    {
+        OutputInfo info;
+        int screen = 0;
+        XImage *image = nullptr;
+        XShmSegmentInfo shm = XShmSegmentInfo();
+    };
+
+#if defined(SCREENSHOT_HAVE_XRANDR)
+    void addRandrMonitors(int screen)
+    {
+        int eventBase = 0;
+        int errorBase = 0;
+        int major = 0;
+        int minor = 0;
+        if (!XRRQueryExtension(display_, &eventBase, &errorBase) || !XRRQueryVersion(display_, &major, &minor) ||
+            major < 1 || (major == 1 && minor < 5))
+        {
+            return;
+        }
+
+        int count = 0;
+        XRRMonitorInfo *monitors = XRRGetMonitors(display_, RootWindow(display_, screen), True, &count);
+        for (int i = 0; i < count; ++i)
+        {
+            Output output;
+            char *atomName = XGetAtomName(display_, monitors[i].name);
+            output.info.name = atomName ? atomName : "";
+            if (atomName)
+            {
+                XFree(atomName);
+            }
+            output.info.x = monitors[i].x;
+            output.info.y = monitors[i].y;
+            output.info.width = monitors[i].width;
+            output.info.height = monitors[i].height;
+            output.info.primary = monitors[i].primary != 0;
+            output.screen = screen;
+            outputs_.push_back(output);
+        }
+        if (monitors)
+        {
+            XRRFreeMonitors(monitors);
+        }
+    }
+#endif
+
+    static bool sameGeometry(const Output &a, const Output &b)
+    {
+        return a.screen == b.screen && a.info.x == b.info.x && a.info.y == b.info.y && a.info.width == b.info.width &&
+               a.info.height == b.info.height;
+    }
+
+    bool attachSharedImage(Output &output)
+    {
+        int screen = output.screen;
+        XImage *image = XShmCreateImage(display_, DefaultVisual(display_, screen), DefaultDepth(display_, screen), ZPixmap, nullptr,
+                                        &output.shm, output.info.width, output.info.height);
+        if (!image)
+        {
+            std::cerr << "XShmCreateImage failed for " << output.info.name << std::endl;
+            return false;
+        }
+
+        output.shm.shmid = shmget(IPC_PRIVATE, static_cast<size_t>(image->bytes_per_line) * image->height, IPC_CREAT | 0600);
+        if (output.shm.shmid < 0)
+        {
+            std::cerr << "shmget failed for " << output.info.name << std::endl;
+            XDestroyImage(image);
+            return false;
+        }
+        output.shm.shmaddr = image->data = static_cast<char *>(shmat(output.shm.shmid, nullptr, 0));
+        output.shm.readOnly = False;
+
+        // XShmAttach reports failure (e.g. a remote display) asynchronously
+        xErrorRaised = false;
+        XErrorHandler previous = XSetErrorHandler(recordXError);
+        bool attached = image->data != reinterpret_cast<char *>(-1) && XShmAttach(display_, &output.shm);
+        XSync(display_, False);
+        XSetErrorHandler(previous);
+
+        // The segment is destroyed once both sides have detached
+        shmctl(output.shm.shmid, IPC_RMID, nullptr);
+
+        if (!attached || xErrorRaised)
+        {
+            std::cerr << "XShmAttach failed for " << output.info.name << ", falling back to XGetImage" << std::endl;
+            if (image->data != reinterpret_cast<char *>(-1))
+            {
+                shmdt(output.shm.shmaddr);
+            }
+            image->data = nullptr;
+            XDestroyImage(image);
+            output.shm = XShmSegmentInfo();
+            useShm_ = false;
+            return false;
+        }
+
+        output.image = image;
+        return true;
+    }
+
+    void releaseOutputs(std::vector<Output> &outputs)
+    {
+        for (size_t i = 0; i < outputs.size(); ++i)
+        {
+            Output &output = outputs[i];
+            if (!output.image)
+            {
+                continue;
+            }
+            if (output.shm.shmaddr)
+            {
+                XShmDetach(display_, &output.shm);
+                XSync(display_, False);
+                shmdt(output.shm.shmaddr);
+                output.image->data = nullptr;
+            }
+            XDestroyImage(output.image);
+        }
+        outputs.clear();
+    }
+
+    Display *display_;
+    std::mutex mutex_;
+    bool useShm_ = false;
+    std::vector<Output> outputs_;
+};
+
+} // namespace
+
+std::unique_ptr<FrameSource> createX11FrameSource()
+{
+    Display *display = XOpenDisplay(nullptr);
+    if (!display)
+    {
+        return std::unique_ptr<FrameSource>();
+    }
+    return std::unique_ptr<FrameSource>(new X11FrameSource(display));
+}